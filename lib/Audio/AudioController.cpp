@@ -3,15 +3,21 @@
 #include "soc/timer_group_struct.h"
 #include "soc/timer_group_reg.h"
 
-AudioController::AudioController(Settings& settings)
+AudioController::AudioController(Settings& settings, SoundIndex& soundIndex)
   : settings(settings),
-    audioGenerator(NULL),
+    soundIndex(soundIndex),
     audioOutput(NULL),
+    mp3Generator(std::make_shared<AudioGeneratorMP3>()),
+    imaAdpcmGenerator(std::make_shared<AudioGeneratorImaAdpcm>()),
     audioSource(std::make_shared<AudioFileSourceSPIFFS>()),
-    mutex(xSemaphoreCreateMutex()),
-    requestPending(false)
+    audioGenerator(NULL),
+    state(PlaybackState::IDLE),
+    audioTask(NULL),
+    transcodeTask(NULL),
+    filesMtx(xSemaphoreCreateMutex())
 {
-  audioOutput = std::make_shared<AudioOutputI2S>(0, AudioOutputI2S::INTERNAL_DAC);
+  loadedFilename[0] = 0;
+  openFilename[0] = 0;
 }
 
 AudioController::~AudioController() {
@@ -20,6 +26,32 @@ AudioController::~AudioController() {
 void AudioController::init() {
   pinMode(settings.audio.enable_pin, OUTPUT);
   disable();
+
+  // Each DMA buffer holds 64 samples.  The decoder fills free ones while the
+  // rest are played out.
+  audioOutput = std::make_shared<AudioOutputI2S>(0, AudioOutputI2S::INTERNAL_DAC, settings.audio.dma_buffer_count);
+
+  xTaskCreatePinnedToCore(
+    &AudioController::runAudio,
+    "Audio",
+    // Same as the Arduino loop task decoding used to run in
+    8192,
+    (void*)(this),
+    settings.audio.task_priority,
+    &audioTask,
+    settings.audio.task_core
+  );
+
+  // Below the audio task, so transcoding only uses time playback doesn't
+  xTaskCreatePinnedToCore(
+    &AudioController::runTranscodes,
+    "Transcode",
+    8192,
+    (void*)(this),
+    tskIDLE_PRIORITY + 1,
+    &transcodeTask,
+    settings.audio.task_core
+  );
 }
 
 void AudioController::enable() {
@@ -30,41 +62,277 @@ void AudioController::disable() {
   digitalWrite(settings.audio.enable_pin, LOW);
 }
 
-void AudioController::playMP3FromSpiffs(const String& filename) {
-  if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
-    requestPending = true;
-    filenameToPlay = filename;
+bool AudioController::playMP3FromSpiffs(const String& filename) {
+  return enqueue(commands, audioTask, AudioCommandType::PLAY, filename);
+}
+
+bool AudioController::preload(const String& filename) {
+  return enqueue(commands, audioTask, AudioCommandType::PRELOAD, filename);
+}
+
+bool AudioController::transcodeToImaAdpcm(const String& filename) {
+  return enqueue(transcodes, transcodeTask, AudioCommandType::TRANSCODE, filename);
+}
+
+bool AudioController::enqueue(
+  SpscQueue<AudioCommand, AUDIO_COMMAND_QUEUE_SIZE>& queue,
+  TaskHandle_t task,
+  AudioCommandType type,
+  const String& filename
+) {
+  AudioCommand command;
+  command.type = type;
+  command.queuedAt = micros();
+
+  if (filename.length() >= sizeof(command.filename)) {
+    Serial.println(F("Audio filename too long"));
+    return false;
+  }
+  strcpy(command.filename, filename.c_str());
+
+  if (! queue.push(command)) {
+    Serial.println(F("Audio command queue is full"));
+    return false;
+  }
 
-    xSemaphoreGive(mutex);
+  Trace::instant("audio_enqueue", static_cast<uint32_t>(type));
+
+  if (task != NULL) {
+    xTaskNotifyGive(task);
   }
+
+  return true;
 }
 
-void AudioController::loop() {
-  if (requestPending) {
-    if (xSemaphoreTake(mutex, portMAX_DELAY) == pdTRUE) {
-      requestPending = false;
+void AudioController::runAudio(void* _this) {
+  static_cast<AudioController*>(_this)->runAudio();
+}
+
+void AudioController::runAudio() {
+  AudioCommand command;
 
-      enable();
+  HeapAccounting::registerTask(HeapAccounting::Subsystem::AUDIO);
 
-      printf_P(PSTR("Playing filename: %s, free heap: %d\n"), filenameToPlay.c_str(), ESP.getFreeHeap());
+  while (true) {
+    while (commands.pop(command)) {
+      switch (command.type) {
+        case AudioCommandType::PLAY:
+          play(command);
+          break;
 
-      audioSource->open(filenameToPlay.c_str());
-      audioGenerator = std::make_shared<AudioGeneratorMP3>();
-      audioGenerator->begin(audioSource.get(), audioOutput.get());
+        case AudioCommandType::PRELOAD:
+          if (state != PlaybackState::PLAYING) {
+            load(command.filename);
+          }
+          break;
 
-      xSemaphoreGive(mutex);
+        // Handled by the transcode task
+        case AudioCommandType::TRANSCODE:
+          break;
+      }
     }
-  }
 
-  if (audioGenerator && audioGenerator->isRunning()) {
-    if (! audioGenerator->loop()) {
-      disable();
-      audioGenerator->stop();
-      Serial.println(F("Audio not looping"));
+    if (state == PlaybackState::PLAYING && audioGenerator->isRunning()) {
+      if (! audioGenerator->loop()) {
+        Trace::instant("audio_loop_failed");
+        stopPlayback();
+        Serial.println(F("Audio not looping"));
+      }
+
+      // loop() returns once the DMA buffers are full.  Give them a tick to
+      // drain rather than spinning.
+      vTaskDelay(1);
+    } else {
+      if (state == PlaybackState::PLAYING) {
+        stopPlayback();
+      }
+
+      // Nothing playing -- sleep until a command arrives
+      Trace::begin("audio_idle");
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      Trace::end("audio_idle");
     }
+  }
+}
+
+void AudioController::play(const AudioCommand& command) {
+  // Already primed by a preload
+  const bool preloaded = state == PlaybackState::PRELOADED && strcmp(loadedFilename, command.filename) == 0;
+
+  printf_P(PSTR("Playing filename: %s, preloaded: %d, free heap: %d\n"), command.filename, preloaded, ESP.getFreeHeap());
+
+  if (preloaded || load(command.filename)) {
+    enable();
+    state = PlaybackState::PLAYING;
+    Metrics::audioStart.recordSince(command.queuedAt);
+  }
+}
+
+bool AudioController::load(const char* filename) {
+  Trace::Scope trace("audio_load");
+  stopPlayback();
+
+  xSemaphoreTake(filesMtx, portMAX_DELAY);
+
+  const String path = resolveFilename(filename);
+
+  if (! audioSource->open(path.c_str())) {
+    xSemaphoreGive(filesMtx);
+    Serial.printf("Failed to open %s\n", filename);
+    return false;
+  }
+
+  strcpy(openFilename, path.c_str());
+  xSemaphoreGive(filesMtx);
+
+  // Trust the index over the extension when it knows the file
+  SoundInfo info;
+  bool isImaAdpcm = soundIndex.find(path.c_str(), info) && info.codec != SoundCodec::UNKNOWN
+    ? info.codec == SoundCodec::IMA_ADPCM
+    : path.endsWith(IMA_ADPCM_EXTENSION);
+
+  if (isImaAdpcm) {
+    audioGenerator = imaAdpcmGenerator.get();
   } else {
-    disable();
+    audioGenerator = mp3Generator.get();
+  }
+
+  if (! audioGenerator->begin(audioSource.get(), audioOutput.get())) {
+    Serial.printf("Failed to start decoding %s\n", path.c_str());
+    audioGenerator->stop();
+    audioSource->close();
+
+    xSemaphoreTake(filesMtx, portMAX_DELAY);
+    openFilename[0] = 0;
+    xSemaphoreGive(filesMtx);
+
+    return false;
   }
+
+  strcpy(loadedFilename, filename);
+  state = PlaybackState::PRELOADED;
+
+  return true;
+}
+
+void AudioController::stopPlayback() {
+  disable();
+
+  if (state != PlaybackState::IDLE && audioGenerator->isRunning()) {
+    audioGenerator->stop();
+  }
+  audioSource->close();
+
+  state = PlaybackState::IDLE;
+  loadedFilename[0] = 0;
+
+  xSemaphoreTake(filesMtx, portMAX_DELAY);
+  openFilename[0] = 0;
+  xSemaphoreGive(filesMtx);
+}
+
+String AudioController::resolveFilename(const char* filename) {
+  if (! SPIFFS.exists(filename)) {
+    const String transcoded = SoundTranscoder::targetFor(filename);
+
+    if (SPIFFS.exists(transcoded)) {
+      return transcoded;
+    }
+  }
+
+  return filename;
+}
+
+void AudioController::runTranscodes(void* _this) {
+  static_cast<AudioController*>(_this)->runTranscodes();
+}
+
+void AudioController::runTranscodes() {
+  AudioCommand command;
+
+  HeapAccounting::registerTask(HeapAccounting::Subsystem::AUDIO);
+
+  while (true) {
+    while (transcodes.pop(command)) {
+      transcode(command);
+    }
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+void AudioController::transcode(const AudioCommand& command) {
+  Trace::Scope trace("audio_transcode");
+  const String target = SoundTranscoder::targetFor(command.filename);
+
+  if (target.length() >= AUDIO_MAX_PATH_LENGTH) {
+    Serial.println(F("Transcode target filename too long"));
+    return;
+  }
+
+  uint32_t startTime = millis();
+
+  // Written off to the side so a half-finished file is never played
+  const uint32_t numSamples = SoundTranscoder::transcode(
+    command.filename,
+    TRANSCODE_TEMP_FILE,
+    settings.audio.transcode_sample_rate
+  );
+
+  if (numSamples == 0) {
+    Serial.printf("Failed to transcode %s\n", command.filename);
+    return;
+  }
+
+  // Wait out playback of either file
+  ReplaceResult result;
+  while ((result = replaceWithTranscoded(command.filename, target.c_str())) == ReplaceResult::BUSY) {
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+
+  if (result == ReplaceResult::FAILED) {
+    Serial.printf("Failed to move transcoded file to %s\n", target.c_str());
+    SPIFFS.remove(TRANSCODE_TEMP_FILE);
+    return;
+  }
+
+  printf_P(
+    PSTR("Transcoded %s -> %s (%u samples) in %lu ms\n"),
+    command.filename,
+    target.c_str(),
+    numSamples,
+    millis() - startTime
+  );
+
+  soundIndex.remove(command.filename);
+
+  SoundInfo info;
+  if (SoundAnalyzer::analyzeFile(target.c_str(), info)) {
+    soundIndex.put(info);
+  }
+}
+
+ReplaceResult AudioController::replaceWithTranscoded(const char* source, const char* target) {
+  ReplaceResult result = ReplaceResult::BUSY;
+
+  xSemaphoreTake(filesMtx, portMAX_DELAY);
+
+  if (strcmp(openFilename, source) != 0 && strcmp(openFilename, target) != 0) {
+    SPIFFS.remove(target);
+
+    if (SPIFFS.rename(TRANSCODE_TEMP_FILE, target)) {
+      if (strcmp(source, target) != 0) {
+        SPIFFS.remove(source);
+      }
+      result = ReplaceResult::REPLACED;
+    } else {
+      result = ReplaceResult::FAILED;
+    }
+  }
+
+  xSemaphoreGive(filesMtx);
+
+  return result;
 }
 
 bool AudioController::handleCommand(const JsonObject& json) {
@@ -73,7 +341,16 @@ bool AudioController::handleCommand(const JsonObject& json) {
     return false;
   }
 
-  playMP3FromSpiffs(json["file"]);
+  if (json.containsKey("action")) {
+    const String& action = json["action"];
 
-  return true;
-}
\ No newline at end of file
+    if (action.equalsIgnoreCase("preload")) {
+      return preload(json["file"]);
+    } else if (! action.equalsIgnoreCase("play")) {
+      Serial.println(F("Invalid audio command -- unknown action"));
+      return false;
+    }
+  }
+
+  return playMP3FromSpiffs(json["file"]);
+}
@@ -1,30 +1,78 @@
 #include <Settings.h>
+#include <SpscQueue.h>
+#include <SoundIndex.h>
+#include <Metrics.h>
+#include <Trace.h>
+#include <HeapAccounting.h>
 
 #include <AudioFileSourceSPIFFS.h>
 #include <AudioFileSourceID3.h>
 #include <AudioGeneratorMP3.h>
 #include <AudioOutputI2SNoDAC.h>
+#include <AudioGeneratorImaAdpcm.h>
+#include <SoundTranscoder.h>
 
 #include <ArduinoJson.h>
 
 #if defined(ESP32)
 #include <SPIFFS.h>
 extern "C" {
+  #include "freertos/task.h"
   #include "freertos/semphr.h"
 }
 #endif
 
+#ifndef AUDIO_COMMAND_QUEUE_SIZE
+#define AUDIO_COMMAND_QUEUE_SIZE 8
+#endif
+
+// Transcodes in progress are written here and renamed into place when done
+#define TRANSCODE_TEMP_FILE "/tmp/transcode"
+
 #ifndef _AUDIO_CONTROLLER_H
 #define _AUDIO_CONTROLLER_H
 
+enum class AudioCommandType {
+  PLAY, PRELOAD, TRANSCODE
+};
+
+enum class PlaybackState {
+  IDLE, PRELOADED, PLAYING
+};
+
+enum class ReplaceResult {
+  REPLACED, BUSY, FAILED
+};
+
+struct AudioCommand {
+  AudioCommandType type;
+  char filename[AUDIO_MAX_PATH_LENGTH];
+  // micros() when the command was queued
+  uint32_t queuedAt;
+};
+
 class AudioController {
 public:
-  AudioController(Settings& settings);
+  AudioController(Settings& settings, SoundIndex& soundIndex);
   ~AudioController();
 
-  void playMP3FromSpiffs(const String& filename);
+  // Queues a file to be played by the audio task.  Must only be called from
+  // one task (the web server).  Returns false if the request couldn't be
+  // queued.
+  bool playMP3FromSpiffs(const String& filename);
+
+  // Opens a file and readies its decoder without starting playback, so a
+  // following play of the same file starts immediately.  Ignored if
+  // something is already playing.
+  bool preload(const String& filename);
+
+  // Queues an MP3 on SPIFFS to be converted to IMA-ADPCM by a low-priority
+  // task, so playback carries on meanwhile.  The result replaces the
+  // original, with its extension swapped for IMA_ADPCM_EXTENSION.  Plays and
+  // preloads of the original name find it there.  Same threading rules as
+  // playMP3FromSpiffs.
+  bool transcodeToImaAdpcm(const String& filename);
   void init();
-  void loop();
   void enable();
   void disable();
 
@@ -32,15 +80,53 @@ public:
 
 private:
   Settings& settings;
+  SoundIndex& soundIndex;
 
+  // Allocated once and reused for every play
   std::shared_ptr<AudioOutputI2S> audioOutput;
-  std::shared_ptr<AudioGenerator> audioGenerator;
+  std::shared_ptr<AudioGeneratorMP3> mp3Generator;
+  std::shared_ptr<AudioGeneratorImaAdpcm> imaAdpcmGenerator;
   std::shared_ptr<AudioFileSource> audioSource;
 
-  String filenameToPlay;
-  volatile bool requestPending;
+  // Only touched by the audio task
+  AudioGenerator* audioGenerator;
+  PlaybackState state;
+  char loadedFilename[AUDIO_MAX_PATH_LENGTH];
+
+  SpscQueue<AudioCommand, AUDIO_COMMAND_QUEUE_SIZE> commands;
+  TaskHandle_t audioTask;
+
+  SpscQueue<AudioCommand, AUDIO_COMMAND_QUEUE_SIZE> transcodes;
+  TaskHandle_t transcodeTask;
 
-  SemaphoreHandle_t mutex;
+  // Held while opening a sound and while replacing one with its transcoded
+  // version, so a file isn't removed out from under playback
+  SemaphoreHandle_t filesMtx;
+  // Path of the file the audio task has open, which can differ from
+  // loadedFilename when that was resolved to a transcoded file
+  char openFilename[AUDIO_MAX_PATH_LENGTH];
+
+  bool enqueue(
+    SpscQueue<AudioCommand, AUDIO_COMMAND_QUEUE_SIZE>& queue,
+    TaskHandle_t task,
+    AudioCommandType type,
+    const String& filename
+  );
+
+  static void runAudio(void*);
+  void runAudio();
+  void play(const AudioCommand& command);
+  bool load(const char* filename);
+  void stopPlayback();
+
+  static void runTranscodes(void*);
+  void runTranscodes();
+  void transcode(const AudioCommand& command);
+  ReplaceResult replaceWithTranscoded(const char* source, const char* target);
+
+  // The file to open for a requested name: the name itself, or its
+  // transcoded replacement if the original is gone
+  static String resolveFilename(const char* filename);
 };
 
-#endif
\ No newline at end of file
+#endif
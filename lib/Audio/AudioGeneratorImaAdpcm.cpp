@@ -0,0 +1,109 @@
+#include <AudioGeneratorImaAdpcm.h>
+
+AudioGeneratorImaAdpcm::AudioGeneratorImaAdpcm()
+  : bufferLen(0)
+  , bufferIx(0)
+  , samplesRemaining(0)
+  , samplePending(false)
+{
+  running = false;
+  file = NULL;
+  output = NULL;
+}
+
+AudioGeneratorImaAdpcm::~AudioGeneratorImaAdpcm() {
+}
+
+bool AudioGeneratorImaAdpcm::begin(AudioFileSource* source, AudioOutput* output) {
+  uint8_t headerBytes[ImaAdpcm::HEADER_SIZE];
+
+  if (source == NULL || output == NULL) {
+    return false;
+  }
+
+  this->file = source;
+  this->output = output;
+
+  if (file->read(headerBytes, sizeof(headerBytes)) != sizeof(headerBytes) || ! ImaAdpcm::readHeader(headerBytes, header)) {
+    Serial.println(F("ImaAdpcm: unrecognized header"));
+    return false;
+  }
+
+  state = ImaAdpcm::State();
+  bufferLen = 0;
+  bufferIx = 0;
+  samplesRemaining = header.numSamples;
+  samplePending = false;
+
+  output->SetRate(header.sampleRate);
+  output->SetBitsPerSample(16);
+  output->SetChannels(1);
+
+  if (! output->begin()) {
+    return false;
+  }
+
+  running = true;
+  return true;
+}
+
+bool AudioGeneratorImaAdpcm::loop() {
+  if (! running) {
+    return false;
+  }
+
+  // Retry the sample the output turned away last time
+  if (samplePending) {
+    if (! output->ConsumeSample(lastSample)) {
+      return true;
+    }
+    samplePending = false;
+  }
+
+  while (samplesRemaining > 0) {
+    if (bufferIx >= bufferLen * 2) {
+      bufferLen = file->read(buffer, sizeof(buffer));
+      bufferIx = 0;
+
+      // Truncated file
+      if (bufferLen == 0) {
+        samplesRemaining = 0;
+        break;
+      }
+    }
+
+    const uint8_t byte = buffer[bufferIx / 2];
+    const uint8_t code = (bufferIx & 1) ? (byte >> 4) : (byte & 0x0F);
+    ++bufferIx;
+    --samplesRemaining;
+
+    lastSample[AudioOutput::LEFTCHANNEL] = ImaAdpcm::decodeSample(state, code);
+    lastSample[AudioOutput::RIGHTCHANNEL] = lastSample[AudioOutput::LEFTCHANNEL];
+
+    // Output's DMA buffers are full
+    if (! output->ConsumeSample(lastSample)) {
+      samplePending = true;
+      return true;
+    }
+  }
+
+  output->flush();
+  running = false;
+
+  return false;
+}
+
+bool AudioGeneratorImaAdpcm::stop() {
+  running = false;
+  samplesRemaining = 0;
+
+  if (output != NULL) {
+    output->stop();
+  }
+
+  return file != NULL ? file->close() : true;
+}
+
+bool AudioGeneratorImaAdpcm::isRunning() {
+  return running;
+}
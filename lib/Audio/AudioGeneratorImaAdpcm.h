@@ -0,0 +1,32 @@
+#include <AudioGenerator.h>
+#include <ImaAdpcm.h>
+
+#ifndef _AUDIO_GENERATOR_IMA_ADPCM_H
+#define _AUDIO_GENERATOR_IMA_ADPCM_H
+
+// Plays files in the ImaAdpcm container.  Decoding is a table lookup and a
+// few adds per sample, so there's next to no CPU cost compared to MP3.
+class AudioGeneratorImaAdpcm : public AudioGenerator {
+public:
+  AudioGeneratorImaAdpcm();
+  virtual ~AudioGeneratorImaAdpcm() override;
+
+  virtual bool begin(AudioFileSource* source, AudioOutput* output) override;
+  virtual bool loop() override;
+  virtual bool stop() override;
+  virtual bool isRunning() override;
+
+private:
+  ImaAdpcm::Header header;
+  ImaAdpcm::State state;
+
+  uint8_t buffer[128];
+  size_t bufferLen;
+  // Counts nibbles, not bytes
+  size_t bufferIx;
+
+  uint32_t samplesRemaining;
+  bool samplePending;
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <AudioOutputImaAdpcm.h>
+
+AudioOutputImaAdpcm::AudioOutputImaAdpcm(uint32_t maxSampleRate)
+  : maxSampleRate(maxSampleRate)
+  , accumulator(0)
+  , accumulated(0)
+  , phase(0)
+  , bufferLen(0)
+  , writeFailed(false)
+{
+  hertz = 0;
+  channels = 2;
+  bps = 16;
+}
+
+AudioOutputImaAdpcm::~AudioOutputImaAdpcm() {
+  if (file) {
+    file.close();
+  }
+}
+
+bool AudioOutputImaAdpcm::open(const char* path) {
+  this->path = path;
+  this->file = SPIFFS.open(path, FILE_WRITE);
+
+  if (! file) {
+    return false;
+  }
+
+  // Placeholder until the sample rate and count are known
+  uint8_t header[ImaAdpcm::HEADER_SIZE] = { 0 };
+  return file.write(header, sizeof(header)) == sizeof(header);
+}
+
+bool AudioOutputImaAdpcm::begin() {
+  return static_cast<bool>(file);
+}
+
+bool AudioOutputImaAdpcm::ConsumeSample(int16_t sample[2]) {
+  const int16_t mono = (static_cast<int32_t>(sample[LEFTCHANNEL]) + sample[RIGHTCHANNEL]) / 2;
+  const uint32_t outputRate = getOutputRate();
+
+  if (outputRate == hertz) {
+    encodeSample(mono);
+  } else {
+    accumulator += mono;
+    ++accumulated;
+    phase += outputRate;
+
+    if (phase >= hertz) {
+      phase -= hertz;
+      encodeSample(accumulator / accumulated);
+      accumulator = 0;
+      accumulated = 0;
+    }
+  }
+
+  // Never applies back-pressure -- the decoder can run flat out
+  return true;
+}
+
+void AudioOutputImaAdpcm::encodeSample(int16_t sample) {
+  uint8_t byte;
+
+  if (encoder.addSample(sample, byte)) {
+    buffer[bufferLen++] = byte;
+
+    if (bufferLen == sizeof(buffer)) {
+      flushBuffer();
+    }
+  }
+}
+
+bool AudioOutputImaAdpcm::stop() {
+  // Decoders may call stop() more than once
+  if (! file) {
+    return getNumSamples() > 0;
+  }
+
+  uint8_t byte;
+  if (encoder.finish(byte)) {
+    buffer[bufferLen++] = byte;
+  }
+  flushBuffer();
+  file.close();
+
+  ImaAdpcm::Header header;
+  header.channels = 1;
+  header.sampleRate = getOutputRate();
+  header.numSamples = encoder.getNumSamples();
+
+  uint8_t headerBytes[ImaAdpcm::HEADER_SIZE];
+  ImaAdpcm::writeHeader(header, headerBytes);
+
+  File headerFile = SPIFFS.open(path, "r+");
+  if (! headerFile || headerFile.write(headerBytes, sizeof(headerBytes)) != sizeof(headerBytes)) {
+    writeFailed = true;
+  }
+  headerFile.close();
+
+  if (hertz == 0) {
+    writeFailed = true;
+  }
+
+  return getNumSamples() > 0;
+}
+
+uint32_t AudioOutputImaAdpcm::getNumSamples() const {
+  return writeFailed ? 0 : encoder.getNumSamples();
+}
+
+uint32_t AudioOutputImaAdpcm::getOutputRate() const {
+  return maxSampleRate > 0 && hertz > maxSampleRate ? maxSampleRate : hertz;
+}
+
+void AudioOutputImaAdpcm::flushBuffer() {
+  if (bufferLen > 0 && file.write(buffer, bufferLen) != bufferLen) {
+    writeFailed = true;
+  }
+  bufferLen = 0;
+}
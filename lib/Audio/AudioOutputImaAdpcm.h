@@ -0,0 +1,52 @@
+#include <AudioOutput.h>
+#include <ImaAdpcm.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+#ifndef _AUDIO_OUTPUT_IMA_ADPCM_H
+#define _AUDIO_OUTPUT_IMA_ADPCM_H
+
+// Sink for a decoder that encodes what it's fed into an ImaAdpcm file on
+// SPIFFS.  Stereo input is mixed down to mono, and input faster than
+// maxSampleRate (0 for no limit) is downsampled by averaging the samples that
+// fall in each output period.  That's a crude low-pass filter, but playback
+// goes through the 8-bit internal DAC anyway.
+class AudioOutputImaAdpcm : public AudioOutput {
+public:
+  AudioOutputImaAdpcm(uint32_t maxSampleRate = 0);
+  virtual ~AudioOutputImaAdpcm() override;
+
+  bool open(const char* path);
+
+  virtual bool begin() override;
+  virtual bool ConsumeSample(int16_t sample[2]) override;
+  // Flushes and writes the final header
+  virtual bool stop() override;
+
+  uint32_t getNumSamples() const;
+  uint32_t getOutputRate() const;
+
+private:
+  String path;
+  File file;
+  ImaAdpcm::Encoder encoder;
+
+  uint32_t maxSampleRate;
+  // Input samples summed since the last output sample
+  int32_t accumulator;
+  uint16_t accumulated;
+  // Advances by the output rate per input sample; an output sample is due
+  // each time it passes the input rate
+  uint32_t phase;
+
+  uint8_t buffer[256];
+  size_t bufferLen;
+  bool writeFailed;
+
+  void encodeSample(int16_t sample);
+  void flushBuffer();
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include <ImaAdpcm.h>
+
+static const int8_t INDEX_TABLE[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const int16_t STEP_TABLE[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+  19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+  130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+  337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+  876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+  2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+  5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const uint8_t MAGIC[4] = { 'T', 'D', 'I', 'A' };
+
+static inline void writeLE32(uint8_t* buffer, uint32_t value) {
+  buffer[0] = value;
+  buffer[1] = value >> 8;
+  buffer[2] = value >> 16;
+  buffer[3] = value >> 24;
+}
+
+static inline uint32_t readLE32(const uint8_t* buffer) {
+  return buffer[0]
+    | (static_cast<uint32_t>(buffer[1]) << 8)
+    | (static_cast<uint32_t>(buffer[2]) << 16)
+    | (static_cast<uint32_t>(buffer[3]) << 24);
+}
+
+ImaAdpcm::State::State()
+  : predictor(0)
+  , stepIndex(0)
+{ }
+
+// Shared by the encoder and decoder so both track the same predictor
+static inline void advance(ImaAdpcm::State& state, uint8_t code) {
+  const int32_t step = STEP_TABLE[state.stepIndex];
+  int32_t diff = step >> 3;
+
+  if (code & 4) diff += step;
+  if (code & 2) diff += step >> 1;
+  if (code & 1) diff += step >> 2;
+
+  int32_t predictor = state.predictor + ((code & 8) ? -diff : diff);
+
+  if (predictor > 32767) predictor = 32767;
+  else if (predictor < -32768) predictor = -32768;
+
+  int16_t stepIndex = state.stepIndex + INDEX_TABLE[code];
+
+  if (stepIndex < 0) stepIndex = 0;
+  else if (stepIndex > 88) stepIndex = 88;
+
+  state.predictor = predictor;
+  state.stepIndex = stepIndex;
+}
+
+uint8_t ImaAdpcm::encodeSample(State& state, int16_t sample) {
+  int32_t step = STEP_TABLE[state.stepIndex];
+  int32_t diff = static_cast<int32_t>(sample) - state.predictor;
+  uint8_t code = 0;
+
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+  }
+  step >>= 1;
+  if (diff >= step) {
+    code |= 1;
+  }
+
+  advance(state, code);
+
+  return code;
+}
+
+int16_t ImaAdpcm::decodeSample(State& state, uint8_t code) {
+  advance(state, code & 0x0F);
+  return state.predictor;
+}
+
+void ImaAdpcm::writeHeader(const Header& header, uint8_t* buffer) {
+  for (size_t i = 0; i < sizeof(MAGIC); ++i) {
+    buffer[i] = MAGIC[i];
+  }
+
+  buffer[4] = VERSION;
+  buffer[5] = header.channels;
+  buffer[6] = 0;
+  buffer[7] = 0;
+  writeLE32(buffer + 8, header.sampleRate);
+  writeLE32(buffer + 12, header.numSamples);
+}
+
+bool ImaAdpcm::readHeader(const uint8_t* buffer, Header& header) {
+  for (size_t i = 0; i < sizeof(MAGIC); ++i) {
+    if (buffer[i] != MAGIC[i]) {
+      return false;
+    }
+  }
+
+  if (buffer[4] != VERSION || buffer[5] != 1) {
+    return false;
+  }
+
+  header.channels = buffer[5];
+  header.sampleRate = readLE32(buffer + 8);
+  header.numSamples = readLE32(buffer + 12);
+
+  return true;
+}
+
+ImaAdpcm::Encoder::Encoder()
+  : pending(0)
+  , hasPending(false)
+  , numSamples(0)
+{ }
+
+bool ImaAdpcm::Encoder::addSample(int16_t sample, uint8_t& out) {
+  const uint8_t code = encodeSample(state, sample);
+  ++numSamples;
+
+  if (hasPending) {
+    out = pending | (code << 4);
+    hasPending = false;
+    return true;
+  } else {
+    pending = code;
+    hasPending = true;
+    return false;
+  }
+}
+
+bool ImaAdpcm::Encoder::finish(uint8_t& out) {
+  if (hasPending) {
+    out = pending;
+    hasPending = false;
+    return true;
+  }
+  return false;
+}
+
+uint32_t ImaAdpcm::Encoder::getNumSamples() const {
+  return numSamples;
+}
@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _IMA_ADPCM_H
+#define _IMA_ADPCM_H
+
+// IMA-ADPCM codec and the container the firmware stores transcoded sounds in.
+// Has no Arduino dependencies, so the same code can be used to convert clips
+// off-device.
+//
+// File layout (little-endian):
+//   0   4  magic "TDIA"
+//   4   1  version
+//   5   1  channels (always 1)
+//   6   2  reserved
+//   8   4  sample rate (Hz)
+//   12  4  number of samples
+//   16  .. 4-bit codes, two samples per byte, low nibble first
+namespace ImaAdpcm {
+  static const size_t HEADER_SIZE = 16;
+  static const uint8_t VERSION = 1;
+
+  struct Header {
+    uint8_t channels;
+    uint32_t sampleRate;
+    uint32_t numSamples;
+  };
+
+  struct State {
+    State();
+
+    int16_t predictor;
+    uint8_t stepIndex;
+  };
+
+  uint8_t encodeSample(State& state, int16_t sample);
+  int16_t decodeSample(State& state, uint8_t code);
+
+  void writeHeader(const Header& header, uint8_t* buffer);
+  // Returns false if the buffer doesn't hold a recognized header
+  bool readHeader(const uint8_t* buffer, Header& header);
+
+  // Encodes a stream of samples into bytes, two samples at a time
+  class Encoder {
+  public:
+    Encoder();
+
+    // Returns true (and sets out) when a complete byte is ready
+    bool addSample(int16_t sample, uint8_t& out);
+    // Returns true (and sets out) if a half-filled byte is pending
+    bool finish(uint8_t& out);
+
+    uint32_t getNumSamples() const;
+
+  private:
+    State state;
+    uint8_t pending;
+    bool hasPending;
+    uint32_t numSamples;
+  };
+}
+
+#endif
@@ -0,0 +1,214 @@
+#include <SoundAnalyzer.h>
+#include <ImaAdpcm.h>
+#include <time.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#include <rom/crc.h>
+#endif
+
+// Layer III only.  Indexed by [MPEG-1 ? 0 : 1][bitrate index].
+static const uint16_t MP3_BITRATES[2][16] = {
+  { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },
+  { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 }
+};
+
+// Indexed by [version bits][sample rate index].  Version 1 is reserved.
+static const uint32_t MP3_SAMPLE_RATES[4][3] = {
+  { 11025, 12000, 8000 },
+  { 0, 0, 0 },
+  { 22050, 24000, 16000 },
+  { 44100, 48000, 32000 }
+};
+
+static const uint8_t MP3_VERSION_1 = 3;
+static const uint8_t MP3_LAYER_3 = 1;
+static const uint8_t MP3_MODE_MONO = 3;
+
+static uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t len) {
+#if defined(ESP32)
+  return crc32_le(crc, data, len);
+#else
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; ++i) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+#endif
+}
+
+SoundAnalyzer::SoundAnalyzer() {
+  reset();
+}
+
+void SoundAnalyzer::reset() {
+  size = 0;
+  crc = 0;
+  audioStart = -1;
+  windowLen = 0;
+}
+
+void SoundAnalyzer::update(const uint8_t* data, size_t len) {
+  const uint32_t offset = size;
+
+  crc = updateCrc32(crc, data, len);
+  size += len;
+
+  if (offset < ID3_HEADER_SIZE) {
+    memcpy(id3Header + offset, data, std::min(len, ID3_HEADER_SIZE - offset));
+  }
+
+  if (audioStart < 0 && size >= ID3_HEADER_SIZE) {
+    if (id3Header[0] == 'I' && id3Header[1] == 'D' && id3Header[2] == '3') {
+      // Tag size is a 28-bit "syncsafe" integer, excluding the header and an
+      // optional footer of the same size
+      audioStart = ID3_HEADER_SIZE
+        + ((id3Header[6] & 0x7F) << 21)
+        + ((id3Header[7] & 0x7F) << 14)
+        + ((id3Header[8] & 0x7F) << 7)
+        + (id3Header[9] & 0x7F)
+        + ((id3Header[5] & 0x10) ? ID3_HEADER_SIZE : 0);
+    } else {
+      audioStart = 0;
+      // Header bytes from earlier updates belong in the window too
+      copyToWindow(0, id3Header, std::min(offset, static_cast<uint32_t>(ID3_HEADER_SIZE)));
+    }
+  }
+
+  if (audioStart >= 0) {
+    copyToWindow(offset, data, len);
+  }
+}
+
+void SoundAnalyzer::copyToWindow(uint32_t offset, const uint8_t* data, size_t len) {
+  const uint32_t windowStart = audioStart + windowLen;
+  const uint32_t windowEnd = audioStart + SOUND_ANALYZER_WINDOW_SIZE;
+
+  if (offset + len <= windowStart || offset >= windowEnd) {
+    return;
+  }
+
+  const uint32_t from = std::max(offset, windowStart);
+  const uint32_t to = std::min(static_cast<uint32_t>(offset + len), windowEnd);
+
+  memcpy(window + windowLen, data + (from - offset), to - from);
+  windowLen += (to - from);
+}
+
+void SoundAnalyzer::finish(const char* name, SoundInfo& info) {
+  memset(&info, 0, sizeof(info));
+
+  strncpy(info.name, name, sizeof(info.name) - 1);
+  info.size = size;
+  info.crc32 = crc;
+
+  // Clock is only meaningful once it's been set (e.g., by SNTP)
+  time_t now = time(NULL);
+  info.modifiedAt = now > 1500000000 ? now : 0;
+
+  if (! parseImaAdpcm(info) && ! parseMp3(info)) {
+    info.codec = SoundCodec::UNKNOWN;
+  }
+}
+
+bool SoundAnalyzer::parseImaAdpcm(SoundInfo& info) const {
+  ImaAdpcm::Header header;
+
+  if (audioStart != 0 || windowLen < ImaAdpcm::HEADER_SIZE || ! ImaAdpcm::readHeader(window, header)) {
+    return false;
+  }
+
+  info.codec = SoundCodec::IMA_ADPCM;
+  info.channels = header.channels;
+  info.sampleRate = header.sampleRate;
+  info.bitrateKbps = (header.sampleRate * 4) / 1000;
+  info.durationMs = header.sampleRate ? (static_cast<uint64_t>(header.numSamples) * 1000) / header.sampleRate : 0;
+
+  return true;
+}
+
+bool SoundAnalyzer::parseMp3(SoundInfo& info) const {
+  for (size_t i = 0; i + 4 <= windowLen; ++i) {
+    const uint8_t* frame = window + i;
+
+    if (frame[0] != 0xFF || (frame[1] & 0xE0) != 0xE0) {
+      continue;
+    }
+
+    const uint8_t version = (frame[1] >> 3) & 0x3;
+    const uint8_t layer = (frame[1] >> 1) & 0x3;
+    const uint8_t bitrateIx = frame[2] >> 4;
+    const uint8_t sampleRateIx = (frame[2] >> 2) & 0x3;
+    const uint8_t mode = frame[3] >> 6;
+
+    if (version == 1 || layer != MP3_LAYER_3 || bitrateIx == 0 || bitrateIx == 15 || sampleRateIx == 3) {
+      continue;
+    }
+
+    const bool mpeg1 = version == MP3_VERSION_1;
+    const bool mono = mode == MP3_MODE_MONO;
+
+    info.codec = SoundCodec::MP3;
+    info.channels = mono ? 1 : 2;
+    info.sampleRate = MP3_SAMPLE_RATES[version][sampleRateIx];
+    info.bitrateKbps = MP3_BITRATES[mpeg1 ? 0 : 1][bitrateIx];
+
+    // VBR files carry a Xing (or, for CBR, Info) header in the first frame
+    // with a frame count.  Otherwise assume constant bitrate.
+    const size_t sideInfoSize = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+    const uint8_t* xing = frame + 4 + sideInfoSize;
+    const uint32_t samplesPerFrame = mpeg1 ? 1152 : 576;
+
+    if (xing + 12 <= window + windowLen
+      && (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0)
+      && (xing[7] & 0x1)) {
+      const uint32_t frames = (xing[8] << 24) | (xing[9] << 16) | (xing[10] << 8) | xing[11];
+      info.durationMs = (static_cast<uint64_t>(frames) * samplesPerFrame * 1000) / info.sampleRate;
+
+      if (info.durationMs > 0) {
+        info.bitrateKbps = (static_cast<uint64_t>(size - audioStart - i) * 8) / info.durationMs;
+      }
+    } else {
+      info.durationMs = (static_cast<uint64_t>(size - audioStart - i) * 8) / info.bitrateKbps;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+bool SoundAnalyzer::analyzeFile(const char* path, SoundInfo& info) {
+  File file = SPIFFS.open(path, FILE_READ);
+
+  if (! file) {
+    return false;
+  }
+
+  SoundAnalyzer analyzer;
+  uint8_t buffer[512];
+  size_t read;
+
+  while ((read = file.read(buffer, sizeof(buffer))) > 0) {
+    analyzer.update(buffer, read);
+  }
+
+  file.close();
+  analyzer.finish(path, info);
+
+  return true;
+}
+
+String SoundAnalyzer::codecToStr(SoundCodec codec) {
+  switch (codec) {
+    case SoundCodec::MP3:
+      return "mp3";
+    case SoundCodec::IMA_ADPCM:
+      return "ima_adpcm";
+    default:
+      return "unknown";
+  }
+}
@@ -0,0 +1,69 @@
+#include <Arduino.h>
+
+// SPIFFS object names are at most 32 bytes including the terminator
+#ifndef AUDIO_MAX_PATH_LENGTH
+#define AUDIO_MAX_PATH_LENGTH 32
+#endif
+
+// Bytes examined after any ID3 tag to find the first audio frame
+#ifndef SOUND_ANALYZER_WINDOW_SIZE
+#define SOUND_ANALYZER_WINDOW_SIZE 1024
+#endif
+
+#ifndef _SOUND_ANALYZER_H
+#define _SOUND_ANALYZER_H
+
+enum class SoundCodec : uint8_t {
+  UNKNOWN = 0, MP3 = 1, IMA_ADPCM = 2
+};
+
+// Stored verbatim as index records, so the layout must not change without
+// bumping SOUND_INDEX_VERSION.
+struct SoundInfo {
+  char name[AUDIO_MAX_PATH_LENGTH];
+  uint32_t size;
+  uint32_t durationMs;
+  uint32_t sampleRate;
+  uint16_t bitrateKbps;
+  uint8_t channels;
+  SoundCodec codec;
+  uint32_t crc32;
+  // Unix time, or 0 if the clock wasn't set when the file was written
+  uint32_t modifiedAt;
+};
+
+// Works out a sound's metadata and content hash from its bytes as they go by,
+// so a file can be described while it's being uploaded without reading it back.
+class SoundAnalyzer {
+public:
+  SoundAnalyzer();
+
+  void reset();
+  void update(const uint8_t* data, size_t len);
+  void finish(const char* name, SoundInfo& info);
+
+  // Reads an existing file through the analyzer
+  static bool analyzeFile(const char* path, SoundInfo& info);
+
+  static String codecToStr(SoundCodec codec);
+
+private:
+  static const size_t ID3_HEADER_SIZE = 10;
+
+  uint32_t size;
+  uint32_t crc;
+
+  uint8_t id3Header[ID3_HEADER_SIZE];
+  // Offset of the first byte after any ID3v2 tag.  Unknown until the first
+  // ID3_HEADER_SIZE bytes have been seen.
+  int32_t audioStart;
+
+  uint8_t window[SOUND_ANALYZER_WINDOW_SIZE];
+  size_t windowLen;
+
+  void copyToWindow(uint32_t offset, const uint8_t* data, size_t len);
+  bool parseImaAdpcm(SoundInfo& info) const;
+  bool parseMp3(SoundInfo& info) const;
+};
+
+#endif
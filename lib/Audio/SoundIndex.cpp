@@ -0,0 +1,215 @@
+#include <SoundIndex.h>
+
+static const uint8_t INDEX_MAGIC[] = { 'T', 'D', 'S', 'I' };
+
+SoundIndex::SoundIndex(const char* dirName)
+  : dirName(dirName)
+  , mutex(xSemaphoreCreateMutex())
+{ }
+
+SoundIndex::~SoundIndex() {
+  vSemaphoreDelete(mutex);
+}
+
+void SoundIndex::init() {
+  if (! isValid()) {
+    Serial.println(F("Sound index missing or outdated, rebuilding"));
+    rebuild();
+  }
+}
+
+size_t SoundIndex::recordOffset(size_t recordIx) {
+  return HEADER_SIZE + recordIx * sizeof(SoundInfo);
+}
+
+bool SoundIndex::isValid() {
+  File file = SPIFFS.open(SOUND_INDEX_FILE, FILE_READ);
+
+  if (! file) {
+    return false;
+  }
+
+  uint8_t header[HEADER_SIZE];
+  bool valid = file.read(header, HEADER_SIZE) == HEADER_SIZE
+    && memcmp(header, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+    && header[4] == SOUND_INDEX_VERSION
+    && (header[6] | (header[7] << 8)) == sizeof(SoundInfo)
+    && (file.size() - HEADER_SIZE) % sizeof(SoundInfo) == 0;
+
+  file.close();
+
+  return valid;
+}
+
+bool SoundIndex::rebuild() {
+  const uint32_t startTime = millis();
+  size_t numRecords = 0;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  File index = SPIFFS.open(SOUND_INDEX_FILE, FILE_WRITE);
+
+  if (! index) {
+    xSemaphoreGive(mutex);
+    Serial.println(F("Failed to create sound index"));
+    return false;
+  }
+
+  uint8_t header[HEADER_SIZE] = { 0 };
+  memcpy(header, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header[4] = SOUND_INDEX_VERSION;
+  header[6] = sizeof(SoundInfo) & 0xFF;
+  header[7] = sizeof(SoundInfo) >> 8;
+  index.write(header, HEADER_SIZE);
+
+  // SPIFFS is flat, so the directory listing is a prefix match.  Guard
+  // against picking up neighbours like the index itself.
+  const String prefix = dirName + "/";
+  File dir = SPIFFS.open(dirName);
+
+  if (dir && dir.isDirectory()) {
+    File file;
+
+    while ((file = dir.openNextFile())) {
+      String name = file.name();
+      file.close();
+
+      SoundInfo info;
+      if (name.startsWith(prefix) && name.length() < sizeof(info.name) && SoundAnalyzer::analyzeFile(name.c_str(), info)) {
+        // Timestamp would be the time of the rebuild, not of the upload
+        info.modifiedAt = 0;
+        index.write(reinterpret_cast<const uint8_t*>(&info), sizeof(info));
+        ++numRecords;
+      }
+    }
+
+    dir.close();
+  }
+
+  index.close();
+  xSemaphoreGive(mutex);
+
+  printf_P(PSTR("Indexed %u sounds in %lu ms\n"), static_cast<unsigned>(numRecords), millis() - startTime);
+
+  return true;
+}
+
+int SoundIndex::findRecord(File& file, const char* name, SoundInfo* info, int* freeIx) {
+  SoundInfo record;
+  int recordIx = 0;
+
+  if (freeIx != NULL) {
+    *freeIx = -1;
+  }
+
+  file.seek(recordOffset(0));
+
+  while (file.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record)) {
+    if (record.name[0] == 0) {
+      if (freeIx != NULL && *freeIx < 0) {
+        *freeIx = recordIx;
+      }
+    } else if (strncmp(record.name, name, sizeof(record.name)) == 0) {
+      if (info != NULL) {
+        *info = record;
+      }
+      return recordIx;
+    }
+
+    ++recordIx;
+  }
+
+  return -1;
+}
+
+bool SoundIndex::find(const char* name, SoundInfo& info) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  File file = SPIFFS.open(SOUND_INDEX_FILE, FILE_READ);
+  bool found = file && findRecord(file, name, &info, NULL) >= 0;
+
+  if (file) {
+    file.close();
+  }
+
+  xSemaphoreGive(mutex);
+
+  return found;
+}
+
+bool SoundIndex::put(const SoundInfo& info) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  // Opened for update so records can be overwritten in place
+  File file = SPIFFS.open(SOUND_INDEX_FILE, "r+");
+  bool success = false;
+
+  if (file) {
+    int freeIx;
+    int recordIx = findRecord(file, info.name, NULL, &freeIx);
+
+    if (recordIx < 0) {
+      recordIx = freeIx;
+    }
+
+    if (recordIx >= 0) {
+      file.seek(recordOffset(recordIx));
+    } else {
+      file.seek(file.size());
+    }
+
+    success = file.write(reinterpret_cast<const uint8_t*>(&info), sizeof(info)) == sizeof(info);
+    file.close();
+  }
+
+  xSemaphoreGive(mutex);
+
+  if (! success) {
+    Serial.printf("Failed to index %s\n", info.name);
+  }
+
+  return success;
+}
+
+bool SoundIndex::remove(const char* name) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  File file = SPIFFS.open(SOUND_INDEX_FILE, "r+");
+  bool success = false;
+
+  if (file) {
+    int recordIx = findRecord(file, name, NULL, NULL);
+
+    if (recordIx >= 0) {
+      const uint8_t tombstone = 0;
+
+      file.seek(recordOffset(recordIx));
+      success = file.write(&tombstone, 1) == 1;
+    }
+
+    file.close();
+  }
+
+  xSemaphoreGive(mutex);
+
+  return success;
+}
+
+size_t SoundIndex::read(size_t recordIx, SoundInfo* records, size_t maxRecords) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  File file = SPIFFS.open(SOUND_INDEX_FILE, FILE_READ);
+  size_t numRead = 0;
+
+  if (file) {
+    if (file.seek(recordOffset(recordIx))) {
+      numRead = file.read(reinterpret_cast<uint8_t*>(records), maxRecords * sizeof(SoundInfo)) / sizeof(SoundInfo);
+    }
+
+    file.close();
+  }
+
+  xSemaphoreGive(mutex);
+
+  return numRead;
+}
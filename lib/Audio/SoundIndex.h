@@ -0,0 +1,53 @@
+#include <Arduino.h>
+#include <SoundAnalyzer.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+extern "C" {
+  #include "freertos/semphr.h"
+}
+#endif
+
+#define SOUND_INDEX_FILE "/sounds.idx"
+#define SOUND_INDEX_VERSION 1
+
+#ifndef _SOUND_INDEX_H
+#define _SOUND_INDEX_H
+
+// Metadata for every file in the sounds directory, kept in a single file of
+// fixed-size records so listings and lookups don't have to open each sound.
+// Deleted sounds leave a tombstone (empty name) that the next addition
+// reuses.  The index is rebuilt from the directory if it's missing or was
+// written by a different version.
+class SoundIndex {
+public:
+  SoundIndex(const char* dirName);
+  ~SoundIndex();
+
+  // Must be called after SPIFFS is mounted
+  void init();
+  bool rebuild();
+
+  bool find(const char* name, SoundInfo& info);
+
+  // Adds a record, or replaces the one with the same name
+  bool put(const SoundInfo& info);
+  bool remove(const char* name);
+
+  // Reads up to maxRecords records starting at recordIx, including
+  // tombstones.  Returns the number read, which is 0 past the end.
+  size_t read(size_t recordIx, SoundInfo* records, size_t maxRecords);
+
+private:
+  static const size_t HEADER_SIZE = 8;
+
+  const String dirName;
+  SemaphoreHandle_t mutex;
+
+  bool isValid();
+  // Returns the index of the record with the given name, or -1
+  int findRecord(File& file, const char* name, SoundInfo* info, int* freeIx);
+  static size_t recordOffset(size_t recordIx);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include <SoundTranscoder.h>
+
+#include <AudioFileSourceSPIFFS.h>
+#include <AudioGeneratorMP3.h>
+#include <AudioOutputImaAdpcm.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+uint32_t SoundTranscoder::transcode(const char* source, const char* target, uint32_t maxSampleRate) {
+  AudioFileSourceSPIFFS input;
+  AudioGeneratorMP3 decoder;
+  AudioOutputImaAdpcm encoder(maxSampleRate);
+
+  if (! input.open(source) || ! encoder.open(target) || ! decoder.begin(&input, &encoder)) {
+    Serial.printf("Failed to start transcoding %s\n", source);
+    encoder.stop();
+    SPIFFS.remove(target);
+    return 0;
+  }
+
+  // Encoder never blocks, so this runs as fast as MP3 decoding allows.  Let
+  // lower-priority tasks on this core in every so often.
+  for (size_t i = 0; decoder.isRunning() && decoder.loop(); ++i) {
+    if (i % 64 == 0) {
+      vTaskDelay(1);
+    }
+  }
+
+  decoder.stop();
+
+  const uint32_t numSamples = encoder.stop() ? encoder.getNumSamples() : 0;
+  if (numSamples == 0) {
+    SPIFFS.remove(target);
+  }
+
+  return numSamples;
+}
+
+String SoundTranscoder::targetFor(const String& source) {
+  String target = source;
+
+  int extensionIx = source.lastIndexOf('.');
+  if (extensionIx > source.lastIndexOf('/')) {
+    target = source.substring(0, extensionIx);
+  }
+  target += IMA_ADPCM_EXTENSION;
+
+  return target;
+}
@@ -0,0 +1,22 @@
+#include <Arduino.h>
+
+// Sounds stored in the ImaAdpcm container
+#define IMA_ADPCM_EXTENSION ".ima"
+
+#ifndef _SOUND_TRANSCODER_H
+#define _SOUND_TRANSCODER_H
+
+// Converts MP3s on SPIFFS to the ImaAdpcm container.  4 bits per sample is
+// 22 KB/s at 44.1 kHz, more than a 128 kbps MP3, so output is downsampled to
+// at most maxSampleRate (16 kHz, 8 KB/s, by default).
+class SoundTranscoder {
+public:
+  // Decodes source into target, replacing it.  Returns the number of samples
+  // written, or 0 (with target removed) on failure.
+  static uint32_t transcode(const char* source, const char* target, uint32_t maxSampleRate);
+
+  // Source path with its extension swapped for IMA_ADPCM_EXTENSION
+  static String targetFor(const String& source);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include <atomic>
+#include <stddef.h>
+
+#ifndef _SPSC_QUEUE_H
+#define _SPSC_QUEUE_H
+
+// Fixed-capacity, lock-free queue for exactly one producer task and one
+// consumer task.  Holds Capacity - 1 items.
+template <typename T, size_t Capacity>
+class SpscQueue {
+public:
+  SpscQueue()
+    : head(0)
+    , tail(0)
+  { }
+
+  // Producer side.  Returns false if the queue is full.
+  bool push(const T& item) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    const size_t next = (t + 1) % Capacity;
+
+    if (next == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    items[t] = item;
+    tail.store(next, std::memory_order_release);
+
+    return true;
+  }
+
+  // Consumer side.  Returns false if the queue is empty.
+  bool pop(T& item) {
+    const size_t h = head.load(std::memory_order_relaxed);
+
+    if (h == tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = items[h];
+    head.store((h + 1) % Capacity, std::memory_order_release);
+
+    return true;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T items[Capacity];
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+};
+
+#endif
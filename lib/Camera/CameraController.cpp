@@ -9,42 +9,78 @@
 
 static const char JPEG_CONTENT_TYPE_HEADER[] PROGMEM = "--frame\r\nContent-Type: image/jpeg\r\n\r\n";
 
-CameraBuffer::CameraBuffer(const CameraFrame& frame)
-  : frame(frame)
+// Blocks until the pacer says the next frame is due.  Returns false if that's
+// too far off to wait for here.
+static bool waitUntilDue(const FramePacer& pacer) {
+  const uint32_t wait = pacer.msUntilDue(millis());
+
+  if (wait > CAMERA_PACING_MAX_BLOCK_MS) {
+    return false;
+  } else if (wait > 0) {
+    vTaskDelay(wait / portTICK_PERIOD_MS);
+  }
+
+  return true;
+}
+
+CameraBuffer::CameraBuffer(uint32_t lastSequence, uint16_t targetFps)
+  : pacer(targetFps)
+  , lastSequence(lastSequence)
+  , sentSequence(lastSequence)
   , bufferIx(0)
   , readStarted(false)
 { }
 
 void CameraBuffer::reset() {
+  this->frame.release();
   this->bufferIx = 0;
   this->readStarted = false;
 }
 
+void CameraBuffer::setFrame(FrameRing::FrameRef&& frame) {
+  this->frame = std::move(frame);
+  this->lastSequence = this->frame.sequence();
+  this->bufferIx = 0;
+}
+
+bool CameraBuffer::hasFrame() const {
+  return static_cast<bool>(this->frame);
+}
+
 size_t CameraBuffer::copy(uint8_t* buffer, size_t maxLen) {
-  size_t toCopy = std::min(maxLen, this->frame.length - this->bufferIx);
-  memcpy(buffer, this->frame.bytes + this->bufferIx, toCopy);
+  const CameraFrame& frame = this->frame.frame();
+  size_t toCopy = std::min(maxLen, frame.length - this->bufferIx);
+  memcpy(buffer, frame.bytes + this->bufferIx, toCopy);
   this->bufferIx += toCopy;
   return toCopy;
 }
 
 bool CameraBuffer::done() {
-  return this->bufferIx >= this->frame.length;
+  return hasFrame() && this->bufferIx >= this->frame.frame().length;
 }
 
 CameraController::CameraController(Settings& settings)
   : camera(ArduCAM(OV2640, SS))
   , settings(settings)
+  , stats()
+  , appliedResolution(settings.arducam.camera_resolution)
+  , motionStatus()
+  , motionMtx(xSemaphoreCreateMutex())
+  , captureEstimates()
   , captureStream(CameraStream(camera))
-  , cameraFrame(std::make_shared<CameraFrame>())
-  , readFrameMtx(xSemaphoreCreateCounting(10, 0))
-  , sendFrameMtx(xSemaphoreCreateCounting(1, 0))
-  , bufferMtx(xSemaphoreCreateBinary())
+  , copyTask(NULL)
+  , readFrameMtx(xSemaphoreCreateBinary())
+  , cameraMtx(xSemaphoreCreateBinary())
+  , frameWaiters()
+  , frameWaitersMtx(xSemaphoreCreateMutex())
 {
-  TaskHandle_t copyTask = NULL;
+  xSemaphoreGive(cameraMtx);
+
   xTaskCreate(
     &CameraController::readCameraFrame,
     "ArduCAM_Capture",
-    2048,
+    // Motion events may write to SPIFFS from this task
+    4096,
     (void*)(this),
     0,
     &copyTask
@@ -81,40 +117,30 @@ void CameraController::init() {
 
   camera.set_format(JPEG);
   camera.InitCAM();
-  camera.OV2640_set_JPEG_size(static_cast<uint8_t>(settings.arducam.camera_resolution));
+  appliedResolution = settings.arducam.camera_resolution;
+  camera.OV2640_set_JPEG_size(static_cast<uint8_t>(appliedResolution));
+  frameRing.setSlotSize(CameraTypes::expectedFrameSize(appliedResolution));
   camera.clear_fifo_flag();
+  // One frame per trigger.  Multi-frame mode would queue frames in the FIFO,
+  // but they can't be read until the whole batch is done, and their
+  // boundaries would have to be found by scanning for EOI markers.
+  // Pipelining instead overlaps the next exposure with sending from RAM.
   camera.write_reg(ARDUCHIP_FRAMES, 0x00);
 
-  camera.clear_fifo_flag();
-  camera.start_capture();
-
-  time_t max_wait_time = 1000;
-  time_t start_time = millis();
-  bool found_camera = false;
+  // Test capture.  The capture task may already be running.
+  xSemaphoreTake(cameraMtx, portMAX_DELAY);
 
-  while (!found_camera && millis() < (start_time + max_wait_time)) {
-    found_camera = camera.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK);
-  }
-
-  if (found_camera) {
-    const size_t cameraBufferLen = camera.read_fifo_length();
-    size_t readRemains = cameraBufferLen;
-
-    if (cameraBufferLen >= 0x07ffff){
-      Serial.println(F("ERROR: Captured image was too large"));
-      return;
-    } else if (cameraBufferLen == 0 ){
-      Serial.println(F("ERROR: Buffer size was 0"));
-      return;
-    }
-
-    camera.CS_LOW();
-    camera.set_fifo_burst();
-    SPI.transfer(0xFF);
+  captureStream.trigger();
 
+  if (! waitForCapture(CAMERA_INIT_WAIT_MS)) {
+    Serial.println(F("ERROR: Camera didn't finish a capture"));
+  } else if (captureStream.beginRead()) {
     uint8_t buffer[2048];
-    SPI.transferBytes(buffer, buffer, 2048);
+    captureStream.read(buffer, sizeof(buffer));
   }
+
+  captureStream.close();
+  xSemaphoreGive(cameraMtx);
 }
 
 size_t CameraController::CameraStream::read(uint8_t* buffer, size_t maxLen) {
@@ -133,9 +159,17 @@ size_t CameraController::CameraStream::read(uint8_t* buffer, size_t maxLen) {
   return 0;
 }
 
+size_t CameraController::CameraStream::remaining() const {
+  return this->bytesRemaining;
+}
+
 CameraController::CameraStream::CameraStream(ArduCAM& camera)
   : camera(camera)
   , bytesRemaining(0)
+  , isOpen(false)
+  , triggered(false)
+  , triggeredAt(0)
+  , triggeredAtMicros(0)
 { }
 
 void CameraController::readCameraFrame(void* _this) {
@@ -143,45 +177,373 @@ void CameraController::readCameraFrame(void* _this) {
 }
 
 void CameraController::readCameraFrame() {
+  HeapAccounting::registerTask(HeapAccounting::Subsystem::CAMERA);
+
   while (true) {
-    if (xSemaphoreTake(readFrameMtx, portMAX_DELAY) == pdTRUE) {
-      xSemaphoreTake(bufferMtx, static_cast<TickType_t>(1000 / portTICK_PERIOD_MS));
-      captureStream.open();
-      size_t readBytes = captureStream.read(this->cameraFrame->bytes, MAX_CAMERA_FRAME_SIZE);
+    // With motion detection on, capture periodically even if nobody asks
+    const bool motionEnabled = settings.motion.enabled;
+    const TickType_t idleWait = motionEnabled
+      ? std::max(static_cast<TickType_t>(settings.motion.interval_ms / portTICK_PERIOD_MS), static_cast<TickType_t>(1))
+      : portMAX_DELAY;
+
+    // Requests made while a capture is in progress coalesce into the next one,
+    // which is then broadcast to every reader.
+    if (xSemaphoreTake(readFrameMtx, idleWait) == pdTRUE || motionEnabled) {
+      Trace::Scope trace("capture_frame");
+
+      if (settings.arducam.camera_resolution != appliedResolution) {
+        applyResolution(settings.arducam.camera_resolution);
+      }
+
+      CameraFrame* frame = frameRing.beginWrite();
+
+      if (frame == NULL) {
+        if (frameRing.getArenaInfo().state == FrameArenaState::OUT_OF_MEMORY) {
+          // Nowhere to put a frame.  The ring won't try allocating again
+          // for a while, so don't spin until then.
+          Trace::instant("frame_ring_no_memory");
+          stats.noMemoryStalls.fetch_add(1, std::memory_order_relaxed);
+          vTaskDelay(std::max(static_cast<TickType_t>(CAMERA_FRAME_RETRY_MS / portTICK_PERIOD_MS), static_cast<TickType_t>(1)));
+        } else {
+          // Every slot is pinned by a reader.  Try again once one frees up.
+          Trace::instant("frame_ring_full");
+          vTaskDelay(1);
+        }
+        xSemaphoreGive(readFrameMtx);
+        continue;
+      }
+
+      Trace::begin("take_camera_mtx");
+      xSemaphoreTake(cameraMtx, portMAX_DELAY);
+      Trace::end("take_camera_mtx");
+      uint32_t captureStart = micros();
+      const bool prefetched = ensureTriggered();
+      const uint32_t triggeredAt = captureStream.getTriggeredAt();
+      size_t readBytes = 0;
+
+      // Timeouts are recorded by waitForCapture()
+      if (waitForCapture() && ! captureStream.beginRead()) {
+        Trace::instant("capture_read_failed");
+      }
+
+      // A partial JPEG is no use to anyone.  Drop frames that don't fit.
+      if (frameRing.reserve(frame, captureStream.remaining())) {
+        uint32_t readStart = micros();
+        readBytes = captureStream.read(frame->bytes, frame->capacity);
+        Metrics::cameraFifoRead.recordSince(readStart);
+      } else {
+        Trace::instant("frame_dropped", captureStream.remaining());
+        stats.framesDropped.fetch_add(1, std::memory_order_relaxed);
+      }
+
       captureStream.close();
-      if (readBytes >= MAX_CAMERA_FRAME_SIZE) {
-        Serial.println(F("ERROR: read frame was too large!"));
+      stats.captureMicros.fetch_add(micros() - captureStart, std::memory_order_relaxed);
+
+      // The sensor exposes the next frame while this one is being sent
+      if (settings.arducam.pipelined_capture) {
+        captureStream.trigger();
       }
-      this->cameraFrame->length = readBytes;
 
-      xSemaphoreGive(bufferMtx);
-      xSemaphoreGive(sendFrameMtx);
+      xSemaphoreGive(cameraMtx);
+      Trace::instant("give_camera_mtx");
+      frame->length = readBytes;
+
+      if (readBytes > 0) {
+        stats.framesCaptured.fetch_add(1, std::memory_order_relaxed);
+        stats.bytesCaptured.fetch_add(readBytes, std::memory_order_relaxed);
+        if (prefetched) {
+          stats.framesPrefetched.fetch_add(1, std::memory_order_relaxed);
+        }
+        frameRing.commitWrite(prefetched ? triggeredAt : millis());
+
+        // Wake everyone waiting on a frame
+        Trace::instant("frame_published", readBytes);
+        notifyFrameWaiters();
+
+        // Still safe to read: only this task ever overwrites the newest frame
+        if (motionEnabled) {
+          detectMotion(*frame);
+        }
+      } else {
+        stats.captureFailures.fetch_add(1, std::memory_order_relaxed);
+        frameRing.abortWrite();
+      }
     }
   }
 }
 
-void CameraController::CameraStream::close() {
+void CameraController::applyResolution(CameraResolution resolution) {
+  Trace::Scope trace("apply_resolution");
+
+  xSemaphoreTake(cameraMtx, portMAX_DELAY);
+  camera.OV2640_set_JPEG_size(static_cast<uint8_t>(resolution));
+  // Don't hand out a frame exposed at the old resolution
+  if (captureStream.isTriggered()) {
+    captureStream.trigger();
+  }
+  xSemaphoreGive(cameraMtx);
+
+  // Frames already in the ring keep their buffers until they're released
+  frameRing.setSlotSize(CameraTypes::expectedFrameSize(resolution));
+
+  // The background was built from frames at the old resolution
+  xSemaphoreTake(motionMtx, portMAX_DELAY);
+  motionDetector.reset();
+  xSemaphoreGive(motionMtx);
+
+  appliedResolution = resolution;
 }
 
-const CameraFrame& CameraController::getCameraFrame() {
-  return *this->cameraFrame;
+FrameRing::FrameRef CameraController::waitForFrame(uint32_t newerThan) {
+  const TickType_t maxWait = CAMERA_FRAME_WAIT_MS / portTICK_PERIOD_MS;
+  const TickType_t start = xTaskGetTickCount();
+  FrameRing::FrameRef frame = frameRing.acquireNewerThan(newerThan);
+
+  if (frame) {
+    return frame;
+  }
+
+  // Clear anything left over from an earlier wait, then check the ring again:
+  // a frame published before this task registered wouldn't have notified it
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  ulTaskNotifyTake(pdTRUE, 0);
+  const bool registered = addFrameWaiter(self);
+  frame = frameRing.acquireNewerThan(newerThan);
+
+  while (!frame) {
+    TickType_t waited = xTaskGetTickCount() - start;
+
+    if (waited >= maxWait) {
+      break;
+    }
+
+    Trace::instant("give_read_frame_mtx");
+    xSemaphoreGive(readFrameMtx);
+
+    Trace::begin("wait_frame");
+    if (registered) {
+      ulTaskNotifyTake(pdTRUE, maxWait - waited);
+    } else {
+      vTaskDelay(1);
+    }
+    Trace::end("wait_frame");
+
+    frame = frameRing.acquireNewerThan(newerThan);
+  }
+
+  if (registered) {
+    removeFrameWaiter(self);
+  }
+
+  stats.frameWaitMicros.fetch_add((xTaskGetTickCount() - start) * portTICK_PERIOD_MS * 1000, std::memory_order_relaxed);
+
+  return frame;
+}
+
+bool CameraController::addFrameWaiter(TaskHandle_t task) {
+  bool added = false;
+
+  xSemaphoreTake(frameWaitersMtx, portMAX_DELAY);
+  for (size_t i = 0; i < CAMERA_MAX_FRAME_WAITERS && !added; ++i) {
+    if (frameWaiters[i] == NULL) {
+      frameWaiters[i] = task;
+      added = true;
+    }
+  }
+  xSemaphoreGive(frameWaitersMtx);
+
+  return added;
+}
+
+void CameraController::removeFrameWaiter(TaskHandle_t task) {
+  xSemaphoreTake(frameWaitersMtx, portMAX_DELAY);
+  for (size_t i = 0; i < CAMERA_MAX_FRAME_WAITERS; ++i) {
+    if (frameWaiters[i] == task) {
+      frameWaiters[i] = NULL;
+    }
+  }
+  xSemaphoreGive(frameWaitersMtx);
+}
+
+void CameraController::notifyFrameWaiters() {
+  xSemaphoreTake(frameWaitersMtx, portMAX_DELAY);
+  for (size_t i = 0; i < CAMERA_MAX_FRAME_WAITERS; ++i) {
+    if (frameWaiters[i] != NULL) {
+      xTaskNotifyGive(frameWaiters[i]);
+    }
+  }
+  xSemaphoreGive(frameWaitersMtx);
+}
+
+FrameRing::FrameRef CameraController::pollFrame(uint32_t newerThan) {
+  FrameRing::FrameRef frame = frameRing.acquireNewerThan(newerThan);
+
+  if (! frame) {
+    // Already given if a capture is pending.  Giving it again is a no-op.
+    xSemaphoreGive(readFrameMtx);
+  }
+
+  return frame;
 }
 
-void CameraController::CameraStream::open() {
+FrameRing::FrameRef CameraController::acquireSnapshot(uint32_t maxAgeMs) {
+  const uint32_t latestSequence = frameRing.latestSequence();
+  FrameRing::FrameRef frame = frameRing.acquireNewerThan(0);
+
+  if (frame && (millis() - frame.capturedAt()) <= maxAgeMs) {
+    stats.snapshotsReused.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    // Let go of the stale frame first.  With a one-slot ring, the capture task
+    // can't write a new one while it's held.
+    frame.release();
+    frame = waitForFrame(latestSequence);
+  }
+
+  if (frame) {
+    stats.framesSent.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  return frame;
+}
+
+void CameraController::detectMotion(const CameraFrame& frame) {
+  Trace::Scope trace("detect_motion");
+  const uint32_t start = micros();
+  const uint32_t now = millis();
+  MotionResult result;
+
+  xSemaphoreTake(motionMtx, portMAX_DELAY);
+
+  // A background from before detection was last switched off is stale
+  if (motionStatus.framesAnalyzed > 0 && (now - motionStatus.lastAnalyzedAt) > 4 * static_cast<uint32_t>(settings.motion.interval_ms)) {
+    motionDetector.reset();
+  }
+
+  motionDetector.configure(settings.motion.threshold, settings.motion.min_cells, settings.motion.background_shift);
+  const bool parsed = motionDetector.analyze(frame.bytes, frame.length, result);
+
+  motionStatus.analyzeMicros += (micros() - start);
+  motionStatus.lastAnalyzedAt = now;
+
+  if (! parsed) {
+    motionStatus.parseFailures++;
+    xSemaphoreGive(motionMtx);
+    return;
+  }
+
+  motionStatus.framesAnalyzed++;
+  motionStatus.lastResult = result;
+
+  const bool isEvent = result.motion
+    && (motionStatus.lastEventAt == 0 || (now - motionStatus.lastEventAt) >= static_cast<uint32_t>(settings.motion.cooldown_ms));
+
+  // Called outside the lock, so the handler can ask for the motion status
+  MotionHandler handler;
+
+  if (isEvent) {
+    motionStatus.events++;
+    motionStatus.lastEventAt = now;
+    handler = motionHandler;
+  }
+
+  xSemaphoreGive(motionMtx);
+
+  if (! isEvent) {
+    return;
+  }
+
+  printf_P(PSTR("Motion detected: %u cells changed\n"), result.changedCells);
+
+  if (settings.motion.action == MotionAction::CAPTURE) {
+    File file = SPIFFS.open(MOTION_CAPTURE_FILE, FILE_WRITE);
+
+    if (! file || file.write(frame.bytes, frame.length) != frame.length) {
+      Serial.println(F("ERROR: failed to save motion capture"));
+    }
+
+    if (file) {
+      file.close();
+    }
+  }
+
+  if (handler) {
+    handler(result);
+  }
+}
+
+void CameraController::onMotion(MotionHandler handler) {
+  xSemaphoreTake(motionMtx, portMAX_DELAY);
+  this->motionHandler = handler;
+  xSemaphoreGive(motionMtx);
+}
+
+MotionStatus CameraController::getMotionStatus(uint8_t* grid) {
+  xSemaphoreTake(motionMtx, portMAX_DELAY);
+
+  MotionStatus status = motionStatus;
+  if (grid != NULL) {
+    memcpy(grid, motionDetector.getGrid(), MOTION_GRID_CELLS);
+  }
+
+  xSemaphoreGive(motionMtx);
+
+  return status;
+}
+
+const CameraStats& CameraController::getStats() const {
+  return stats;
+}
+
+FrameArenaInfo CameraController::getArenaInfo() {
+  return frameRing.getArenaInfo();
+}
+
+void CameraController::CameraStream::close() {
+  if (this->isOpen) {
+    this->isOpen = false;
+    this->bytesRemaining = 0;
+  }
+
+  // Ends the FIFO burst
+  camera.CS_HIGH();
+}
+
+void CameraController::CameraStream::trigger() {
   camera.flush_fifo();
   camera.clear_fifo_flag();
   camera.start_capture();
 
-  while (!camera.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK));
+  this->triggered = true;
+  this->triggeredAt = millis();
+  this->triggeredAtMicros = micros();
+}
+
+bool CameraController::CameraStream::isTriggered() const {
+  return this->triggered;
+}
+
+uint32_t CameraController::CameraStream::getTriggeredAt() const {
+  return this->triggeredAt;
+}
 
+uint32_t CameraController::CameraStream::getTriggeredAtMicros() const {
+  return this->triggeredAtMicros;
+}
+
+bool CameraController::CameraStream::captureDone() {
+  return camera.get_bit(ARDUCHIP_TRIG, CAP_DONE_MASK);
+}
+
+bool CameraController::CameraStream::beginRead() {
+  this->triggered = false;
   this->bytesRemaining = camera.read_fifo_length();
 
   if (this->bytesRemaining >= 0x07ffff){
     Serial.println(F("ERROR: Captured image was too large"));
-    return;
+    return false;
   } else if (this->bytesRemaining == 0 ){
     Serial.println(F("ERROR: Buffer size was 0"));
-    return;
+    return false;
   }
 
   camera.CS_LOW();
@@ -189,18 +551,139 @@ void CameraController::CameraStream::open() {
   SPI.transfer(0x00);
 
   this->isOpen = true;
+
+  return true;
+}
+
+bool CameraController::ensureTriggered() {
+  if (captureStream.isTriggered()
+    && settings.arducam.pipelined_capture
+    && (millis() - captureStream.getTriggeredAt()) <= CAMERA_PREFETCH_MAX_AGE_MS) {
+    return true;
+  }
+
+  if (captureStream.isTriggered()) {
+    stats.prefetchesDiscarded.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  captureStream.trigger();
+  return false;
 }
 
-CameraController::CallbackFn CameraController::chunkedResponseCallback(bool continuous) {
-  std::shared_ptr<CameraBuffer> cameraBuffer = std::make_shared<CameraBuffer>(getCameraFrame());
+bool CameraController::waitForCapture(uint32_t timeoutMs) {
+  const TickType_t maxWait = timeoutMs / portTICK_PERIOD_MS;
+  const TickType_t start = xTaskGetTickCount();
+
+  const uint32_t startMicros = micros();
+  const uint32_t triggeredAt = captureStream.getTriggeredAtMicros();
+  const uint32_t sinceTrigger = startMicros - triggeredAt;
+  uint32_t& estimate = captureEstimates[static_cast<size_t>(appliedResolution)];
+
+  // CAP_DONE is a register read over SPI, and there's no interrupt for it.
+  // Rather than polling through the whole exposure, sleep until it's nearly
+  // due.
+  const uint32_t sleepUntil = estimate / 100 * CAMERA_CAPTURE_SLEEP_PERCENT;
+
+  if (sinceTrigger < sleepUntil) {
+    const TickType_t sleepTicks = std::min(
+      static_cast<TickType_t>((sleepUntil - sinceTrigger) / 1000 / portTICK_PERIOD_MS),
+      maxWait
+    );
+
+    if (sleepTicks > 0) {
+      Trace::begin("capture_sleep");
+      vTaskDelay(sleepTicks);
+      Trace::end("capture_sleep");
+    }
+  }
+
+  uint32_t polls = 0;
+
+  while (! captureStream.captureDone()) {
+    ++polls;
+
+    if ((xTaskGetTickCount() - start) >= maxWait) {
+      stats.captureTimeouts.fetch_add(1, std::memory_order_relaxed);
+      stats.capturePolls.fetch_add(polls, std::memory_order_relaxed);
+      Trace::instant("capture_timeout", timeoutMs);
+      Serial.println(F("ERROR: Timed out waiting for capture"));
+      return false;
+    }
+
+    vTaskDelay(1);
+  }
 
-  // Don't request new frame if a send is already in progress.  Instead, just re-send the
-  // same frame.  If sending continuously, always request a new frame.
-  if (xSemaphoreGive(readFrameMtx) != pdTRUE) {
-    Serial.println("ERROR: could not give read frame mutex");
+  stats.capturePolls.fetch_add(polls, std::memory_order_relaxed);
+  stats.capturesWaited.fetch_add(1, std::memory_order_relaxed);
+  Metrics::cameraCapture.recordSince(startMicros);
+
+  // Captures that finished before anyone waited (e.g., prefetched ones) say
+  // nothing about how long they take
+  if (estimate == 0 || sinceTrigger < estimate) {
+    const uint32_t elapsed = micros() - triggeredAt;
+
+    if (estimate == 0) {
+      estimate = elapsed;
+    } else if (polls > 0) {
+      // Finished within the last tick, so elapsed is close
+      estimate += (static_cast<int32_t>(elapsed) - static_cast<int32_t>(estimate)) / 8;
+    } else {
+      // Already done after sleeping, so it might have been done sooner
+      estimate -= estimate / 16;
+    }
   }
 
+  return true;
+}
+
+uint32_t CameraController::getExpectedCaptureMicros() const {
+  return captureEstimates[static_cast<size_t>(appliedResolution)];
+}
+
+CameraController::CallbackFn CameraController::chunkedResponseCallback(bool continuous, uint16_t targetFps) {
+  // Only frames captured after the request arrived are sent
+  std::shared_ptr<CameraBuffer> cameraBuffer = std::make_shared<CameraBuffer>(frameRing.latestSequence(), targetFps);
+
   return [this, cameraBuffer, continuous](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    if (cameraBuffer->done()) {
+      // Only called again once the last chunk has been accepted
+      if (cameraBuffer->lastSequence != cameraBuffer->sentSequence) {
+        Metrics::cameraFrameSend.record((millis() - cameraBuffer->frame.capturedAt()) * 1000);
+        cameraBuffer->sentSequence = cameraBuffer->lastSequence;
+      }
+
+      if (! continuous) {
+        return 0;
+      }
+
+      // Called once the last chunk has been accepted, so this tracks how fast
+      // the client is draining frames
+      cameraBuffer->pacer.frameFinished(millis());
+      cameraBuffer->reset();
+    }
+
+    if (! cameraBuffer->hasFrame()) {
+      // Frames are only requested when a client is due for one, so the
+      // camera idles when nobody needs a high frame rate
+      if (! waitUntilDue(cameraBuffer->pacer)) {
+        return RESPONSE_TRY_AGAIN;
+      }
+
+      // Runs on the async_tcp task, which serves every other connection too,
+      // so this only asks for a frame and checks again on the next call
+      FrameRing::FrameRef frame = pollFrame(cameraBuffer->lastSequence);
+
+      // Slow readers skip straight to whatever is newest the next time around
+      if (! frame) {
+        return RESPONSE_TRY_AGAIN;
+      }
+
+      stats.framesSent.fetch_add(1, std::memory_order_relaxed);
+      stats.framesSkipped.fetch_add(frame.sequence() - cameraBuffer->lastSequence - 1, std::memory_order_relaxed);
+      cameraBuffer->setFrame(std::move(frame));
+      cameraBuffer->pacer.frameStarted(millis());
+    }
+
     size_t i = 0;
 
     if (!cameraBuffer->readStarted && continuous) {
@@ -208,25 +691,123 @@ CameraController::CallbackFn CameraController::chunkedResponseCallback(bool cont
       i = strlen_P(JPEG_CONTENT_TYPE_HEADER);
     }
 
-    if (cameraBuffer->readStarted || xSemaphoreTake(sendFrameMtx, portMAX_DELAY) == pdTRUE) {
-      if (!cameraBuffer->readStarted) {
-        xSemaphoreTake(bufferMtx, portMAX_DELAY);
+    cameraBuffer->readStarted = true;
+
+    size_t copied = cameraBuffer->copy(buffer + i, maxLen - i);
+    stats.bytesCopied.fetch_add(copied, std::memory_order_relaxed);
+
+    return i + copied;
+  };
+}
+
+// State for a response being streamed straight out of the camera FIFO.  Owns
+// the camera while a frame is in flight, and hands it back if the client goes
+// away mid-frame.
+struct DirectStreamState {
+  enum class Phase { IDLE, CAPTURING, READING, DONE };
+
+  DirectStreamState(CameraController::CameraStream& stream, SemaphoreHandle_t cameraMtx, uint16_t targetFps)
+    : stream(stream)
+    , cameraMtx(cameraMtx)
+    , pacer(targetFps)
+    , phase(Phase::IDLE)
+    , holdsCamera(false)
+  { }
+
+  ~DirectStreamState() {
+    releaseCamera();
+  }
+
+  void releaseCamera() {
+    if (holdsCamera) {
+      stream.close();
+      xSemaphoreGive(cameraMtx);
+      Trace::instant("give_camera_mtx");
+      holdsCamera = false;
+    }
+  }
+
+  CameraController::CameraStream& stream;
+  SemaphoreHandle_t cameraMtx;
+  FramePacer pacer;
+  Phase phase;
+  bool holdsCamera;
+};
+
+CameraController::CallbackFn CameraController::directResponseCallback(bool continuous, uint16_t targetFps) {
+  std::shared_ptr<DirectStreamState> state = std::make_shared<DirectStreamState>(captureStream, cameraMtx, targetFps);
+
+  return [this, state, continuous](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+    size_t i = 0;
+
+    if (state->phase == DirectStreamState::Phase::DONE) {
+      return 0;
+    }
+
+    if (state->phase == DirectStreamState::Phase::IDLE) {
+      if (! waitUntilDue(state->pacer)) {
+        return RESPONSE_TRY_AGAIN;
       }
 
-      cameraBuffer->readStarted = true;
+      // Camera is busy with the capture task or another direct stream
+      if (xSemaphoreTake(cameraMtx, 0) != pdTRUE) {
+        Trace::instant("camera_mtx_busy");
+        return RESPONSE_TRY_AGAIN;
+      }
+      Trace::instant("take_camera_mtx");
+      state->holdsCamera = true;
 
-      size_t readBytes = i + cameraBuffer->copy(buffer + i, maxLen - i);
+      captureStream.trigger();
+      state->phase = DirectStreamState::Phase::CAPTURING;
+    }
 
-      if (cameraBuffer->done()) {
-        xSemaphoreGive(bufferMtx);
+    // Checked once per call rather than waited on, which would hold up the
+    // async_tcp task and every other connection on it
+    if (state->phase == DirectStreamState::Phase::CAPTURING) {
+      if (! captureStream.captureDone()) {
+        stats.capturePolls.fetch_add(1, std::memory_order_relaxed);
 
-        if (continuous) {
-          xSemaphoreGive(readFrameMtx);
-          cameraBuffer->reset();
+        if ((millis() - captureStream.getTriggeredAt()) < CAMERA_FRAME_WAIT_MS) {
+          return RESPONSE_TRY_AGAIN;
         }
+
+        stats.captureTimeouts.fetch_add(1, std::memory_order_relaxed);
+        Trace::instant("capture_timeout", CAMERA_FRAME_WAIT_MS);
+        Serial.println(F("ERROR: Timed out waiting for capture"));
+        state->releaseCamera();
+        state->phase = DirectStreamState::Phase::IDLE;
+        return RESPONSE_TRY_AGAIN;
+      }
+
+      stats.capturesWaited.fetch_add(1, std::memory_order_relaxed);
+      Metrics::cameraCapture.record(micros() - captureStream.getTriggeredAtMicros());
+
+      if (! captureStream.beginRead()) {
+        Serial.println(F("ERROR: direct capture failed"));
+        state->releaseCamera();
+        state->phase = DirectStreamState::Phase::IDLE;
+        return RESPONSE_TRY_AGAIN;
+      }
+
+      state->phase = DirectStreamState::Phase::READING;
+      state->pacer.frameStarted(millis());
+
+      if (continuous) {
+        strcpy_P((char*)buffer, JPEG_CONTENT_TYPE_HEADER);
+        i = strlen_P(JPEG_CONTENT_TYPE_HEADER);
       }
+    }
 
-      return readBytes;
+    // Burst read lands directly in the outgoing TCP chunk
+    size_t readBytes = i + captureStream.read(buffer + i, maxLen - i);
+
+    if (captureStream.remaining() == 0) {
+      stats.framesSent.fetch_add(1, std::memory_order_relaxed);
+      state->pacer.frameFinished(millis());
+      state->releaseCamera();
+      state->phase = continuous ? DirectStreamState::Phase::IDLE : DirectStreamState::Phase::DONE;
     }
+
+    return readBytes;
   };
-}
\ No newline at end of file
+}
@@ -3,28 +3,109 @@
 #include <Settings.h>
 #include <ArduCAM.h>
 #include <Wire.h>
-
-// #define CAMERA_BUFFER_SIZE 128
-// 40 KB
-// There will be two buffers of this size
-#define MAX_CAMERA_FRAME_SIZE 40096
+#include <FrameRing.h>
+#include <FramePacer.h>
+#include <MotionDetector.h>
+#include <Metrics.h>
+#include <Trace.h>
+#include <HeapAccounting.h>
+#include <atomic>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+// Longest a frame or capture is waited for before it's given up on.
+// Response callbacks check back on each call rather than blocking this long.
+#ifndef CAMERA_FRAME_WAIT_MS
+#define CAMERA_FRAME_WAIT_MS 500
+#endif
+
+// With arducam.pipelined_capture, a capture started ahead of time is thrown
+// away if nobody asks for it within this long (ms)
+#ifndef CAMERA_PREFETCH_MAX_AGE_MS
+#define CAMERA_PREFETCH_MAX_AGE_MS 250
+#endif
+
+// Longest init() waits for its test capture
+#ifndef CAMERA_INIT_WAIT_MS
+#define CAMERA_INIT_WAIT_MS 1000
+#endif
+
+// Captures are slept through for this much of the expected capture time
+// before CAP_DONE is polled
+#ifndef CAMERA_CAPTURE_SLEEP_PERCENT
+#define CAMERA_CAPTURE_SLEEP_PERCENT 80
+#endif
+
+// Most tasks that can block in waitForFrame() at once.  Any more poll the
+// frame ring once per tick instead.
+#ifndef CAMERA_MAX_FRAME_WAITERS
+#define CAMERA_MAX_FRAME_WAITERS 4
+#endif
+
+// Frame that last triggered a motion event, with MotionAction::CAPTURE
+#define MOTION_CAPTURE_FILE "/motion.jpg"
 
 #ifndef _CAMERA_CONTROLLER_H
 #define _CAMERA_CONTROLLER_H
 
-struct CameraFrame {
-  uint8_t bytes[MAX_CAMERA_FRAME_SIZE];
-  size_t length;
+// Running totals for the capture/send pipeline.  Several fields are bumped
+// from more than one task (capture task, web server, WebSocket loop), so
+// they're updated with relaxed atomic adds like Histogram.
+struct CameraStats {
+  std::atomic<uint32_t> framesCaptured;
+  std::atomic<uint32_t> captureFailures;
+  std::atomic<uint32_t> bytesCaptured;
+  std::atomic<uint32_t> captureMicros;
+  // Frames too big for their slot that couldn't be grown to fit
+  std::atomic<uint32_t> framesDropped;
+  // Captures put off because no frame slot could be allocated
+  std::atomic<uint32_t> noMemoryStalls;
+  // Frames whose capture was started ahead of time, and such captures that
+  // went stale before anyone asked for them
+  std::atomic<uint32_t> framesPrefetched;
+  std::atomic<uint32_t> prefetchesDiscarded;
+  // Captures that weren't done within their timeout
+  std::atomic<uint32_t> captureTimeouts;
+  // CAP_DONE reads while waiting for captures, and captures waited on
+  std::atomic<uint32_t> capturePolls;
+  std::atomic<uint32_t> capturesWaited;
+
+  std::atomic<uint32_t> framesSent;
+  std::atomic<uint32_t> framesSkipped;
+  std::atomic<uint32_t> bytesCopied;
+  std::atomic<uint32_t> frameWaitMicros;
+  // Snapshots served from an already-captured frame
+  std::atomic<uint32_t> snapshotsReused;
+};
+
+struct MotionStatus {
+  MotionResult lastResult;
+  uint32_t lastAnalyzedAt;
+  uint32_t framesAnalyzed;
+  uint32_t parseFailures;
+  uint32_t analyzeMicros;
+  uint32_t events;
+  // millis() of the last event, 0 if there hasn't been one
+  uint32_t lastEventAt;
 };
 
+// Per-client read cursor into the frame ring
 struct CameraBuffer {
-  CameraBuffer(const CameraFrame& frame);
+  CameraBuffer(uint32_t lastSequence, uint16_t targetFps);
 
   void reset();
+  void setFrame(FrameRing::FrameRef&& frame);
+  bool hasFrame() const;
   size_t copy(uint8_t* buffer, size_t maxLen);
   bool done();
 
-  const CameraFrame& frame;
+  FrameRing::FrameRef frame;
+  FramePacer pacer;
+  uint32_t lastSequence;
+  // Last frame whose send time was recorded
+  uint32_t sentSequence;
   size_t bufferIx;
   bool readStarted;
 };
@@ -32,28 +113,75 @@ struct CameraBuffer {
 class CameraController {
 public:
   typedef std::function<size_t(uint8_t*, size_t, size_t)> CallbackFn;
+  // Called from the capture task
+  typedef std::function<void(const MotionResult&)> MotionHandler;
 
   class CameraStream {
   public:
     CameraStream(ArduCAM& camera);
 
     size_t read(uint8_t* buffer, size_t maxLen);
-    void open();
     void close();
 
+    // Starts a capture.  Poll captureDone() (see waitForCapture()), then call
+    // beginRead() before reading.
+    void trigger();
+    bool captureDone();
+    bool beginRead();
+
+    size_t remaining() const;
+
+    // Whether a capture has been triggered and not yet read, and when
+    bool isTriggered() const;
+    uint32_t getTriggeredAt() const;
+    uint32_t getTriggeredAtMicros() const;
+
   private:
     ArduCAM& camera;
 
     volatile size_t bytesRemaining;
     volatile bool isOpen;
+    volatile bool triggered;
+    uint32_t triggeredAt;
+    uint32_t triggeredAtMicros;
   };
 
   CameraController(Settings& settings);
 
   void init();
-  const CameraFrame& getCameraFrame();
 
-  CallbackFn chunkedResponseCallback(bool continuous = false);
+  // targetFps only applies to continuous responses.  0 sends frames as fast
+  // as the client drains them.
+  CallbackFn chunkedResponseCallback(bool continuous = false, uint16_t targetFps = 0);
+
+  // Streams straight from the camera FIFO into the response buffer instead of
+  // going through the frame ring.  Avoids a full-frame copy and doesn't need
+  // memory for the frame, but holds the camera exclusively while sending, so
+  // other clients stall until it finishes.
+  CallbackFn directResponseCallback(bool continuous = false, uint16_t targetFps = 0);
+
+  // Returns the newest frame if it was captured within maxAgeMs, and waits for
+  // a new one otherwise.  The ref is empty if the wait times out.
+  FrameRing::FrameRef acquireSnapshot(uint32_t maxAgeMs);
+
+  // Never blocks.  Returns the newest frame if it's newer than the provided
+  // sequence number.  Otherwise asks the capture task for one and returns an
+  // empty ref; poll again later.
+  FrameRing::FrameRef pollFrame(uint32_t newerThan);
+
+  const CameraStats& getStats() const;
+  // How long captures at the current resolution have been taking, 0 if
+  // unknown
+  uint32_t getExpectedCaptureMicros() const;
+  FrameArenaInfo getArenaInfo();
+
+  // Called for each motion event (subject to motion.cooldown_ms), after any
+  // capture the event calls for.
+  void onMotion(MotionHandler handler);
+
+  // Copies the latest motion state.  If grid is non-NULL, it's filled with
+  // the last analyzed frame's MOTION_GRID_CELLS brightness values.
+  MotionStatus getMotionStatus(uint8_t* grid = NULL);
 
 private:
   ArduCAM camera;
@@ -62,13 +190,54 @@ private:
   static void readCameraFrame(void*);
   void readCameraFrame();
 
-  std::shared_ptr<CameraFrame> cameraFrame;
+  // Requests a capture if necessary and blocks until a frame newer than the
+  // provided sequence number is available, or until the wait times out.
+  FrameRing::FrameRef waitForFrame(uint32_t newerThan);
+
+  FrameRing frameRing;
+  CameraStats stats;
+
+  // Resolution the sensor and frame ring are set up for.  Only changed on the
+  // capture task once init() has run.
+  CameraResolution appliedResolution;
+  void applyResolution(CameraResolution resolution);
+
+  // Only analyzes frames on the capture task
+  MotionDetector motionDetector;
+  // Both guarded by motionMtx
+  MotionStatus motionStatus;
+  MotionHandler motionHandler;
+  SemaphoreHandle_t motionMtx;
+
+  void detectMotion(const CameraFrame& frame);
+
+  // Blocks until the triggered capture is done, giving up after timeoutMs.
+  // Sleeps through most of the capture time expected at this resolution,
+  // then polls CAP_DONE once per tick.  Requires cameraMtx.
+  bool waitForCapture(uint32_t timeoutMs = CAMERA_FRAME_WAIT_MS);
+
+  // Moving average of the time from trigger to CAP_DONE, per resolution.
+  // Guarded by cameraMtx.
+  uint32_t captureEstimates[static_cast<size_t>(CameraResolution::d1600x1200) + 1];
+
+  // Triggers a capture unless a recent enough one is already under way.
+  // Returns true if it was already under way.  Requires cameraMtx.
+  bool ensureTriggered();
 
   CameraStream captureStream;
   TaskHandle_t copyTask;
   SemaphoreHandle_t readFrameMtx;
-  SemaphoreHandle_t sendFrameMtx;
-  SemaphoreHandle_t bufferMtx;
+  SemaphoreHandle_t cameraMtx;
+
+  // Tasks blocked in waitForFrame(), notified each time a frame is published.
+  // Notifications latch, so one sent between a waiter checking the ring and
+  // going to sleep wakes it straight away.
+  TaskHandle_t frameWaiters[CAMERA_MAX_FRAME_WAITERS];
+  SemaphoreHandle_t frameWaitersMtx;
+
+  bool addFrameWaiter(TaskHandle_t task);
+  void removeFrameWaiter(TaskHandle_t task);
+  void notifyFrameWaiters();
 };
 
 #endif
\ No newline at end of file
@@ -35,3 +35,43 @@ CameraResolution CameraTypes::cameraResolutionFromStr(const String& s) {
   else if (s.equalsIgnoreCase("d1280x1024")) return CameraResolution::d1280x1024;
   else return CameraResolution::d1600x1200;
 }
+
+size_t CameraTypes::expectedFrameSize(const CameraResolution v) {
+  switch (v) {
+    case CameraResolution::d160x120:
+    case CameraResolution::d176x144:
+      return 8 * 1024;
+    case CameraResolution::d320x240:
+    case CameraResolution::d352x288:
+      return 16 * 1024;
+    case CameraResolution::d640x480:
+      return 32 * 1024;
+    case CameraResolution::d800x600:
+      return 40 * 1024;
+    case CameraResolution::d1024x768:
+      return 64 * 1024;
+    case CameraResolution::d1280x1024:
+      return 96 * 1024;
+    case CameraResolution::d1600x1200:
+    default:
+      return 128 * 1024;
+  }
+}
+
+String CameraTypes::motionActionToStr(const MotionAction v) {
+  switch (v) {
+    case MotionAction::CAPTURE:
+      return "capture";
+    case MotionAction::DISPENSE:
+      return "dispense";
+    case MotionAction::NONE:
+    default:
+      return "none";
+  }
+}
+
+MotionAction CameraTypes::motionActionFromStr(const String& s) {
+  if (s.equalsIgnoreCase("capture")) return MotionAction::CAPTURE;
+  else if (s.equalsIgnoreCase("dispense")) return MotionAction::DISPENSE;
+  else return MotionAction::NONE;
+}
@@ -8,10 +8,21 @@ enum class CameraResolution {
   d1024x768, d1280x1024, d1600x1200
 };
 
+// What to do when motion is detected
+enum class MotionAction {
+  NONE, CAPTURE, DISPENSE
+};
+
 class CameraTypes {
 public:
   static String cameraResolutionToStr(const CameraResolution resolution);
   static CameraResolution cameraResolutionFromStr(const String& str);
+  // Room to reserve per frame at a resolution.  Most frames fit; the frame
+  // ring grows for any that don't.
+  static size_t expectedFrameSize(const CameraResolution resolution);
+
+  static String motionActionToStr(const MotionAction action);
+  static MotionAction motionActionFromStr(const String& str);
 };
 
 #endif
\ No newline at end of file
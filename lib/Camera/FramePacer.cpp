@@ -0,0 +1,41 @@
+#include <FramePacer.h>
+
+FramePacer::FramePacer(uint16_t targetFps)
+  : targetIntervalMs(targetFps > 0 ? 1000 / targetFps : 0)
+  , intervalMs(targetIntervalMs)
+  , frameStartMs(0)
+  , started(false)
+{ }
+
+void FramePacer::frameStarted(uint32_t nowMs) {
+  this->frameStartMs = nowMs;
+  this->started = true;
+}
+
+void FramePacer::frameFinished(uint32_t nowMs) {
+  if (targetIntervalMs == 0) {
+    return;
+  }
+
+  const uint32_t drainMs = nowMs - frameStartMs;
+
+  if (drainMs > intervalMs) {
+    // Client couldn't keep up.  Leave some slack so its window can empty.
+    this->intervalMs = std::min<uint32_t>(drainMs + drainMs / 4, CAMERA_PACING_MAX_INTERVAL_MS);
+  } else if (intervalMs > targetIntervalMs) {
+    this->intervalMs -= std::max<uint32_t>((intervalMs - targetIntervalMs) / 4, 1);
+  }
+}
+
+uint32_t FramePacer::msUntilDue(uint32_t nowMs) const {
+  if (!started || targetIntervalMs == 0) {
+    return 0;
+  }
+
+  const uint32_t elapsed = nowMs - frameStartMs;
+  return elapsed >= intervalMs ? 0 : intervalMs - elapsed;
+}
+
+uint32_t FramePacer::getIntervalMs() const {
+  return intervalMs;
+}
@@ -0,0 +1,41 @@
+#include <Arduino.h>
+
+// Longest the pacer will hold up the web server task waiting for a frame to
+// come due.  Longer waits hand control back and rely on the server polling
+// the response again.
+#ifndef CAMERA_PACING_MAX_BLOCK_MS
+#define CAMERA_PACING_MAX_BLOCK_MS 100
+#endif
+
+// Ceiling for the interval when backing off from a slow client
+#ifndef CAMERA_PACING_MAX_INTERVAL_MS
+#define CAMERA_PACING_MAX_INTERVAL_MS 5000
+#endif
+
+#ifndef _FRAME_PACER_H
+#define _FRAME_PACER_H
+
+// Decides when a streaming client should get its next frame.  Starts at the
+// target frame rate and stretches the interval when a client takes longer to
+// drain a frame than the interval allows (i.e., its send window is full),
+// recovering gradually once it catches up.
+class FramePacer {
+public:
+  // A target of 0 disables pacing
+  FramePacer(uint16_t targetFps);
+
+  void frameStarted(uint32_t nowMs);
+  void frameFinished(uint32_t nowMs);
+
+  // 0 if the next frame is due
+  uint32_t msUntilDue(uint32_t nowMs) const;
+  uint32_t getIntervalMs() const;
+
+private:
+  const uint32_t targetIntervalMs;
+  uint32_t intervalMs;
+  uint32_t frameStartMs;
+  bool started;
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include <FrameRing.h>
+
+static bool usePsram() {
+#if defined(BOARD_HAS_PSRAM)
+  return psramFound();
+#else
+  return false;
+#endif
+}
+
+static uint8_t* allocateFrameBuffer(size_t size) {
+#if defined(ESP32)
+  const uint32_t caps = usePsram() ? (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : MALLOC_CAP_8BIT;
+  return static_cast<uint8_t*>(heap_caps_malloc(size, caps));
+#else
+  return static_cast<uint8_t*>(malloc(size));
+#endif
+}
+
+static void freeFrameBuffer(uint8_t* bytes) {
+#if defined(ESP32)
+  heap_caps_free(bytes);
+#else
+  free(bytes);
+#endif
+}
+
+static size_t roundUpToIncrement(size_t size) {
+  return ((size + CAMERA_FRAME_SIZE_INCREMENT - 1) / CAMERA_FRAME_SIZE_INCREMENT) * CAMERA_FRAME_SIZE_INCREMENT;
+}
+
+FrameRing::FrameRef::FrameRef()
+  : ring(NULL)
+  , slotIx(0)
+{ }
+
+FrameRing::FrameRef::FrameRef(FrameRing* ring, size_t slotIx)
+  : ring(ring)
+  , slotIx(slotIx)
+{ }
+
+FrameRing::FrameRef::FrameRef(FrameRef&& other)
+  : ring(other.ring)
+  , slotIx(other.slotIx)
+{
+  other.ring = NULL;
+}
+
+FrameRing::FrameRef::~FrameRef() {
+  release();
+}
+
+FrameRing::FrameRef& FrameRing::FrameRef::operator=(FrameRef&& other) {
+  if (this != &other) {
+    release();
+
+    this->ring = other.ring;
+    this->slotIx = other.slotIx;
+    other.ring = NULL;
+  }
+
+  return *this;
+}
+
+void FrameRing::FrameRef::release() {
+  if (this->ring != NULL) {
+    this->ring->release(this->slotIx);
+    this->ring = NULL;
+  }
+}
+
+FrameRing::FrameRef::operator bool() const {
+  return this->ring != NULL;
+}
+
+const CameraFrame& FrameRing::FrameRef::frame() const {
+  return *this->ring->slots[this->slotIx].frame;
+}
+
+uint32_t FrameRing::FrameRef::sequence() const {
+  return this->ring->slots[this->slotIx].sequence;
+}
+
+uint32_t FrameRing::FrameRef::capturedAt() const {
+  return this->ring->slots[this->slotIx].capturedAt;
+}
+
+FrameRing::FrameRing(size_t numSlots)
+  : numSlots(numSlots)
+  , latestIx(NO_SLOT)
+  , writeIx(NO_SLOT)
+  , sequence(0)
+  , slotSize(0)
+  , allocationFailures(0)
+  , lastFailureAt(0)
+  , mutex(xSemaphoreCreateMutex())
+{
+  // Constructed globally, before the capture task exists to attribute this to
+  HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::CAMERA);
+
+  slots.reset(new Slot[numSlots]);
+
+  // Buffers are allocated separately, once the frame size is known.  A
+  // single contiguous block this size is unlikely to be available.
+  for (size_t i = 0; i < numSlots; ++i) {
+    slots[i].frame = new CameraFrame();
+    slots[i].frame->bytes = NULL;
+    slots[i].frame->length = 0;
+    slots[i].frame->capacity = 0;
+    slots[i].sizedFor = 0;
+    slots[i].sequence = 0;
+    slots[i].capturedAt = 0;
+    slots[i].refs = 0;
+  }
+}
+
+FrameRing::~FrameRing() {
+  for (size_t i = 0; i < numSlots; ++i) {
+    freeFrameBuffer(slots[i].frame->bytes);
+    delete slots[i].frame;
+  }
+  vSemaphoreDelete(mutex);
+}
+
+bool FrameRing::canRetry() const {
+  return allocationFailures == 0 || millis() - lastFailureAt >= CAMERA_FRAME_RETRY_MS;
+}
+
+bool FrameRing::allocate(CameraFrame* frame, size_t size, size_t minSize) {
+  // Free first.  There may not be room for both.
+  freeFrameBuffer(frame->bytes);
+  frame->bytes = NULL;
+  frame->length = 0;
+  frame->capacity = 0;
+
+  if (size == 0) {
+    return true;
+  }
+
+  size_t attempt = size;
+
+  while (true) {
+    frame->bytes = allocateFrameBuffer(attempt);
+
+    if (frame->bytes != NULL) {
+      frame->capacity = attempt;
+      break;
+    }
+
+    const size_t next = std::max(roundUpToIncrement(attempt / 2), minSize);
+    if (next >= attempt) {
+      break;
+    }
+    attempt = next;
+  }
+
+  if (frame->capacity < size) {
+    ++allocationFailures;
+    lastFailureAt = millis();
+    return false;
+  }
+
+  return true;
+}
+
+void FrameRing::allocateSlot(Slot& slot) {
+  slot.sizedFor = slotSize;
+  allocate(slot.frame, slotSize, std::min(slotSize, static_cast<size_t>(CAMERA_FRAME_MIN_SLOT_SIZE)));
+}
+
+void FrameRing::setSlotSize(size_t slotSize) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  this->slotSize = slotSize;
+
+  for (size_t i = 0; i < numSlots; ++i) {
+    const CameraFrame* frame = slots[i].frame;
+
+    if (static_cast<int>(i) != latestIx
+      && static_cast<int>(i) != writeIx
+      && slots[i].refs == 0
+      && (slots[i].sizedFor != slotSize || frame->capacity != slotSize)) {
+      allocateSlot(slots[i]);
+    }
+  }
+
+  xSemaphoreGive(mutex);
+}
+
+FrameArenaInfo FrameRing::getArenaInfo() {
+  FrameArenaInfo info;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  info.slotSize = slotSize;
+  info.totalBytes = 0;
+  info.psram = usePsram();
+  info.allocationFailures = allocationFailures;
+  info.slots = numSlots;
+  info.slotsAllocated = 0;
+
+  size_t fullSize = 0;
+
+  for (size_t i = 0; i < numSlots; ++i) {
+    const size_t capacity = slots[i].frame->capacity;
+
+    info.totalBytes += capacity;
+    info.slotsAllocated += capacity > 0 ? 1 : 0;
+    fullSize += capacity >= slotSize ? 1 : 0;
+  }
+
+  xSemaphoreGive(mutex);
+
+  if (slotSize > 0 && info.slotsAllocated == 0) {
+    info.state = FrameArenaState::OUT_OF_MEMORY;
+  } else if (fullSize < numSlots) {
+    info.state = FrameArenaState::DEGRADED;
+  } else {
+    info.state = FrameArenaState::OK;
+  }
+
+  return info;
+}
+
+const char* FrameRing::stateToStr(FrameArenaState state) {
+  switch (state) {
+    case FrameArenaState::DEGRADED:
+      return "degraded";
+    case FrameArenaState::OUT_OF_MEMORY:
+      return "out_of_memory";
+    case FrameArenaState::OK:
+    default:
+      return "ok";
+  }
+}
+
+CameraFrame* FrameRing::beginWrite() {
+  CameraFrame* frame = NULL;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  for (size_t i = 0; i < numSlots && frame == NULL; ++i) {
+    Slot& slot = slots[i];
+
+    if (static_cast<int>(i) != latestIx && slot.refs == 0) {
+      // Left over from a resize, or short of memory last time.  The latter
+      // waits a while, so a heap that's full doesn't get hit every frame.
+      if (slot.sizedFor != slotSize || (slot.frame->capacity < slotSize && canRetry())) {
+        allocateSlot(slot);
+      }
+
+      if (slot.frame->capacity == 0) {
+        continue;
+      }
+
+      writeIx = i;
+      frame = slot.frame;
+    }
+  }
+
+  if (frame == NULL && latestIx != NO_SLOT && slots[latestIx].refs == 0 && slots[latestIx].frame->capacity > 0) {
+    writeIx = latestIx;
+    latestIx = NO_SLOT;
+    frame = slots[writeIx].frame;
+  }
+
+  xSemaphoreGive(mutex);
+
+  return frame;
+}
+
+bool FrameRing::reserve(CameraFrame* frame, size_t size) {
+  if (size <= frame->capacity) {
+    return true;
+  }
+
+  const size_t rounded = roundUpToIncrement(size);
+  bool resized = false;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  // Otherwise keep the buffer the slot has rather than give it up for an
+  // attempt that's likely to fail again
+  if (canRetry()) {
+    const size_t previous = frame->capacity;
+
+    resized = allocate(frame, rounded, rounded);
+
+    if (resized) {
+      // Frames this big are likely to keep coming.  Grow the other slots as
+      // they're next written rather than one oversized frame at a time.
+      slotSize = std::max(slotSize, rounded);
+    } else {
+      // Put back what was there so the slot is still usable for smaller frames
+      allocate(frame, previous, std::min(previous, static_cast<size_t>(CAMERA_FRAME_MIN_SLOT_SIZE)));
+    }
+  }
+
+  xSemaphoreGive(mutex);
+
+  return resized;
+}
+
+void FrameRing::commitWrite(uint32_t capturedAt) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  if (writeIx != NO_SLOT) {
+    slots[writeIx].sequence = ++sequence;
+    slots[writeIx].capturedAt = capturedAt;
+    latestIx = writeIx;
+    writeIx = NO_SLOT;
+  }
+
+  xSemaphoreGive(mutex);
+}
+
+void FrameRing::abortWrite() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  writeIx = NO_SLOT;
+  xSemaphoreGive(mutex);
+}
+
+FrameRing::FrameRef FrameRing::acquireNewerThan(uint32_t sequence) {
+  int slotIx = NO_SLOT;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  if (latestIx != NO_SLOT && slots[latestIx].sequence > sequence) {
+    slotIx = latestIx;
+    ++slots[slotIx].refs;
+  }
+
+  xSemaphoreGive(mutex);
+
+  if (slotIx == NO_SLOT) {
+    return FrameRef();
+  } else {
+    return FrameRef(this, slotIx);
+  }
+}
+
+uint32_t FrameRing::latestSequence() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint32_t result = this->sequence;
+  xSemaphoreGive(mutex);
+
+  return result;
+}
+
+void FrameRing::release(size_t slotIx) {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  --slots[slotIx].refs;
+  xSemaphoreGive(mutex);
+}
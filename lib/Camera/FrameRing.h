@@ -0,0 +1,165 @@
+#include <Arduino.h>
+#include <memory>
+#include <HeapAccounting.h>
+
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+extern "C" {
+  #include "freertos/semphr.h"
+}
+#endif
+
+// Slots that have to grow for an oversized frame are rounded up to this
+#define CAMERA_FRAME_SIZE_INCREMENT 4096
+
+// When there isn't room for a full-size slot, smaller ones are tried, down to
+// this.  Most frames are well under the size expected for their resolution.
+#ifndef CAMERA_FRAME_MIN_SLOT_SIZE
+#define CAMERA_FRAME_MIN_SLOT_SIZE 16384
+#endif
+
+// After an allocation comes up short, slots aren't reallocated (or grown for
+// oversized frames) again for this long
+#ifndef CAMERA_FRAME_RETRY_MS
+#define CAMERA_FRAME_RETRY_MS 1000
+#endif
+
+// One slot is being written by the capture task, one holds the newest frame,
+// and the rest absorb readers still draining an older frame.
+#ifndef CAMERA_FRAME_RING_SIZE
+#define CAMERA_FRAME_RING_SIZE 3
+#endif
+
+#ifndef _FRAME_RING_H
+#define _FRAME_RING_H
+
+struct CameraFrame {
+  uint8_t* bytes;
+  size_t length;
+  // Bytes allocated at bytes
+  size_t capacity;
+};
+
+enum class FrameArenaState {
+  // Every slot has a full-size buffer
+  OK,
+  // Some slots have a smaller buffer or none at all
+  DEGRADED,
+  // No slot has a buffer, so nothing can be captured
+  OUT_OF_MEMORY
+};
+
+struct FrameArenaInfo {
+  size_t slotSize;
+  // Bytes allocated across all slots
+  size_t totalBytes;
+  bool psram;
+  // Slot allocations that came up short
+  uint32_t allocationFailures;
+  size_t slots;
+  // Slots with a buffer, full-size or not
+  size_t slotsAllocated;
+  FrameArenaState state;
+};
+
+// Fixed set of frame slots shared between a single producer (the capture task)
+// and any number of readers.  Readers pin the slot they're sending with a
+// reference count, so the producer never overwrites a frame that's in flight
+// and never waits on a slow reader -- it just fills a different slot.
+//
+// Slot buffers are allocated once, by setSlotSize(), in PSRAM when the board
+// has it.  They're only reallocated when the slot size changes (e.g., with the
+// camera resolution) or a frame doesn't fit.  Without PSRAM there may not be
+// room for every slot at full size.  The ring then makes do with smaller or
+// fewer slots, and tries again every CAMERA_FRAME_RETRY_MS.
+class FrameRing {
+public:
+  // Pins a slot for as long as it's alive.  Move-only.
+  class FrameRef {
+  public:
+    FrameRef();
+    FrameRef(FrameRing* ring, size_t slotIx);
+    FrameRef(FrameRef&& other);
+    ~FrameRef();
+
+    FrameRef& operator=(FrameRef&& other);
+    FrameRef(const FrameRef&) = delete;
+    FrameRef& operator=(const FrameRef&) = delete;
+
+    void release();
+    explicit operator bool() const;
+
+    const CameraFrame& frame() const;
+    uint32_t sequence() const;
+    // millis() when the frame was committed, or when its capture was
+    // triggered if that happened ahead of time
+    uint32_t capturedAt() const;
+
+  private:
+    FrameRing* ring;
+    size_t slotIx;
+  };
+
+  FrameRing(size_t numSlots = CAMERA_FRAME_RING_SIZE);
+  ~FrameRing();
+
+  // Sizes every slot for frames of slotSize bytes.  Slots that aren't in use
+  // are reallocated now, the rest when they're next written.
+  void setSlotSize(size_t slotSize);
+  FrameArenaInfo getArenaInfo();
+  static const char* stateToStr(FrameArenaState state);
+
+  // Producer side.  beginWrite() returns NULL if every slot is either the
+  // newest frame or pinned by a reader, or if no slot could be allocated (see
+  // getArenaInfo()).  If only one slot could be allocated, the newest frame is
+  // overwritten once nobody is reading it.
+  CameraFrame* beginWrite();
+  // Grows the slot being written to fit a frame of size bytes, and the slot
+  // size along with it.  False if there wasn't enough memory, or an
+  // allocation failed too recently to try again, in which case the frame
+  // should be dropped.
+  bool reserve(CameraFrame* frame, size_t size);
+  void commitWrite(uint32_t capturedAt);
+  void abortWrite();
+
+  // Consumer side.  Returns an empty ref if the newest frame isn't newer than
+  // the provided sequence number.  Pass 0 to get the newest frame, if any.
+  FrameRef acquireNewerThan(uint32_t sequence);
+  uint32_t latestSequence();
+
+private:
+  static const int NO_SLOT = -1;
+
+  struct Slot {
+    CameraFrame* frame;
+    // The slot size it was last allocated for.  Its capacity may be smaller.
+    size_t sizedFor;
+    uint32_t sequence;
+    uint32_t capturedAt;
+    uint8_t refs;
+  };
+
+  const size_t numSlots;
+  std::unique_ptr<Slot[]> slots;
+  int latestIx;
+  int writeIx;
+  uint32_t sequence;
+
+  size_t slotSize;
+  uint32_t allocationFailures;
+  // millis() of the last allocation that came up short
+  uint32_t lastFailureAt;
+
+  SemaphoreHandle_t mutex;
+
+  void release(size_t slotIx);
+  // These require the mutex
+  bool canRetry() const;
+  void allocateSlot(Slot& slot);
+  // Replaces frame's buffer with one of up to size bytes, settling for less
+  // (down to minSize) if that's all there's room for.  False if it came up
+  // short.
+  bool allocate(CameraFrame* frame, size_t size, size_t minSize);
+};
+
+#endif
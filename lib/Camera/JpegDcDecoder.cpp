@@ -0,0 +1,490 @@
+#include <JpegDcDecoder.h>
+#include <string.h>
+
+static const uint8_t MARKER_SOF0 = 0xC0;
+static const uint8_t MARKER_SOF1 = 0xC1;
+static const uint8_t MARKER_DHT = 0xC4;
+static const uint8_t MARKER_SOI = 0xD8;
+static const uint8_t MARKER_EOI = 0xD9;
+static const uint8_t MARKER_SOS = 0xDA;
+static const uint8_t MARKER_DQT = 0xDB;
+static const uint8_t MARKER_DRI = 0xDD;
+
+static inline uint16_t readU16(const uint8_t* p) {
+  return (p[0] << 8) | p[1];
+}
+
+JpegDcDecoder::JpegDcDecoder()
+  : numComponents(0)
+  , width(0)
+  , height(0)
+  , restartInterval(0)
+{ }
+
+uint16_t JpegDcDecoder::getWidth() const {
+  return width;
+}
+
+uint16_t JpegDcDecoder::getHeight() const {
+  return height;
+}
+
+bool JpegDcDecoder::decode(const uint8_t* data, size_t length, uint8_t* grid, uint8_t gridWidth, uint8_t gridHeight) {
+  if (length < 4 || data[0] != 0xFF || data[1] != MARKER_SOI || gridWidth * gridHeight > 256) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < MAX_TABLES; ++i) {
+    dcTables[i].defined = false;
+    acTables[i].defined = false;
+    dcQuant[i] = 1;
+  }
+  numComponents = 0;
+  restartInterval = 0;
+
+  size_t i = 2;
+
+  while (i + 4 <= length) {
+    if (data[i] != 0xFF) {
+      return false;
+    }
+
+    const uint8_t marker = data[i + 1];
+
+    // Fill bytes
+    if (marker == 0xFF) {
+      ++i;
+      continue;
+    }
+    if (marker == MARKER_EOI) {
+      return false;
+    }
+
+    const size_t segmentLength = readU16(data + i + 2);
+    const uint8_t* segment = data + i + 4;
+
+    if (segmentLength < 2 || i + 2 + segmentLength > length) {
+      return false;
+    }
+
+    const size_t bodyLength = segmentLength - 2;
+    bool ok = true;
+
+    switch (marker) {
+      case MARKER_DQT:
+        ok = parseQuantTables(segment, bodyLength);
+        break;
+      case MARKER_DHT:
+        ok = parseHuffmanTables(segment, bodyLength);
+        break;
+      case MARKER_SOF0:
+      case MARKER_SOF1:
+        ok = parseFrame(segment, bodyLength);
+        break;
+      case MARKER_DRI:
+        ok = bodyLength >= 2;
+        restartInterval = ok ? readU16(segment) : 0;
+        break;
+      case MARKER_SOS:
+        pos = segment + bodyLength;
+        end = data + length;
+        return decodeScan(segment, bodyLength, grid, gridWidth, gridHeight);
+      default:
+        // Progressive, lossless and arithmetic-coded frames aren't supported
+        if (marker >= 0xC2 && marker <= 0xCF && marker != MARKER_DHT && marker != 0xC8 && marker != 0xCC) {
+          return false;
+        }
+        break;
+    }
+
+    if (! ok) {
+      return false;
+    }
+
+    i += 2 + segmentLength;
+  }
+
+  return false;
+}
+
+bool JpegDcDecoder::parseQuantTables(const uint8_t* segment, size_t length) {
+  size_t i = 0;
+
+  while (i < length) {
+    const uint8_t precision = segment[i] >> 4;
+    const uint8_t id = segment[i] & 0xF;
+    const size_t tableLength = 64 * (precision ? 2 : 1);
+
+    if (id >= MAX_TABLES || i + 1 + tableLength > length) {
+      return false;
+    }
+
+    // Only the DC term is needed
+    dcQuant[id] = precision ? readU16(segment + i + 1) : segment[i + 1];
+    i += 1 + tableLength;
+  }
+
+  return true;
+}
+
+bool JpegDcDecoder::parseHuffmanTables(const uint8_t* segment, size_t length) {
+  size_t i = 0;
+
+  while (i + 17 <= length) {
+    const uint8_t tableClass = segment[i] >> 4;
+    const uint8_t id = segment[i] & 0xF;
+    const uint8_t* counts = segment + i + 1;
+
+    if (tableClass > 1 || id >= MAX_TABLES) {
+      return false;
+    }
+
+    size_t numSymbols = 0;
+    for (uint8_t l = 0; l < 16; ++l) {
+      numSymbols += counts[l];
+    }
+
+    if (numSymbols > 256 || i + 17 + numSymbols > length) {
+      return false;
+    }
+
+    HuffmanTable& table = tableClass == 0 ? dcTables[id] : acTables[id];
+    memcpy(table.symbols, segment + i + 17, numSymbols);
+    memset(table.lookahead, 0, sizeof(table.lookahead));
+
+    // Canonical code assignment (JPEG spec, Annex C)
+    int32_t code = 0;
+    int32_t symbolIx = 0;
+
+    for (uint8_t l = 1; l <= 16; ++l) {
+      const uint8_t count = counts[l - 1];
+
+      table.valueOffset[l] = symbolIx - code;
+
+      if (count > 0) {
+        if (l <= LOOKAHEAD_BITS) {
+          for (uint8_t c = 0; c < count; ++c) {
+            const uint16_t entry = (l << 8) | table.symbols[symbolIx + c];
+            const uint8_t shift = LOOKAHEAD_BITS - l;
+
+            for (uint16_t fill = 0; fill < (1 << shift); ++fill) {
+              table.lookahead[((code + c) << shift) | fill] = entry;
+            }
+          }
+        }
+
+        code += count;
+        symbolIx += count;
+        table.maxCode[l] = code - 1;
+      } else {
+        table.maxCode[l] = -1;
+      }
+
+      code <<= 1;
+    }
+
+    table.defined = true;
+    i += 17 + numSymbols;
+  }
+
+  return i == length;
+}
+
+bool JpegDcDecoder::parseFrame(const uint8_t* segment, size_t length) {
+  if (length < 6) {
+    return false;
+  }
+
+  height = readU16(segment + 1);
+  width = readU16(segment + 3);
+  numComponents = segment[5];
+
+  if (segment[0] != 8 || numComponents == 0 || numComponents > MAX_COMPONENTS || length < static_cast<size_t>(6 + 3 * numComponents)) {
+    return false;
+  }
+
+  for (uint8_t c = 0; c < numComponents; ++c) {
+    const uint8_t* spec = segment + 6 + 3 * c;
+
+    components[c].id = spec[0];
+    components[c].h = spec[1] >> 4;
+    components[c].v = spec[1] & 0xF;
+    components[c].quantTable = spec[2] & (MAX_TABLES - 1);
+
+    if (components[c].h == 0 || components[c].h > 4 || components[c].v == 0 || components[c].v > 4) {
+      return false;
+    }
+  }
+
+  return width > 0 && height > 0;
+}
+
+void JpegDcDecoder::fillBits() {
+  while (bitCount <= 24) {
+    uint8_t byte = 0;
+
+    if (pos < end) {
+      if (*pos != 0xFF) {
+        byte = *pos++;
+      } else if (pos + 1 < end && pos[1] == 0x00) {
+        // Stuffed byte
+        byte = 0xFF;
+        pos += 2;
+      } else {
+        // A marker.  Leave it for restart() and pad with zeros.
+        paddingBits += 8;
+      }
+    } else {
+      paddingBits += 8;
+    }
+
+    bitBuffer |= static_cast<uint32_t>(byte) << (24 - bitCount);
+    bitCount += 8;
+  }
+}
+
+uint32_t JpegDcDecoder::readBits(uint8_t n) {
+  if (n == 0) {
+    return 0;
+  }
+
+  fillBits();
+
+  const uint32_t bits = bitBuffer >> (32 - n);
+  bitBuffer <<= n;
+  bitCount -= n;
+
+  return bits;
+}
+
+int32_t JpegDcDecoder::receiveExtend(uint8_t n) {
+  const int32_t bits = readBits(n);
+
+  // Values with a leading 0 bit are negative (JPEG spec, F.2.2.1)
+  return (n > 0 && bits < (1 << (n - 1))) ? bits - (1 << n) + 1 : bits;
+}
+
+int16_t JpegDcDecoder::decodeSymbol(const HuffmanTable& table) {
+  fillBits();
+
+  const uint16_t entry = table.lookahead[bitBuffer >> (32 - LOOKAHEAD_BITS)];
+
+  if (entry != 0) {
+    const uint8_t length = entry >> 8;
+    bitBuffer <<= length;
+    bitCount -= length;
+    return entry & 0xFF;
+  }
+
+  int32_t code = 0;
+
+  for (uint8_t l = 1; l <= 16; ++l) {
+    code = (code << 1) | (bitBuffer >> 31);
+    bitBuffer <<= 1;
+    --bitCount;
+
+    if (code <= table.maxCode[l]) {
+      return table.symbols[table.valueOffset[l] + code];
+    }
+  }
+
+  // No such code
+  return -1;
+}
+
+bool JpegDcDecoder::skipAcCoefficients(const HuffmanTable& table) {
+  for (uint8_t k = 1; k < 64; ) {
+    const int16_t symbol = decodeSymbol(table);
+
+    if (symbol < 0) {
+      return false;
+    }
+
+    const uint8_t run = symbol >> 4;
+    const uint8_t size = symbol & 0xF;
+
+    if (size == 0) {
+      // 0xF0 is a run of 16 zeros, anything else ends the block
+      if (run != 15) {
+        break;
+      }
+      k += 16;
+    } else {
+      readBits(size);
+      k += run + 1;
+    }
+  }
+
+  return true;
+}
+
+bool JpegDcDecoder::restart() {
+  // Discard buffered bits and step over the RSTn marker
+  bitBuffer = 0;
+  bitCount = 0;
+  paddingBits = 0;
+
+  if (pos + 1 >= end || pos[0] != 0xFF || (pos[1] & 0xF8) != 0xD0) {
+    return false;
+  }
+
+  pos += 2;
+
+  for (uint8_t c = 0; c < numComponents; ++c) {
+    components[c].prediction = 0;
+  }
+
+  return true;
+}
+
+bool JpegDcDecoder::decodeScan(const uint8_t* segment, size_t length, uint8_t* grid, uint8_t gridWidth, uint8_t gridHeight) {
+  if (numComponents == 0 || length < 1) {
+    return false;
+  }
+
+  const uint8_t scanComponents = segment[0];
+
+  if (scanComponents == 0 || scanComponents > numComponents || length < static_cast<size_t>(1 + 2 * scanComponents + 3)) {
+    return false;
+  }
+
+  // Luma is the first component in the frame.  It has to be in this scan.
+  Component* scan[MAX_COMPONENTS];
+  int8_t lumaIx = -1;
+
+  for (uint8_t s = 0; s < scanComponents; ++s) {
+    const uint8_t id = segment[1 + 2 * s];
+    const uint8_t tables = segment[2 + 2 * s];
+
+    scan[s] = NULL;
+    for (uint8_t c = 0; c < numComponents; ++c) {
+      if (components[c].id == id) {
+        scan[s] = &components[c];
+      }
+    }
+
+    if (scan[s] == NULL) {
+      return false;
+    }
+
+    scan[s]->dcTable = (tables >> 4) & (MAX_TABLES - 1);
+    scan[s]->acTable = tables & (MAX_TABLES - 1);
+    scan[s]->prediction = 0;
+
+    if (! dcTables[scan[s]->dcTable].defined || ! acTables[scan[s]->acTable].defined) {
+      return false;
+    }
+
+    if (scan[s] == &components[0]) {
+      lumaIx = s;
+    }
+  }
+
+  if (lumaIx < 0) {
+    return false;
+  }
+
+  uint8_t maxH = 1, maxV = 1;
+  for (uint8_t c = 0; c < numComponents; ++c) {
+    maxH = components[c].h > maxH ? components[c].h : maxH;
+    maxV = components[c].v > maxV ? components[c].v : maxV;
+  }
+
+  // A single-component scan isn't interleaved: one block per MCU
+  const bool interleaved = scanComponents > 1;
+  const Component& luma = *scan[lumaIx];
+  const uint8_t lumaH = interleaved ? luma.h : 1;
+  const uint8_t lumaV = interleaved ? luma.v : 1;
+  // Luma pixels covered by one luma block
+  const uint16_t blockWidth = 8 * maxH / luma.h;
+  const uint16_t blockHeight = 8 * maxV / luma.v;
+
+  uint16_t mcusWide, mcusHigh;
+  if (interleaved) {
+    mcusWide = (width + 8 * maxH - 1) / (8 * maxH);
+    mcusHigh = (height + 8 * maxV - 1) / (8 * maxV);
+  } else {
+    mcusWide = (width * luma.h / maxH + 7) / 8;
+    mcusHigh = (height * luma.v / maxV + 7) / 8;
+  }
+
+  const uint16_t numCells = gridWidth * gridHeight;
+  memset(cellSums, 0, numCells * sizeof(cellSums[0]));
+  memset(cellCounts, 0, numCells * sizeof(cellCounts[0]));
+
+  const int32_t dcScale = dcQuant[luma.quantTable];
+
+  bitBuffer = 0;
+  bitCount = 0;
+  paddingBits = 0;
+
+  uint32_t mcusUntilRestart = restartInterval;
+
+  for (uint16_t mcuY = 0; mcuY < mcusHigh; ++mcuY) {
+    for (uint16_t mcuX = 0; mcuX < mcusWide; ++mcuX) {
+      if (restartInterval > 0) {
+        if (mcusUntilRestart == 0) {
+          if (! restart()) {
+            return false;
+          }
+          mcusUntilRestart = restartInterval;
+        }
+        --mcusUntilRestart;
+      }
+
+      for (uint8_t s = 0; s < scanComponents; ++s) {
+        Component& component = *scan[s];
+        const uint8_t blocksH = interleaved ? component.h : 1;
+        const uint8_t blocksV = interleaved ? component.v : 1;
+
+        for (uint8_t by = 0; by < blocksV; ++by) {
+          for (uint8_t bx = 0; bx < blocksH; ++bx) {
+            const int16_t category = decodeSymbol(dcTables[component.dcTable]);
+
+            if (category < 0 || category > 11) {
+              return false;
+            }
+
+            component.prediction += receiveExtend(category);
+
+            if (! skipAcCoefficients(acTables[component.acTable])) {
+              return false;
+            }
+
+            if (s != lumaIx) {
+              continue;
+            }
+
+            const uint32_t x = (mcuX * lumaH + bx) * blockWidth;
+            const uint32_t y = (mcuY * lumaV + by) * blockHeight;
+
+            // Blocks padding the image out to a whole MCU aren't shown
+            if (x >= width || y >= height) {
+              continue;
+            }
+
+            // The dequantized DC term is 8x the block's mean level-shifted
+            // sample value
+            int32_t mean = (component.prediction * dcScale) / 8 + 128;
+            mean = mean < 0 ? 0 : (mean > 255 ? 255 : mean);
+
+            const uint16_t cell = (y * gridHeight / height) * gridWidth + (x * gridWidth / width);
+            cellSums[cell] += mean;
+            ++cellCounts[cell];
+          }
+        }
+      }
+
+      // Consumed padding, so the data ended (or hit a marker) mid-MCU
+      if (paddingBits > bitCount) {
+        return false;
+      }
+    }
+  }
+
+  for (uint16_t cell = 0; cell < numCells; ++cell) {
+    grid[cell] = cellCounts[cell] ? cellSums[cell] / cellCounts[cell] : 0;
+  }
+
+  return true;
+}
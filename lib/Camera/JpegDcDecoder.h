@@ -0,0 +1,88 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef _JPEG_DC_DECODER_H
+#define _JPEG_DC_DECODER_H
+
+// Extracts a low-resolution luminance image from a baseline JPEG without
+// decoding it.  Only the entropy-coded data is walked: each luma block's DC
+// coefficient (its average brightness) is kept, and AC coefficients are
+// skipped over without being dequantized or transformed.  Blocks are averaged
+// into a grid of the requested size.
+//
+// Has no platform dependencies so it can be run against recorded frames on a
+// host.
+class JpegDcDecoder {
+public:
+  JpegDcDecoder();
+
+  // Fills grid (gridWidth * gridHeight cells, row-major) with average
+  // luminance (0-255).  Returns false if the image isn't a baseline JPEG or is
+  // truncated.
+  bool decode(const uint8_t* data, size_t length, uint8_t* grid, uint8_t gridWidth, uint8_t gridHeight);
+
+  uint16_t getWidth() const;
+  uint16_t getHeight() const;
+
+private:
+  static const uint8_t MAX_COMPONENTS = 3;
+  static const uint8_t MAX_TABLES = 4;
+  static const uint8_t LOOKAHEAD_BITS = 8;
+
+  struct HuffmanTable {
+    // Codes up to LOOKAHEAD_BITS long resolve in one lookup: (length << 8) |
+    // symbol, or 0 if the code is longer.
+    uint16_t lookahead[1 << LOOKAHEAD_BITS];
+    // Canonical decoding for longer codes, indexed by code length
+    int32_t maxCode[17];
+    int32_t valueOffset[17];
+    uint8_t symbols[256];
+    bool defined;
+  };
+
+  struct Component {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t quantTable;
+    uint8_t dcTable;
+    uint8_t acTable;
+    int16_t prediction;
+  };
+
+  HuffmanTable dcTables[MAX_TABLES];
+  HuffmanTable acTables[MAX_TABLES];
+  uint16_t dcQuant[MAX_TABLES];
+
+  Component components[MAX_COMPONENTS];
+  uint8_t numComponents;
+  uint16_t width;
+  uint16_t height;
+  uint16_t restartInterval;
+
+  // Entropy-coded segment reader
+  const uint8_t* pos;
+  const uint8_t* end;
+  uint32_t bitBuffer;
+  int8_t bitCount;
+  // Zero bits appended to bitBuffer past the end of the segment
+  int32_t paddingBits;
+
+  // Per-cell accumulators
+  uint32_t cellSums[256];
+  uint16_t cellCounts[256];
+
+  bool parseHuffmanTables(const uint8_t* segment, size_t length);
+  bool parseQuantTables(const uint8_t* segment, size_t length);
+  bool parseFrame(const uint8_t* segment, size_t length);
+  bool decodeScan(const uint8_t* segment, size_t length, uint8_t* grid, uint8_t gridWidth, uint8_t gridHeight);
+
+  void fillBits();
+  uint32_t readBits(uint8_t n);
+  int32_t receiveExtend(uint8_t n);
+  int16_t decodeSymbol(const HuffmanTable& table);
+  bool restart();
+  bool skipAcCoefficients(const HuffmanTable& table);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include <MotionDetector.h>
+
+static_assert(MOTION_GRID_CELLS % 4 == 0, "Motion grid must pack evenly into words");
+static_assert(MOTION_GRID_CELLS <= 256, "Motion grid is too large for the decoder");
+
+// Top bit of each byte lane
+static const uint32_t HIGH_BITS = 0x80808080;
+static const uint32_t LOW_BITS = 0x7F7F7F7F;
+
+static inline uint32_t broadcast(uint8_t value) {
+  return value * 0x01010101u;
+}
+
+// |a - b| in each 7-bit lane
+static inline uint32_t absoluteDifference(uint32_t a, uint32_t b) {
+  // Setting the guard bit before subtracting keeps borrows inside each lane.
+  // It survives exactly in the lanes where the result is non-negative.
+  const uint32_t aMinusB = (a | HIGH_BITS) - b;
+  const uint32_t bMinusA = (b | HIGH_BITS) - a;
+  const uint32_t guard = (aMinusB & HIGH_BITS) >> 7;
+  const uint32_t mask = (guard << 7) - guard;
+
+  return (aMinusB & mask) | (bMinusA & ~mask & LOW_BITS);
+}
+
+// Sets the guard bit in each lane where value > threshold
+static inline uint32_t greaterThan(uint32_t value, uint32_t thresholdPlusOne) {
+  return ((value | HIGH_BITS) - thresholdPlusOne) & HIGH_BITS;
+}
+
+// Rounded-down mean of each lane
+static inline uint32_t average(uint32_t a, uint32_t b) {
+  return (a & b) + (((a ^ b) & 0xFEFEFEFE) >> 1);
+}
+
+// Mean of each lane, rounded towards b.  Always moves a by at least one when
+// the lanes differ, so repeatedly averaging a towards b ends up at b.
+static inline uint32_t averageTowards(uint32_t a, uint32_t b) {
+  const uint32_t odd = (a ^ b) & 0x01010101;
+  const uint32_t bNotLess = (((b | HIGH_BITS) - a) & HIGH_BITS) >> 7;
+
+  return average(a, b) + (odd & bNotLess);
+}
+
+static inline uint8_t maxLane(uint32_t value) {
+  uint8_t result = 0;
+
+  for (uint8_t i = 0; i < 4; ++i, value >>= 8) {
+    result = (value & 0xFF) > result ? (value & 0xFF) : result;
+  }
+
+  return result;
+}
+
+MotionDetector::MotionDetector()
+  : hasBackground(false)
+  , threshold(8)
+  , minCells(4)
+  , backgroundShift(3)
+{ }
+
+void MotionDetector::configure(uint8_t threshold, uint16_t minCells, uint8_t backgroundShift) {
+  this->threshold = threshold > 126 ? 126 : threshold;
+  this->minCells = minCells;
+  this->backgroundShift = backgroundShift;
+}
+
+void MotionDetector::reset() {
+  hasBackground = false;
+}
+
+const uint8_t* MotionDetector::getGrid() const {
+  return current.cells;
+}
+
+bool MotionDetector::analyze(const uint8_t* jpeg, size_t length, MotionResult& result) {
+  result.changedCells = 0;
+  result.maxDelta = 0;
+  result.motion = false;
+
+  if (! decoder.decode(jpeg, length, current.cells, MOTION_GRID_WIDTH, MOTION_GRID_HEIGHT)) {
+    return false;
+  }
+
+  // Drop to 7 bits to free up the guard bit
+  for (uint8_t i = 0; i < GRID_WORDS; ++i) {
+    current.words[i] = (current.words[i] >> 1) & LOW_BITS;
+  }
+
+  if (! hasBackground) {
+    background = current;
+    hasBackground = true;
+    return true;
+  }
+
+  const uint32_t thresholdPlusOne = broadcast(threshold + 1);
+
+  for (uint8_t i = 0; i < GRID_WORDS; ++i) {
+    const uint32_t delta = absoluteDifference(current.words[i], background.words[i]);
+
+    result.changedCells += __builtin_popcount(greaterThan(delta, thresholdPlusOne));
+
+    if (delta != 0) {
+      const uint8_t wordMax = maxLane(delta);
+      result.maxDelta = wordMax > result.maxDelta ? wordMax : result.maxDelta;
+    }
+
+    // Repeated halving moves the background 1/2^shift of the way to the
+    // current frame.  Rounding towards the frame rather than down keeps the
+    // background from settling up to 2^shift - 1 below a brighter scene,
+    // which would be reported as motion forever once that tops threshold.
+    uint32_t updated = current.words[i];
+    for (uint8_t s = 0; s < backgroundShift; ++s) {
+      updated = averageTowards(background.words[i], updated);
+    }
+    background.words[i] = updated;
+  }
+
+  result.motion = result.changedCells >= minCells;
+
+  return true;
+}
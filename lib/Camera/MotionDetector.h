@@ -0,0 +1,64 @@
+#include <JpegDcDecoder.h>
+
+#ifndef MOTION_GRID_WIDTH
+#define MOTION_GRID_WIDTH 16
+#endif
+
+#ifndef MOTION_GRID_HEIGHT
+#define MOTION_GRID_HEIGHT 12
+#endif
+
+#define MOTION_GRID_CELLS (MOTION_GRID_WIDTH * MOTION_GRID_HEIGHT)
+
+#ifndef _MOTION_DETECTOR_H
+#define _MOTION_DETECTOR_H
+
+struct MotionResult {
+  // Cells that differ from the background by more than the threshold
+  uint16_t changedCells;
+  // Largest difference from the background in any cell (0-127)
+  uint8_t maxDelta;
+  bool motion;
+};
+
+// Compares each frame's luminance grid against a running background.  Cells
+// hold 7-bit values packed four to a word, so differences, thresholds and
+// background updates are done on four cells per operation with the top bit of
+// each byte as a borrow guard.
+//
+// Like JpegDcDecoder, this has no platform dependencies.
+class MotionDetector {
+public:
+  MotionDetector();
+
+  // threshold and the background weight are in 7-bit luma units.  The
+  // background moves 1/2^backgroundShift of the way to each new frame.
+  void configure(uint8_t threshold, uint16_t minCells, uint8_t backgroundShift);
+
+  // Returns false if the frame couldn't be parsed.  The first frame after a
+  // reset only seeds the background.
+  bool analyze(const uint8_t* jpeg, size_t length, MotionResult& result);
+  void reset();
+
+  // Current frame's grid, MOTION_GRID_CELLS 7-bit cells in row-major order
+  const uint8_t* getGrid() const;
+
+private:
+  static const uint8_t GRID_WORDS = MOTION_GRID_CELLS / 4;
+
+  union Grid {
+    uint8_t cells[MOTION_GRID_CELLS];
+    uint32_t words[GRID_WORDS];
+  };
+
+  JpegDcDecoder decoder;
+  Grid current;
+  Grid background;
+  bool hasBackground;
+
+  uint8_t threshold;
+  uint16_t minCells;
+  uint8_t backgroundShift;
+};
+
+#endif
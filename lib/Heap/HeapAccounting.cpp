@@ -0,0 +1,355 @@
+#include <HeapAccounting.h>
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+namespace HeapAccounting {
+  namespace {
+    // Keeps the caller's pointer aligned for any type
+    struct alignas(8) Header {
+      uint32_t size;
+      Subsystem subsystem;
+    };
+
+    struct Counters {
+      std::atomic<uint32_t> currentBytes;
+      std::atomic<uint32_t> peakBytes;
+      std::atomic<uint32_t> allocations;
+      std::atomic<uint32_t> frees;
+    };
+
+    Counters counters[static_cast<size_t>(Subsystem::COUNT)];
+
+    struct RateWindow {
+      uint32_t startedAt;
+      uint32_t allocations;
+      float rate;
+    };
+
+    RateWindow rateWindows[static_cast<size_t>(Subsystem::COUNT)];
+
+#if defined(ARDUINO)
+    // Registered tasks and any active scope.  Entries are only ever added, and
+    // each is only modified by its own task.
+    struct TaskEntry {
+      std::atomic<TaskHandle_t> task;
+      Subsystem registered;
+      Subsystem scoped;
+      bool hasScope;
+      uint32_t allocations;
+    };
+
+    TaskEntry tasks[HEAP_ACCOUNTING_MAX_TASKS];
+    std::atomic<uint8_t> numTasks(0);
+
+    // Global constructors run before there are any tasks
+    Subsystem bootScoped = Subsystem::COUNT;
+
+    bool schedulerStarted() {
+      return xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+    }
+
+#if HEAP_ACCOUNTING_TLS_INDEX > 0
+    TaskEntry* cachedTask() {
+      return static_cast<TaskEntry*>(pvTaskGetThreadLocalStoragePointer(NULL, HEAP_ACCOUNTING_TLS_INDEX));
+    }
+
+    TaskEntry* cacheTask(TaskEntry* entry) {
+      vTaskSetThreadLocalStoragePointer(NULL, HEAP_ACCOUNTING_TLS_INDEX, entry);
+      return entry;
+    }
+#else
+    __thread TaskEntry* taskCache = NULL;
+
+    TaskEntry* cachedTask() {
+      return taskCache;
+    }
+
+    TaskEntry* cacheTask(TaskEntry* entry) {
+      taskCache = entry;
+      return entry;
+    }
+#endif
+
+    // Searched once per task, then cached
+    TaskEntry* findTask(bool create) {
+      TaskEntry* cached = cachedTask();
+
+      if (cached != NULL) {
+        return cached;
+      }
+
+      TaskHandle_t current = xTaskGetCurrentTaskHandle();
+      const uint8_t n = numTasks.load(std::memory_order_acquire);
+
+      for (uint8_t i = 0; i < n; ++i) {
+        if (tasks[i].task.load(std::memory_order_relaxed) == current) {
+          return cacheTask(&tasks[i]);
+        }
+      }
+
+      if (! create) {
+        return NULL;
+      }
+
+      const uint8_t ix = numTasks.fetch_add(1);
+      if (ix >= HEAP_ACCOUNTING_MAX_TASKS) {
+        numTasks.fetch_sub(1);
+        return NULL;
+      }
+
+      tasks[ix].registered = Subsystem::OTHER;
+      tasks[ix].hasScope = false;
+      tasks[ix].allocations = 0;
+      tasks[ix].task.store(current, std::memory_order_release);
+
+      return cacheTask(&tasks[ix]);
+    }
+
+    Subsystem recordAllocation() {
+      if (! schedulerStarted()) {
+        return bootScoped == Subsystem::COUNT ? Subsystem::OTHER : bootScoped;
+      }
+
+      TaskEntry* entry = findTask(false);
+
+      if (entry == NULL) {
+        return Subsystem::OTHER;
+      }
+
+      ++entry->allocations;
+      return entry->hasScope ? entry->scoped : entry->registered;
+    }
+
+    uint32_t taskAllocations() {
+      if (! schedulerStarted()) {
+        return 0;
+      }
+
+      TaskEntry* entry = findTask(false);
+      return entry != NULL ? entry->allocations : 0;
+    }
+
+    Subsystem enterScope(Subsystem subsystem) {
+      if (! schedulerStarted()) {
+        const Subsystem previous = bootScoped;
+        bootScoped = subsystem;
+        return previous;
+      }
+
+      TaskEntry* entry = findTask(true);
+
+      if (entry == NULL) {
+        return Subsystem::COUNT;
+      }
+
+      const Subsystem previous = entry->hasScope ? entry->scoped : Subsystem::COUNT;
+      entry->scoped = subsystem;
+      entry->hasScope = true;
+
+      return previous;
+    }
+
+    void exitScope(Subsystem previous) {
+      if (! schedulerStarted()) {
+        bootScoped = previous;
+        return;
+      }
+
+      TaskEntry* entry = findTask(false);
+
+      if (entry != NULL) {
+        entry->hasScope = previous != Subsystem::COUNT;
+        entry->scoped = previous;
+      }
+    }
+#else
+    // Host builds have no tasks.  Scopes and counts are per thread.
+    thread_local Subsystem scoped = Subsystem::COUNT;
+    thread_local uint32_t allocations = 0;
+
+    Subsystem recordAllocation() {
+      ++allocations;
+      return scoped == Subsystem::COUNT ? Subsystem::OTHER : scoped;
+    }
+
+    uint32_t taskAllocations() {
+      return allocations;
+    }
+
+    Subsystem enterScope(Subsystem subsystem) {
+      const Subsystem previous = scoped;
+      scoped = subsystem;
+      return previous;
+    }
+
+    void exitScope(Subsystem previous) {
+      scoped = previous;
+    }
+#endif
+
+    void* allocate(size_t size) {
+      Header* header = static_cast<Header*>(malloc(sizeof(Header) + size));
+
+      if (header == NULL) {
+        return NULL;
+      }
+
+      header->size = size;
+      header->subsystem = recordAllocation();
+
+      Counters& c = counters[static_cast<size_t>(header->subsystem)];
+      c.allocations.fetch_add(1, std::memory_order_relaxed);
+      const uint32_t current = c.currentBytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+      uint32_t peak = c.peakBytes.load(std::memory_order_relaxed);
+      while (current > peak && ! c.peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+
+      return header + 1;
+    }
+
+    void deallocate(void* p) {
+      if (p == NULL) {
+        return;
+      }
+
+      Header* header = static_cast<Header*>(p) - 1;
+      Counters& c = counters[static_cast<size_t>(header->subsystem)];
+
+      c.frees.fetch_add(1, std::memory_order_relaxed);
+      c.currentBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+      free(header);
+    }
+  }
+
+  Scope::Scope(Subsystem subsystem)
+    : previous(enterScope(subsystem))
+  { }
+
+  Scope::~Scope() {
+    exitScope(previous);
+  }
+
+  void registerTask(Subsystem subsystem) {
+#if defined(ARDUINO)
+    TaskEntry* entry = findTask(true);
+
+    if (entry != NULL) {
+      entry->registered = subsystem;
+    }
+#else
+    scoped = subsystem;
+#endif
+  }
+
+  Usage getUsage(Subsystem subsystem) {
+    const Counters& c = counters[static_cast<size_t>(subsystem)];
+    Usage usage;
+
+    usage.currentBytes = c.currentBytes.load(std::memory_order_relaxed);
+    usage.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+    usage.allocations = c.allocations.load(std::memory_order_relaxed);
+    usage.frees = c.frees.load(std::memory_order_relaxed);
+
+    return usage;
+  }
+
+  float getAllocationRate(Subsystem subsystem, uint32_t nowMs) {
+    RateWindow& window = rateWindows[static_cast<size_t>(subsystem)];
+    const uint32_t elapsed = nowMs - window.startedAt;
+
+    if (elapsed >= 1000) {
+      const uint32_t allocations = getUsage(subsystem).allocations;
+
+      window.rate = (allocations - window.allocations) * 1000.0f / elapsed;
+      window.allocations = allocations;
+      window.startedAt = nowMs;
+    }
+
+    return window.rate;
+  }
+
+  HeapInfo getHeapInfo() {
+    HeapInfo info = { 0, 0, 0 };
+
+#if defined(ESP32)
+    info.freeBytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    info.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    if (info.freeBytes > 0) {
+      info.fragmentation = 1.0f - static_cast<float>(info.largestFreeBlock) / info.freeBytes;
+    }
+#endif
+
+    return info;
+  }
+
+  const char* subsystemToStr(Subsystem subsystem) {
+    switch (subsystem) {
+      case Subsystem::CAMERA:
+        return "camera";
+      case Subsystem::AUDIO:
+        return "audio";
+      case Subsystem::MOTOR:
+        return "motor";
+      case Subsystem::HTTP:
+        return "http";
+      case Subsystem::SETTINGS:
+        return "settings";
+      case Subsystem::OTHER:
+      default:
+        return "other";
+    }
+  }
+
+  uint32_t allocationCount() {
+    return taskAllocations();
+  }
+};
+
+// Replaceable global allocation functions.  The sized and nothrow variants
+// all route through the same pair.
+
+void* operator new(size_t size) {
+  void* p = HeapAccounting::allocate(size);
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+#endif
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return HeapAccounting::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return HeapAccounting::allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+  HeapAccounting::deallocate(p);
+}
+
+void operator delete[](void* p) noexcept {
+  HeapAccounting::deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  HeapAccounting::deallocate(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  HeapAccounting::deallocate(p);
+}
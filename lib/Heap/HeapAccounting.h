@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+}
+#endif
+
+// Tasks whose allocations can be attributed without a scope
+#ifndef HEAP_ACCOUNTING_MAX_TASKS
+#define HEAP_ACCOUNTING_MAX_TASKS 8
+#endif
+
+// FreeRTOS thread-local storage pointer that caches each task's entry, so
+// operator new doesn't search for it.  Index 0 holds ESP-IDF's pthread keys,
+// so with no spare pointer the cache is a __thread variable instead.
+#if defined(ARDUINO) && ! defined(HEAP_ACCOUNTING_TLS_INDEX)
+#define HEAP_ACCOUNTING_TLS_INDEX (configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#endif
+
+#ifndef _HEAP_ACCOUNTING_H
+#define _HEAP_ACCOUNTING_H
+
+// Counts C++ heap allocations (operator new/delete) by subsystem.  Each
+// allocation carries a small header recording its size and owner, so frees
+// are credited to whoever allocated.
+//
+// An allocation belongs to the innermost Scope active on the allocating task,
+// or else the subsystem the task was registered with, or else OTHER.
+//
+// malloc() callers (String, ArduinoJson) aren't covered; their effect shows
+// up in the heap-wide free and fragmentation figures.
+namespace HeapAccounting {
+  enum class Subsystem : uint8_t {
+    OTHER, CAMERA, AUDIO, MOTOR, HTTP, SETTINGS,
+    COUNT
+  };
+
+  struct Usage {
+    uint32_t currentBytes;
+    uint32_t peakBytes;
+    uint32_t allocations;
+    uint32_t frees;
+  };
+
+  struct HeapInfo {
+    uint32_t freeBytes;
+    uint32_t largestFreeBlock;
+    // 0 when free memory is one block, approaching 1 as it splinters
+    float fragmentation;
+  };
+
+  // Attributes allocations on the calling task for as long as it's alive.
+  // Scopes nest.
+  class Scope {
+  public:
+    Scope(Subsystem subsystem);
+    ~Scope();
+
+  private:
+    const Subsystem previous;
+  };
+
+  // Attributes the calling task's allocations outside any scope
+  void registerTask(Subsystem subsystem);
+
+  Usage getUsage(Subsystem subsystem);
+
+  // Allocations per second since the previous call for this subsystem, or the
+  // previous result if that was less than a second ago.  Meant for a single
+  // reader (the HTTP server).
+  float getAllocationRate(Subsystem subsystem, uint32_t nowMs);
+  HeapInfo getHeapInfo();
+
+  const char* subsystemToStr(Subsystem subsystem);
+
+  // Allocations made by the calling task (thread, on host builds) since it
+  // started, so other tasks can't throw the count off.  Compare before and
+  // after a call to check it doesn't allocate.  On the device only tasks
+  // that registered or entered a Scope are counted.
+  uint32_t allocationCount();
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include <CameraWebSocket.h>
+
+CameraWebSocket::ClientState::ClientState(AsyncWebSocketClient* client, uint16_t fps)
+  : client(client)
+  , lastSentAt(0)
+  , paused(false)
+  , frameRequested(false)
+  , lastSequence(0)
+{
+  setFps(fps);
+}
+
+void CameraWebSocket::ClientState::setFps(uint16_t fps) {
+  this->fps = fps;
+  this->intervalMs = fps > 0 ? 1000 / fps : 0;
+}
+
+CameraWebSocket::CameraWebSocket(CameraController& camera, Settings& settings)
+  : camera(camera)
+  , settings(settings)
+  , socket(CAMERA_WS_PATH)
+  , clientsMtx(xSemaphoreCreateMutex())
+  , stats()
+{
+  socket.onEvent([this](AsyncWebSocket*, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+    handleEvent(client, type, arg, data, len);
+  });
+}
+
+AsyncWebSocket& CameraWebSocket::getHandler() {
+  return socket;
+}
+
+CameraWsStats CameraWebSocket::getStats() {
+  xSemaphoreTake(clientsMtx, portMAX_DELAY);
+  CameraWsStats result = stats;
+  result.clients = clients.size();
+  xSemaphoreGive(clientsMtx);
+
+  return result;
+}
+
+void CameraWebSocket::handleEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
+  switch (type) {
+    case WS_EVT_CONNECT: {
+      xSemaphoreTake(clientsMtx, portMAX_DELAY);
+      // The newest frame goes out straight away, however old
+      auto result = clients.emplace(client->id(), ClientState(client, settings.arducam.target_fps));
+      sendStatus(client, result.first->second);
+      xSemaphoreGive(clientsMtx);
+
+      Trace::instant("camera_ws_connect", client->id());
+      break;
+    }
+
+    case WS_EVT_DISCONNECT:
+      xSemaphoreTake(clientsMtx, portMAX_DELAY);
+      clients.erase(client->id());
+      xSemaphoreGive(clientsMtx);
+
+      Trace::instant("camera_ws_disconnect", client->id());
+      break;
+
+    case WS_EVT_DATA: {
+      const AwsFrameInfo* info = static_cast<AwsFrameInfo*>(arg);
+
+      // Commands are short.  Anything fragmented or binary isn't one.
+      if (! info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT) {
+        break;
+      }
+
+      char command[CAMERA_WS_MAX_COMMAND_LENGTH];
+      const size_t commandLen = std::min(len, sizeof(command) - 1);
+      memcpy(command, data, commandLen);
+      command[commandLen] = 0;
+
+      handleCommand(client, command);
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void CameraWebSocket::handleCommand(AsyncWebSocketClient* client, const char* command) {
+  xSemaphoreTake(clientsMtx, portMAX_DELAY);
+
+  auto it = clients.find(client->id());
+
+  if (it != clients.end()) {
+    ClientState& state = it->second;
+    const char* error = NULL;
+
+    if (strncmp(command, "rate ", 5) == 0) {
+      const char* value = command + 5;
+      char* end;
+      const long fps = strtol(value, &end, 10);
+
+      // Trailing junk or no digits at all isn't a rate, not even 0
+      if (end == value || *end != 0 || fps < 0 || fps > 1000) {
+        error = "Invalid rate";
+      } else {
+        state.setFps(fps);
+      }
+    } else if (strcmp(command, "pause") == 0) {
+      state.paused = true;
+    } else if (strcmp(command, "resume") == 0) {
+      state.paused = false;
+    } else if (strcmp(command, "frame") == 0) {
+      state.frameRequested = true;
+    } else {
+      error = "Unknown command";
+    }
+
+    sendStatus(client, state, error);
+  }
+
+  xSemaphoreGive(clientsMtx);
+}
+
+void CameraWebSocket::sendStatus(AsyncWebSocketClient* client, const ClientState& state, const char* error) {
+  char message[96];
+
+  if (error != NULL) {
+    snprintf(message, sizeof(message), "{\"error\":\"%s\"}", error);
+  } else {
+    snprintf(
+      message,
+      sizeof(message),
+      "{\"version\":%d,\"fps\":%u,\"paused\":%s}",
+      CAMERA_WS_VERSION,
+      static_cast<unsigned>(state.fps),
+      state.paused ? "true" : "false"
+    );
+  }
+
+  client->text(message);
+}
+
+bool CameraWebSocket::wantsFrame(const ClientState& state, uint32_t now) const {
+  if (state.frameRequested) {
+    return true;
+  }
+
+  return ! state.paused && (now - state.lastSentAt) >= state.intervalMs;
+}
+
+void CameraWebSocket::loop() {
+  HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::HTTP);
+  const uint32_t now = millis();
+
+  xSemaphoreTake(clientsMtx, portMAX_DELAY);
+
+  // Oldest frame any due client has seen.  Only need a frame newer than that.
+  bool anyDue = false;
+  uint32_t oldestSequence = UINT32_MAX;
+
+  for (auto it = clients.begin(); it != clients.end(); ++it) {
+    if (wantsFrame(it->second, now)) {
+      anyDue = true;
+      oldestSequence = std::min(oldestSequence, it->second.lastSequence);
+    }
+  }
+
+  if (! anyDue) {
+    xSemaphoreGive(clientsMtx);
+    return;
+  }
+
+  FrameRing::FrameRef frame = camera.pollFrame(oldestSequence);
+
+  if (! frame) {
+    // Requested.  Picked up on a later call.
+    xSemaphoreGive(clientsMtx);
+    return;
+  }
+
+  const CameraFrame& jpeg = frame.frame();
+  const size_t messageLen = sizeof(CameraWsFrameHeader) + jpeg.length;
+
+  if (HeapAccounting::getHeapInfo().largestFreeBlock < messageLen + CAMERA_WS_HEAP_RESERVE) {
+    stats.framesDeferred++;
+    Trace::instant("camera_ws_deferred", messageLen);
+    xSemaphoreGive(clientsMtx);
+    return;
+  }
+
+  // Built once, when the first client that needs it turns up
+  AsyncWebSocketMessageBuffer* buffer = NULL;
+
+  for (auto it = clients.begin(); it != clients.end(); ++it) {
+    ClientState& state = it->second;
+
+    if (! wantsFrame(state, now) || state.lastSequence >= frame.sequence()) {
+      continue;
+    }
+
+    AsyncWebSocketClient* client = state.client;
+
+    // Already off the socket's list, waiting on the mutex to say so
+    if (client->status() != WS_CONNECTED) {
+      continue;
+    }
+
+    // A client still draining earlier frames gets the newest one once it
+    // catches up, rather than a growing queue of stale ones
+    if (client->queueIsFull()) {
+      stats.framesSkipped++;
+      state.lastSequence = frame.sequence();
+      continue;
+    }
+
+    if (buffer == NULL) {
+      buffer = socket.makeBuffer(messageLen);
+
+      if (buffer == NULL) {
+        stats.framesDeferred++;
+        break;
+      }
+
+      CameraWsFrameHeader header;
+      memcpy(header.magic, CAMERA_WS_MAGIC, sizeof(header.magic));
+      header.version = CAMERA_WS_VERSION;
+      header.flags = 0;
+      header.headerLength = sizeof(CameraWsFrameHeader);
+      header.sequence = frame.sequence();
+      header.capturedAt = frame.capturedAt();
+      header.sentAt = now;
+      header.size = jpeg.length;
+
+      memcpy(buffer->get(), &header, sizeof(header));
+      memcpy(buffer->get() + sizeof(header), jpeg.bytes, jpeg.length);
+    }
+
+    client->binary(buffer);
+
+    state.lastSequence = frame.sequence();
+    state.lastSentAt = now;
+    state.frameRequested = false;
+    stats.framesSent++;
+  }
+
+  // Nothing else frees message buffers once their last send is done.  This
+  // one is still held by whichever clients haven't sent it yet.
+  if (buffer != NULL) {
+    socket._cleanBuffers();
+  }
+
+  xSemaphoreGive(clientsMtx);
+
+  if (buffer != NULL) {
+    Metrics::cameraFrameSend.record((millis() - frame.capturedAt()) * 1000);
+  }
+}
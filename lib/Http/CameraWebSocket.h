@@ -0,0 +1,116 @@
+#include <ESPAsyncWebServer.h>
+#include <CameraController.h>
+#include <Settings.h>
+#include <HeapAccounting.h>
+#include <Metrics.h>
+#include <Trace.h>
+
+#include <map>
+
+#if defined(ESP32)
+extern "C" {
+  #include "freertos/semphr.h"
+}
+#endif
+
+#define CAMERA_WS_PATH "/camera/ws"
+
+// Binary frame messages start with this header, followed by the JPEG.  All
+// fields are little-endian.
+#define CAMERA_WS_MAGIC "TDCF"
+#define CAMERA_WS_VERSION 1
+
+// Frames aren't sent unless this much heap would be left over.  Each frame is
+// copied once into a message shared by every client it goes to.
+#ifndef CAMERA_WS_HEAP_RESERVE
+#define CAMERA_WS_HEAP_RESERVE 16384
+#endif
+
+// Longest command a client can send
+#define CAMERA_WS_MAX_COMMAND_LENGTH 32
+
+#ifndef _CAMERA_WEB_SOCKET_H
+#define _CAMERA_WEB_SOCKET_H
+
+struct __attribute__((packed)) CameraWsFrameHeader {
+  char magic[4];
+  uint8_t version;
+  // Reserved, 0
+  uint8_t flags;
+  // sizeof(CameraWsFrameHeader), so fields can be added without breaking
+  // clients that skip to the JPEG
+  uint16_t headerLength;
+  uint32_t sequence;
+  // millis() when the frame was captured and sent, on the device's clock
+  uint32_t capturedAt;
+  uint32_t sentAt;
+  uint32_t size;
+};
+
+struct CameraWsStats {
+  uint32_t framesSent;
+  // Skipped for a client that hadn't drained the previous frame
+  uint32_t framesSkipped;
+  // Not sent at all because there wasn't enough heap to hold the message
+  uint32_t framesDeferred;
+  size_t clients;
+};
+
+// Pushes camera frames to WebSocket clients, one binary message per frame.
+//
+// Clients control delivery with text commands:
+//   rate <fps>  frames per second (0 for as fast as they're drained)
+//   pause       stop sending frames
+//   resume      start again
+//   frame       send one frame, even while paused
+// Each command is answered with a JSON status message.
+//
+// Frames are sent from loop(), which must be called regularly.  It only
+// reaches clients through the state kept for them here, never the socket's
+// own client list, which the web server task changes underneath it.
+class CameraWebSocket {
+public:
+  // New clients start at the arducam.target_fps setting
+  CameraWebSocket(CameraController& camera, Settings& settings);
+
+  AsyncWebSocket& getHandler();
+  void loop();
+
+  CameraWsStats getStats();
+
+private:
+  struct ClientState {
+    ClientState(AsyncWebSocketClient* client, uint16_t fps);
+
+    void setFps(uint16_t fps);
+
+    AsyncWebSocketClient* client;
+    uint16_t fps;
+    uint32_t intervalMs;
+    uint32_t lastSentAt;
+    bool paused;
+    bool frameRequested;
+    uint32_t lastSequence;
+  };
+
+  CameraController& camera;
+  Settings& settings;
+  AsyncWebSocket socket;
+
+  // Keyed by client ID.  Events arrive on the web server task and frames are
+  // sent from loop(), so both hold the mutex.  The disconnect event is raised
+  // from the client's destructor, so a client can't be freed while loop() is
+  // sending to it.
+  std::map<uint32_t, ClientState> clients;
+  SemaphoreHandle_t clientsMtx;
+
+  CameraWsStats stats;
+
+  void handleEvent(AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+  void handleCommand(AsyncWebSocketClient* client, const char* command);
+  void sendStatus(AsyncWebSocketClient* client, const ClientState& state, const char* error = NULL);
+
+  bool wantsFrame(const ClientState& state, uint32_t now) const;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include <DirectoryListing.h>
+
+// Writes s as a quoted JSON string.  Returns the number of bytes written.
+static size_t writeJsonString(char* out, const char* s) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  char* p = out;
+
+  *p++ = '"';
+
+  for (; *s; ++s) {
+    const uint8_t c = *s;
+
+    if (c == '"' || c == '\\') {
+      *p++ = '\\';
+      *p++ = c;
+    } else if (c < 0x20) {
+      *p++ = '\\';
+      *p++ = 'u';
+      *p++ = '0';
+      *p++ = '0';
+      *p++ = HEX_DIGITS[c >> 4];
+      *p++ = HEX_DIGITS[c & 0xF];
+    } else {
+      *p++ = c;
+    }
+  }
+
+  *p++ = '"';
+
+  return p - out;
+}
+
+DirectoryListing::DirectoryListing(const char* dirName, size_t offset, size_t limit, uint16_t fields)
+  : fields(fields == 0 ? ALL_FIELDS : fields)
+  , dirName(dirName)
+  , offset(offset)
+  , limit(limit)
+  , pendingLen(0)
+  , pendingIx(0)
+  , index(0)
+  , emitted(0)
+  , started(false)
+  , finished(false)
+{ }
+
+DirectoryListing::~DirectoryListing() {
+#if defined(ESP32)
+  if (dir) {
+    dir.close();
+  }
+#endif
+}
+
+bool DirectoryListing::open() {
+#if defined(ESP8266)
+  dir = SPIFFS.openDir(dirName);
+  return true;
+#elif defined(ESP32)
+  dir = SPIFFS.open(dirName);
+  return dir && dir.isDirectory();
+#endif
+}
+
+uint16_t DirectoryListing::parseFields(const String& fields) {
+  static const struct {
+    const char* name;
+    uint16_t field;
+  } FIELD_NAMES[] = {
+    { "name", FIELD_NAME },
+    { "size", FIELD_SIZE },
+    { "duration", FIELD_DURATION },
+    { "bitrate", FIELD_BITRATE },
+    { "sample_rate", FIELD_SAMPLE_RATE },
+    { "channels", FIELD_CHANNELS },
+    { "codec", FIELD_CODEC },
+    { "hash", FIELD_HASH },
+    { "modified", FIELD_MODIFIED }
+  };
+
+  uint16_t result = 0;
+  int start = 0;
+
+  while (start < static_cast<int>(fields.length())) {
+    int end = fields.indexOf(',', start);
+    if (end < 0) {
+      end = fields.length();
+    }
+
+    String field = fields.substring(start, end);
+
+    for (size_t i = 0; i < sizeof(FIELD_NAMES) / sizeof(FIELD_NAMES[0]); ++i) {
+      if (field.equalsIgnoreCase(FIELD_NAMES[i].name)) {
+        result |= FIELD_NAMES[i].field;
+      }
+    }
+
+    start = end + 1;
+  }
+
+  return result == 0 ? ALL_FIELDS : result;
+}
+
+bool DirectoryListing::nextEntry(char* name, size_t& size) {
+#if defined(ESP8266)
+  if (! dir.next()) {
+    return false;
+  }
+
+  strncpy(name, dir.fileName().c_str(), MAX_NAME_LENGTH);
+  size = dir.fileSize();
+#elif defined(ESP32)
+  File file = dir.openNextFile();
+
+  if (! file) {
+    return false;
+  }
+
+  strncpy(name, file.name(), MAX_NAME_LENGTH);
+  size = file.size();
+#endif
+
+  name[MAX_NAME_LENGTH] = 0;
+  return true;
+}
+
+size_t DirectoryListing::writeExtraFields(char* out) {
+  return 0;
+}
+
+size_t DirectoryListing::fill(uint8_t* buffer, size_t maxLen) {
+  size_t written = 0;
+
+  while (written < maxLen) {
+    if (pendingIx < pendingLen) {
+      const size_t toCopy = std::min(maxLen - written, pendingLen - pendingIx);
+
+      memcpy(buffer + written, pending + pendingIx, toCopy);
+      written += toCopy;
+      pendingIx += toCopy;
+    } else if (finished) {
+      break;
+    } else {
+      refill();
+    }
+  }
+
+  return written;
+}
+
+void DirectoryListing::refill() {
+  pendingIx = 0;
+  pendingLen = 0;
+
+  if (! started) {
+    pending[pendingLen++] = '[';
+    started = true;
+    return;
+  }
+
+  char name[MAX_NAME_LENGTH + 1];
+  size_t size;
+
+  while (limit == 0 || emitted < limit) {
+    if (! nextEntry(name, size)) {
+      break;
+    }
+
+    if (index++ < offset) {
+      continue;
+    }
+
+    char* p = pending;
+
+    if (emitted > 0) {
+      *p++ = ',';
+    }
+    *p++ = '{';
+
+    if (fields & FIELD_NAME) {
+      p += sprintf(p, "\"name\":");
+      p += writeJsonString(p, name);
+    }
+    if (fields & FIELD_SIZE) {
+      p += sprintf(p, "%s\"size\":%u", (fields & FIELD_NAME) ? "," : "", static_cast<unsigned>(size));
+    }
+
+    // Extra fields always lead with a comma.  Drop it if nothing came before.
+    const size_t extraLen = writeExtraFields(p);
+    if (extraLen > 0 && *(p - 1) == '{') {
+      memmove(p, p + 1, extraLen - 1);
+      p += extraLen - 1;
+    } else {
+      p += extraLen;
+    }
+
+    *p++ = '}';
+
+    pendingLen = p - pending;
+    ++emitted;
+
+    return;
+  }
+
+  pending[pendingLen++] = ']';
+  finished = true;
+}
@@ -0,0 +1,83 @@
+#include <Arduino.h>
+
+#if defined(ESP8266)
+#include <FS.h>
+#elif defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+#ifndef _DIRECTORY_LISTING_H
+#define _DIRECTORY_LISTING_H
+
+// Serializes a directory as a JSON array of objects a piece at a time, for use
+// as a chunked response body.  Only one entry is held in memory at once, so
+// memory use doesn't depend on the number of files.
+class DirectoryListing {
+public:
+  static const uint16_t FIELD_NAME = 1 << 0;
+  static const uint16_t FIELD_SIZE = 1 << 1;
+  // Only available from listings backed by the sound index
+  static const uint16_t FIELD_DURATION = 1 << 2;
+  static const uint16_t FIELD_BITRATE = 1 << 3;
+  static const uint16_t FIELD_SAMPLE_RATE = 1 << 4;
+  static const uint16_t FIELD_CHANNELS = 1 << 5;
+  static const uint16_t FIELD_CODEC = 1 << 6;
+  static const uint16_t FIELD_HASH = 1 << 7;
+  static const uint16_t FIELD_MODIFIED = 1 << 8;
+  static const uint16_t ALL_FIELDS = 0x1FF;
+
+  // A limit of 0 means no limit
+  DirectoryListing(const char* dirName, size_t offset, size_t limit, uint16_t fields);
+  virtual ~DirectoryListing();
+
+  // Returns false if the path isn't a directory
+  virtual bool open();
+
+  // Writes up to maxLen bytes of the listing.  Returns 0 once it's complete.
+  size_t fill(uint8_t* buffer, size_t maxLen);
+
+  // Parses a comma-separated list of field names.  Unknown names are ignored,
+  // and an empty list selects every field.
+  static uint16_t parseFields(const String& fields);
+
+protected:
+  static const size_t MAX_NAME_LENGTH = 64;
+
+  // Sets name and size for the next file.  Returns false when there are no
+  // more files.
+  virtual bool nextEntry(char* name, size_t& size);
+
+  // Appends any selected fields beyond name and size for the entry last
+  // returned by nextEntry, each preceded by a comma.  Returns the number of
+  // bytes written, at most MAX_EXTRA_FIELDS_LENGTH.
+  virtual size_t writeExtraFields(char* out);
+
+  static const size_t MAX_EXTRA_FIELDS_LENGTH = 192;
+
+  const uint16_t fields;
+
+private:
+  const String dirName;
+  const size_t offset;
+  const size_t limit;
+
+#if defined(ESP8266)
+  Dir dir;
+#elif defined(ESP32)
+  File dir;
+#endif
+
+  // Serialized form of the current entry (or bracket) not yet sent
+  char pending[8 + 6 * MAX_NAME_LENGTH + 32 + MAX_EXTRA_FIELDS_LENGTH];
+  size_t pendingLen;
+  size_t pendingIx;
+
+  size_t index;
+  size_t emitted;
+  bool started;
+  bool finished;
+
+  void refill();
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <FileUpload.h>
+
+FileUpload::FileUpload(const String& path)
+  : path(path)
+  , tempPath(nextTempPath())
+  , bufferLen(0)
+  , size(0)
+  , startTime(millis())
+  , endTime(0)
+  , committed(false)
+{ }
+
+FileUpload::~FileUpload() {
+  if (file) {
+    file.close();
+  }
+
+  if (! committed) {
+    SPIFFS.remove(tempPath);
+  }
+}
+
+String FileUpload::nextTempPath() {
+  static uint16_t nextId = 0;
+  return String(UPLOAD_TEMP_PREFIX) + (nextId++);
+}
+
+bool FileUpload::begin() {
+  buffer.reset(new uint8_t[UPLOAD_BUFFER_SIZE]);
+  file = SPIFFS.open(tempPath, FILE_WRITE);
+
+  return buffer && file;
+}
+
+bool FileUpload::write(const uint8_t* data, size_t len) {
+  size += len;
+
+  while (len > 0) {
+    const size_t toCopy = std::min(len, UPLOAD_BUFFER_SIZE - bufferLen);
+
+    memcpy(buffer.get() + bufferLen, data, toCopy);
+    bufferLen += toCopy;
+    data += toCopy;
+    len -= toCopy;
+
+    if (bufferLen == UPLOAD_BUFFER_SIZE && ! flush()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool FileUpload::flush() {
+  if (bufferLen > 0 && file.write(buffer.get(), bufferLen) != bufferLen) {
+    return false;
+  }
+
+  bufferLen = 0;
+  return true;
+}
+
+bool FileUpload::commit() {
+  if (! flush()) {
+    return false;
+  }
+
+  file.close();
+  buffer.reset();
+
+  // SPIFFS won't rename over an existing file.  The old file is gone for a
+  // moment, but there's never a partial one under the target name.
+  if (SPIFFS.exists(path)) {
+    SPIFFS.remove(path);
+  }
+
+  if (! SPIFFS.rename(tempPath, path)) {
+    return false;
+  }
+
+  committed = true;
+  endTime = millis();
+
+  return true;
+}
+
+size_t FileUpload::getSize() const {
+  return size;
+}
+
+uint32_t FileUpload::getElapsedMs() const {
+  return (committed ? endTime : millis()) - startTime;
+}
+
+uint32_t FileUpload::getThroughputKbps() const {
+  const uint32_t elapsed = getElapsedMs();
+  // bytes/ms * 8 = kbit/s
+  return elapsed > 0 ? (static_cast<uint64_t>(size) * 8) / elapsed : 0;
+}
+
+void FileUpload::removeStaleFiles() {
+  bool removed;
+
+  // Start over after each removal rather than deleting mid-iteration
+  do {
+    removed = false;
+    File dir = SPIFFS.open("/tmp");
+
+    if (! dir || ! dir.isDirectory()) {
+      return;
+    }
+
+    File file;
+    while (! removed && (file = dir.openNextFile())) {
+      String name = file.name();
+      file.close();
+
+      if (name.startsWith(UPLOAD_TEMP_PREFIX)) {
+        removed = SPIFFS.remove(name);
+      }
+    }
+
+    dir.close();
+  } while (removed);
+}
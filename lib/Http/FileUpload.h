@@ -0,0 +1,65 @@
+#include <Arduino.h>
+#include <memory>
+
+#if defined(ESP8266)
+#include <FS.h>
+#elif defined(ESP32)
+#include <SPIFFS.h>
+#endif
+
+// Uploads are written in blocks of this size.  It's a multiple of the SPIFFS
+// page size (256 bytes), so every write fills whole pages rather than
+// rewriting a partial page for each network fragment.
+#ifndef UPLOAD_BUFFER_SIZE
+#define UPLOAD_BUFFER_SIZE 4096
+#endif
+
+// Uploads in progress are written here and renamed into place on completion
+#define UPLOAD_TEMP_PREFIX "/tmp/upload"
+
+#ifndef _FILE_UPLOAD_H
+#define _FILE_UPLOAD_H
+
+// Writes an upload to a temporary file and moves it to its final name only
+// once it's complete, so an interrupted upload never leaves a truncated file
+// behind.  Destroying an upload that hasn't been committed removes the
+// temporary file.
+class FileUpload {
+public:
+  FileUpload(const String& path);
+  ~FileUpload();
+
+  FileUpload(const FileUpload&) = delete;
+  FileUpload& operator=(const FileUpload&) = delete;
+
+  bool begin();
+  bool write(const uint8_t* data, size_t len);
+
+  // Flushes buffered data and renames the temp file over the target path
+  bool commit();
+
+  size_t getSize() const;
+  uint32_t getElapsedMs() const;
+  uint32_t getThroughputKbps() const;
+
+  // Removes temp files left behind by a reset mid-upload
+  static void removeStaleFiles();
+
+private:
+  const String path;
+  const String tempPath;
+  File file;
+
+  std::unique_ptr<uint8_t[]> buffer;
+  size_t bufferLen;
+
+  size_t size;
+  uint32_t startTime;
+  uint32_t endTime;
+  bool committed;
+
+  bool flush();
+  static String nextTempPath();
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <ArduinoJson.h>
 #include <HttpServer.h>
 #include <AuthProviders.h>
+#include <time.h>
 
 #if defined(ESP8266)
 #include <Updater.h>
@@ -15,44 +16,137 @@ using namespace std::placeholders;
 static const char APPLICATION_JSON[] = "application/json";
 static const char TEXT_PLAIN[] = "text/plain";
 
-HttpServer::HttpServer(Settings& settings, CameraController& camera, MotorController& motor, AudioController& audio)
+static const char* MONTHS[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+// Formats a Unix time as an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+static String formatHttpDate(time_t time) {
+  static const char* DAYS[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+  struct tm parts;
+  char buffer[32];
+
+  gmtime_r(&time, &parts);
+  sprintf(
+    buffer,
+    "%s, %02d %s %04d %02d:%02d:%02d GMT",
+    DAYS[parts.tm_wday],
+    parts.tm_mday,
+    MONTHS[parts.tm_mon],
+    parts.tm_year + 1900,
+    parts.tm_hour,
+    parts.tm_min,
+    parts.tm_sec
+  );
+
+  return buffer;
+}
+
+// Parses an IMF-fixdate.  Returns 0 for anything else.
+static uint32_t parseHttpDate(const String& date) {
+  char month[4];
+  int day, year, hour, minute, second;
+
+  if (sscanf(date.c_str(), "%*3s, %d %3s %d %d:%d:%d GMT", &day, month, &year, &hour, &minute, &second) != 6) {
+    return 0;
+  }
+
+  int monthIx = 0;
+  while (monthIx < 12 && strcmp(month, MONTHS[monthIx]) != 0) {
+    ++monthIx;
+  }
+
+  if (monthIx == 12 || year < 1970) {
+    return 0;
+  }
+
+  // Days since the epoch, counting years from March so leap days come last
+  const int m = monthIx + 1;
+  const int y = year - (m <= 2 ? 1 : 0);
+  const int era = y / 400;
+  const int yearOfEra = y - era * 400;
+  const int dayOfYear = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  const uint32_t days = era * 146097 + dayOfEra - 719468;
+
+  return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+// Range bounds are plain digits.  toInt() would read anything else as 0.
+static bool isDigits(const String& value) {
+  if (value.length() == 0) {
+    return false;
+  }
+
+  for (size_t i = 0; i < value.length(); ++i) {
+    if (! isdigit(value[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+HttpServer::HttpServer(Settings& settings, SettingsJournal& settingsJournal, CameraController& camera, MotorController& motor, AudioController& audio, SoundIndex& soundIndex)
   : settings(settings)
+  , settingsJournal(settingsJournal)
   , authProvider(settings.http)
   , server(RichHttpServer<RichHttpConfig>(settings.http.port, authProvider))
   , motor(motor)
   , camera(camera)
   , audio(audio)
+  , soundIndex(soundIndex)
+  , cameraSocket(camera, settings)
+  , settingsBootId(0)
+  , settingsGeneration(1)
+  , cachedSettingsGeneration(0)
 { }
 
 void HttpServer::begin() {
+  settingsBootId = esp_random();
+  FileUpload::removeStaleFiles();
+
   server
     .buildHandler("/settings")
-    .on(HTTP_GET, std::bind(&HttpServer::handleListSettings, this, _1))
-    .on(HTTP_PUT, std::bind(&HttpServer::handleUpdateSettings, this, _1));
+    .on(HTTP_GET, timed("handler=\"/settings\",method=\"GET\"", std::bind(&HttpServer::handleListSettings, this, _1)))
+    .on(HTTP_PUT, timed("handler=\"/settings\",method=\"PUT\"", std::bind(&HttpServer::handleUpdateSettings, this, _1)));
 
   server
     .buildHandler("/camera/snapshot.jpg")
-    .on(HTTP_GET, std::bind(&HttpServer::handleGetCameraStill, this, _1));
+    .on(HTTP_GET, timed("handler=\"/camera/snapshot.jpg\",method=\"GET\"", std::bind(&HttpServer::handleGetCameraStill, this, _1)));
   server
     .buildHandler("/camera/stream.mjpg")
-    .on(HTTP_GET, std::bind(&HttpServer::handleGetCameraStream, this, _1));
+    .on(HTTP_GET, timed("handler=\"/camera/stream.mjpg\",method=\"GET\"", std::bind(&HttpServer::handleGetCameraStream, this, _1)));
+  server
+    .buildHandler("/camera/stats")
+    .on(HTTP_GET, timed("handler=\"/camera/stats\",method=\"GET\"", std::bind(&HttpServer::handleGetCameraStats, this, _1)));
+  server
+    .buildHandler("/camera/motion")
+    .on(HTTP_GET, timed("handler=\"/camera/motion\",method=\"GET\"", std::bind(&HttpServer::handleGetCameraMotion, this, _1)));
+  server
+    .buildHandler("/camera/motion.jpg")
+    .on(HTTP_GET, timed("handler=\"/camera/motion.jpg\",method=\"GET\"", std::bind(&HttpServer::handleGetCameraMotionCapture, this, _1)));
 
   server
     .buildHandler("/motor/commands")
-    .on(HTTP_POST, std::bind(&HttpServer::handlePostMotorCommand, this, _1));
+    .on(HTTP_POST, timed("handler=\"/motor/commands\",method=\"POST\"", std::bind(&HttpServer::handlePostMotorCommand, this, _1)));
+  server
+    .buildHandler("/motor/jobs/:id")
+    .on(HTTP_GET, timed("handler=\"/motor/jobs/:id\",method=\"GET\"", std::bind(&HttpServer::handleGetMotorJob, this, _1)));
 
   server
     .buildHandler("/sounds/:filename")
-    .on(HTTP_DELETE, std::bind(&HttpServer::handleDeleteSound, this, _1))
-    .on(HTTP_GET, std::bind(&HttpServer::handleShowSound, this, _1));
+    .on(HTTP_DELETE, timed("handler=\"/sounds/:filename\",method=\"DELETE\"", std::bind(&HttpServer::handleDeleteSound, this, _1)))
+    .on(HTTP_GET, timed("handler=\"/sounds/:filename\",method=\"GET\"", std::bind(&HttpServer::handleShowSound, this, _1)));
 
   // Must go last, or it'll match /sounds/XXX
   server
     .buildHandler("/sounds")
-    .on(HTTP_GET, std::bind(&HttpServer::handleListDirectory, this, SOUNDS_DIRECTORY, _1))
+    .on(HTTP_GET, timed("handler=\"/sounds\",method=\"GET\"", std::bind(&HttpServer::handleListDirectory, this, SOUNDS_DIRECTORY, _1)))
     .on(
       HTTP_POST,
-      std::bind(&HttpServer::handleListDirectory, this, SOUNDS_DIRECTORY, _1),
+      timed("handler=\"/sounds\",method=\"POST\"", std::bind(&HttpServer::handleCreateFileComplete, this, _1)),
       std::bind(&HttpServer::handleCreateFile, this, SOUNDS_DIRECTORY, _1)
     );
 
@@ -60,30 +154,176 @@ void HttpServer::begin() {
     .buildHandler("/firmware")
     .handleOTA();
 
+  server
+    .buildHandler("/metrics")
+    .on(HTTP_GET, std::bind(&HttpServer::handleGetMetrics, this, _1));
+
+  server
+    .buildHandler("/debug/trace")
+    .on(HTTP_GET, std::bind(&HttpServer::handleGetTrace, this, _1));
+
   server
     .buildHandler("/about")
-    .on(HTTP_GET, std::bind(&HttpServer::handleAbout, this, _1));
+    .on(HTTP_GET, timed("handler=\"/about\",method=\"GET\"", std::bind(&HttpServer::handleAbout, this, _1)));
 
   server
     .buildHandler("/audio/commands")
-    .on(HTTP_POST, std::bind(&HttpServer::handlePostAudioCommand, this, _1));
+    .on(HTTP_POST, timed("handler=\"/audio/commands\",method=\"POST\"", std::bind(&HttpServer::handlePostAudioCommand, this, _1)));
+
+  // Not a rich handler, so it authenticates for itself
+  AsyncWebSocket& socket = cameraSocket.getHandler();
+  if (settings.http.isAuthenticationEnabled()) {
+    socket.setAuthentication(settings.http.getUsername().c_str(), settings.http.getPassword().c_str());
+  }
+  server.addHandler(&socket);
 
   server.clearBuilders();
   server.begin();
 }
 
+void HttpServer::loop() {
+  cameraSocket.loop();
+}
+
 void HttpServer::handleShowSound(RequestContext& request) {
   const char* filename = request.pathVariables.get("filename");
-  String path = String(SOUNDS_DIRECTORY) + "/" + filename;
-  request.rawRequest->send(SPIFFS, path, F("audio/mpeg"));
+  AsyncWebServerRequest* rawRequest = request.rawRequest;
+
+  char path[AUDIO_MAX_PATH_LENGTH];
+  SoundInfo info;
+
+  if (! getSoundPath(filename, path)) {
+    request.response.setCode(404);
+    request.response.json["error"] = F("File not found");
+    return;
+  }
+
+  if (! soundIndex.find(path, info)) {
+    // Not indexed (e.g., written before the index existed).  Index it now so
+    // the next request has an ETag.
+    if (! SPIFFS.exists(path) || ! SoundAnalyzer::analyzeFile(path, info)) {
+      request.response.setCode(404);
+      request.response.json["error"] = F("File not found");
+      return;
+    }
+
+    soundIndex.put(info);
+  }
+
+  // Strong validator: same contents, same tag
+  char etag[24];
+  sprintf(etag, "\"%08x-%x\"", static_cast<unsigned>(info.crc32), static_cast<unsigned>(info.size));
+
+  const String lastModified = info.modifiedAt != 0 ? formatHttpDate(info.modifiedAt) : String();
+
+  // If-None-Match takes precedence over If-Modified-Since
+  AsyncWebHeader* ifNoneMatch = rawRequest->getHeader("If-None-Match");
+  AsyncWebHeader* ifModifiedSince = rawRequest->getHeader("If-Modified-Since");
+  bool notModified = false;
+
+  if (ifNoneMatch != NULL) {
+    notModified = ifNoneMatch->value() == "*" || ifNoneMatch->value().indexOf(etag) >= 0;
+  } else if (ifModifiedSince != NULL && info.modifiedAt != 0) {
+    const uint32_t since = parseHttpDate(ifModifiedSince->value());
+    notModified = since != 0 && info.modifiedAt <= since;
+  }
+
+  if (notModified) {
+    AsyncWebServerResponse* response = rawRequest->beginResponse(304);
+    response->addHeader("ETag", etag);
+    rawRequest->send(response);
+    return;
+  }
+
+  // Only a single range is supported.  Anything else gets the whole file,
+  // which is allowed.  If-Range with a stale tag, or a range that doesn't
+  // parse, also gets the whole file.
+  size_t start = 0;
+  size_t end = info.size > 0 ? info.size - 1 : 0;
+  bool partial = false;
+
+  AsyncWebHeader* range = rawRequest->getHeader("Range");
+  AsyncWebHeader* ifRange = rawRequest->getHeader("If-Range");
+
+  if (range != NULL
+    && range->value().startsWith("bytes=")
+    && range->value().indexOf(',') < 0
+    && (ifRange == NULL || ifRange->value() == etag)) {
+    const String spec = range->value().substring(6);
+    const int dashIx = spec.indexOf('-');
+    const String first = dashIx >= 0 ? spec.substring(0, dashIx) : String();
+    const String last = dashIx >= 0 ? spec.substring(dashIx + 1) : String();
+
+    if (dashIx == 0 && isDigits(last)) {
+      // Suffix: the last N bytes
+      const size_t suffixLen = last.toInt();
+      start = suffixLen < info.size ? info.size - suffixLen : 0;
+      partial = suffixLen > 0;
+    } else if (dashIx > 0 && isDigits(first) && (last.length() == 0 || isDigits(last))) {
+      start = first.toInt();
+      if (last.length() > 0) {
+        end = std::min(static_cast<size_t>(last.toInt()), end);
+      }
+      partial = true;
+    }
+
+    if (partial && (start >= info.size || start > end)) {
+      AsyncWebServerResponse* response = rawRequest->beginResponse(416);
+      response->addHeader("Content-Range", String("bytes */") + info.size);
+      rawRequest->send(response);
+      return;
+    }
+  }
+
+  std::shared_ptr<File> file = std::make_shared<File>(SPIFFS.open(path, FILE_READ));
+
+  if (! *file) {
+    request.response.setCode(404);
+    request.response.json["error"] = F("File not found");
+    return;
+  }
+
+  const size_t length = info.size > 0 ? end - start + 1 : 0;
+  file->seek(start);
+
+  AsyncWebServerResponse* response = rawRequest->beginResponse(
+    info.codec == SoundCodec::MP3 ? F("audio/mpeg") : F("application/octet-stream"),
+    length,
+    [file, length](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return file->read(buffer, std::min(maxLen, length - index));
+    }
+  );
+
+  if (partial) {
+    char contentRange[48];
+    sprintf(
+      contentRange,
+      "bytes %u-%u/%u",
+      static_cast<unsigned>(start),
+      static_cast<unsigned>(end),
+      static_cast<unsigned>(info.size)
+    );
+
+    response->setCode(206);
+    response->addHeader("Content-Range", contentRange);
+  }
+
+  response->addHeader("Accept-Ranges", "bytes");
+  response->addHeader("ETag", etag);
+  if (lastModified.length() > 0) {
+    response->addHeader("Last-Modified", lastModified);
+  }
+
+  rawRequest->send(response);
 }
 
 void HttpServer::handleDeleteSound(RequestContext& request) {
   const char* filename = request.pathVariables.get("filename");
-  String path = String(SOUNDS_DIRECTORY) + "/" + filename;
+  char path[AUDIO_MAX_PATH_LENGTH];
 
-  if (SPIFFS.exists(path)) {
+  if (getSoundPath(filename, path) && SPIFFS.exists(path)) {
     if (SPIFFS.remove(path)) {
+      soundIndex.remove(path);
       request.response.json["success"] = true;
     } else {
       request.response.setCode(500);
@@ -99,12 +339,60 @@ void HttpServer::handleDeleteSound(RequestContext& request) {
 
 void HttpServer::handlePostMotorCommand(RequestContext& request) {
   JsonObject body = request.getJsonBody().as<JsonObject>();
+  MotorCommand command;
 
-  if (motor.jsonCommand(body)) {
-    request.response.json["success"] = true;
-  } else {
+  if (! MotorController::parseCommand(body, command)) {
     request.response.setCode(400);
     request.response.json["error"] = "Invalid command";
+    return;
+  }
+
+  uint32_t jobId = motor.enqueue(command);
+
+  if (jobId == 0) {
+    request.response.setCode(503);
+    request.response.json["error"] = F("Motor job queue is full");
+    return;
+  }
+
+  request.response.setCode(202);
+  request.response.json["success"] = true;
+  request.response.json["job_id"] = jobId;
+  request.response.json["status"] = MotorTypes::motorJobStateToStr(MotorJobState::QUEUED);
+}
+
+void HttpServer::handleGetMotorJob(RequestContext& request) {
+  const uint32_t jobId = atoi(request.pathVariables.get("id"));
+  MotorJob job;
+
+  if (! motor.getJob(jobId, job)) {
+    request.response.setCode(404);
+    request.response.json["error"] = F("Job not found");
+    return;
+  }
+
+  const uint32_t now = millis();
+
+  request.response.json["id"] = job.id;
+  request.response.json["type"] = MotorTypes::motorCommandTypeToStr(job.command.type);
+  request.response.json["status"] = MotorTypes::motorJobStateToStr(job.state);
+
+  // Times are milliseconds
+  switch (job.state) {
+    case MotorJobState::QUEUED:
+      request.response.json["queued_for"] = now - job.queuedAt;
+      break;
+
+    case MotorJobState::RUNNING:
+      request.response.json["queued_for"] = job.startedAt - job.queuedAt;
+      request.response.json["running_for"] = now - job.startedAt;
+      break;
+
+    case MotorJobState::DONE:
+      request.response.json["queued_for"] = job.startedAt - job.queuedAt;
+      request.response.json["duration"] = job.finishedAt - job.startedAt;
+      request.response.json["finished_ago"] = now - job.finishedAt;
+      break;
   }
 }
 
@@ -120,21 +408,161 @@ void HttpServer::handlePostAudioCommand(RequestContext& request) {
 }
 
 void HttpServer::handleGetCameraStream(RequestContext& request) {
-  CameraController::CallbackFn callback = camera.chunkedResponseCallback();
-
   auto* response = request.rawRequest->beginChunkedResponse(
     "multipart/x-mixed-replace; boundary=frame",
-    camera.chunkedResponseCallback(true)
+    cameraCallback(request, true)
   );
 
   request.rawRequest->send(response);
 }
 
 void HttpServer::handleGetCameraStill(RequestContext& request) {
-  auto* response = request.rawRequest->beginChunkedResponse("image/jpeg", camera.chunkedResponseCallback());
+  if (isQueryFlagSet(request, "direct")) {
+    auto* response = request.rawRequest->beginChunkedResponse("image/jpeg", cameraCallback(request, false));
+    request.rawRequest->send(response);
+    return;
+  }
+
+  const uint32_t maxAge = getQueryInt(request, "max_age", settings.arducam.snapshot_max_age);
+
+  // Held until the response is sent so the capture task can't reuse the slot
+  std::shared_ptr<FrameRing::FrameRef> frame = std::make_shared<FrameRing::FrameRef>(camera.acquireSnapshot(maxAge));
+
+  if (! *frame) {
+    request.response.setCode(503);
+    request.response.json["error"] = F("Timed out waiting for a frame");
+    return;
+  }
+
+  const uint32_t capturedAt = frame->capturedAt();
+  const size_t length = frame->frame().length;
+
+  auto* response = request.rawRequest->beginResponse(
+    "image/jpeg",
+    length,
+    [frame, length](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      const size_t toCopy = std::min(maxLen, length - index);
+      memcpy(buffer, frame->frame().bytes + index, toCopy);
+
+      if (index + toCopy == length) {
+        Metrics::cameraFrameSend.record((millis() - frame->capturedAt()) * 1000);
+      }
+
+      return toCopy;
+    }
+  );
+
+  response->addHeader("X-Capture-Timestamp", String(capturedAt));
+  response->addHeader("X-Frame-Age", String(millis() - capturedAt));
   request.rawRequest->send(response);
 }
 
+static uint32_t loadStat(const std::atomic<uint32_t>& stat) {
+  return stat.load(std::memory_order_relaxed);
+}
+
+void HttpServer::handleGetCameraStats(RequestContext& request) {
+  const CameraStats& stats = camera.getStats();
+  const uint32_t framesCaptured = loadStat(stats.framesCaptured);
+  const uint32_t framesSent = loadStat(stats.framesSent);
+
+  JsonObject capture = request.response.json.createNestedObject("capture");
+  capture["frames"] = framesCaptured;
+  capture["failures"] = loadStat(stats.captureFailures);
+  capture["bytes"] = loadStat(stats.bytesCaptured);
+  capture["avg_frame_bytes"] = framesCaptured ? loadStat(stats.bytesCaptured) / framesCaptured : 0;
+  capture["avg_capture_us"] = framesCaptured ? loadStat(stats.captureMicros) / framesCaptured : 0;
+  capture["frames_dropped"] = loadStat(stats.framesDropped);
+  capture["no_memory_stalls"] = loadStat(stats.noMemoryStalls);
+  capture["frames_prefetched"] = loadStat(stats.framesPrefetched);
+  capture["prefetches_discarded"] = loadStat(stats.prefetchesDiscarded);
+  capture["timeouts"] = loadStat(stats.captureTimeouts);
+  capture["expected_capture_us"] = camera.getExpectedCaptureMicros();
+  capture["avg_polls_per_capture"] = loadStat(stats.capturesWaited) ? static_cast<float>(loadStat(stats.capturePolls)) / loadStat(stats.capturesWaited) : 0;
+
+  const CameraWsStats wsStats = cameraSocket.getStats();
+  JsonObject websocket = request.response.json.createNestedObject("websocket");
+  websocket["clients"] = wsStats.clients;
+  websocket["frames_sent"] = wsStats.framesSent;
+  websocket["frames_skipped"] = wsStats.framesSkipped;
+  websocket["frames_deferred"] = wsStats.framesDeferred;
+
+  const FrameArenaInfo arenaInfo = camera.getArenaInfo();
+  JsonObject arena = request.response.json.createNestedObject("arena");
+  arena["slot_bytes"] = arenaInfo.slotSize;
+  arena["total_bytes"] = arenaInfo.totalBytes;
+  arena["psram"] = arenaInfo.psram;
+  arena["allocation_failures"] = arenaInfo.allocationFailures;
+  arena["slots"] = arenaInfo.slots;
+  arena["slots_allocated"] = arenaInfo.slotsAllocated;
+  arena["state"] = FrameRing::stateToStr(arenaInfo.state);
+
+  JsonObject send = request.response.json.createNestedObject("send");
+  send["frames"] = framesSent;
+  send["frames_skipped"] = loadStat(stats.framesSkipped);
+  send["bytes_copied"] = loadStat(stats.bytesCopied);
+  send["avg_bytes_copied_per_frame"] = framesSent ? loadStat(stats.bytesCopied) / framesSent : 0;
+  send["avg_frame_wait_us"] = framesSent ? loadStat(stats.frameWaitMicros) / framesSent : 0;
+  send["snapshots_reused"] = loadStat(stats.snapshotsReused);
+}
+
+void HttpServer::handleGetCameraMotion(RequestContext& request) {
+  const bool includeGrid = isQueryFlagSet(request, "grid");
+  uint8_t grid[MOTION_GRID_CELLS];
+  const MotionStatus status = camera.getMotionStatus(includeGrid ? grid : NULL);
+  const uint32_t now = millis();
+
+  request.response.json["enabled"] = static_cast<bool>(settings.motion.enabled);
+  request.response.json["motion"] = status.lastResult.motion;
+  request.response.json["changed_cells"] = status.lastResult.changedCells;
+  request.response.json["max_delta"] = status.lastResult.maxDelta;
+  request.response.json["last_analyzed_ms_ago"] = status.framesAnalyzed ? now - status.lastAnalyzedAt : 0;
+  request.response.json["frames_analyzed"] = status.framesAnalyzed;
+  request.response.json["parse_failures"] = status.parseFailures;
+  request.response.json["avg_analyze_us"] = (status.framesAnalyzed + status.parseFailures)
+    ? status.analyzeMicros / (status.framesAnalyzed + status.parseFailures)
+    : 0;
+  request.response.json["events"] = status.events;
+
+  if (status.lastEventAt != 0) {
+    request.response.json["last_event_ms_ago"] = now - status.lastEventAt;
+  }
+
+  if (includeGrid) {
+    request.response.json["grid_width"] = MOTION_GRID_WIDTH;
+    JsonArray cells = request.response.json.createNestedArray("grid");
+
+    for (size_t i = 0; i < MOTION_GRID_CELLS; ++i) {
+      cells.add(grid[i]);
+    }
+  }
+}
+
+void HttpServer::handleGetCameraMotionCapture(RequestContext& request) {
+  if (! SPIFFS.exists(MOTION_CAPTURE_FILE)) {
+    request.response.setCode(404);
+    request.response.json["error"] = F("No motion capture");
+    return;
+  }
+
+  request.rawRequest->send(SPIFFS, MOTION_CAPTURE_FILE, F("image/jpeg"));
+}
+
+CameraController::CallbackFn HttpServer::cameraCallback(RequestContext& request, bool continuous) {
+  uint16_t targetFps = settings.arducam.target_fps;
+  AsyncWebParameter* fpsParam = request.rawRequest->getParam("fps");
+
+  if (fpsParam != NULL) {
+    targetFps = fpsParam->value().toInt();
+  }
+
+  if (isQueryFlagSet(request, "direct")) {
+    return camera.directResponseCallback(continuous, targetFps);
+  } else {
+    return camera.chunkedResponseCallback(continuous, targetFps);
+  }
+}
+
 void HttpServer::handleUpdateSettings(RequestContext& request) {
   JsonObject req = request.getJsonBody().as<JsonObject>();
 
@@ -150,17 +578,37 @@ void HttpServer::handleUpdateSettings(RequestContext& request) {
     params[kv.key().c_str()] = kv.value().as<char*>();
   }
 
-  settings.setFromDictionary(params);
-  Bleeper.storage.persist();
+  // Written to flash in the background once updates stop coming in
+  settingsJournal.update(params);
+  invalidateSettings();
 
   handleListSettings(request);
 }
 
 void HttpServer::handleListSettings(RequestContext& request) {
-  request.response.sendRaw(200, APPLICATION_JSON, getSettingsBody().c_str());
+  const String& body = getSettingsBody();
+  AsyncWebHeader* ifNoneMatch = request.rawRequest->getHeader("If-None-Match");
+  AsyncWebServerResponse* response;
+
+  if (ifNoneMatch != NULL && ifNoneMatch->value() == cachedSettingsEtag) {
+    response = request.rawRequest->beginResponse(304);
+  } else {
+    response = request.rawRequest->beginResponse(200, APPLICATION_JSON, body);
+  }
+
+  response->addHeader("ETag", cachedSettingsEtag);
+  request.rawRequest->send(response);
+}
+
+void HttpServer::invalidateSettings() {
+  ++settingsGeneration;
 }
 
-String HttpServer::getSettingsBody() {
+const String& HttpServer::getSettingsBody() {
+  if (cachedSettingsGeneration == settingsGeneration) {
+    return cachedSettingsBody;
+  }
+
   DynamicJsonDocument json(2048);
 
   ConfigurationDictionary params = settings.getAsDictionary(true);
@@ -168,64 +616,245 @@ String HttpServer::getSettingsBody() {
     json[it->first] = it->second;
   }
 
-  String strJson;
-  serializeJson(json, strJson);
+  cachedSettingsBody = "";
+  serializeJson(json, cachedSettingsBody);
+
+  char etag[24];
+  snprintf(etag, sizeof(etag), "\"%08x-%x\"", static_cast<unsigned>(settingsBootId), static_cast<unsigned>(settingsGeneration));
+  cachedSettingsEtag = etag;
+  cachedSettingsGeneration = settingsGeneration;
 
-  return strJson;
+  return cachedSettingsBody;
 }
 
 void HttpServer::handleAbout(RequestContext& request) {
   // Measure before allocating buffers
   uint32_t freeHeap = ESP.getFreeHeap();
+  const HeapAccounting::HeapInfo heapInfo = HeapAccounting::getHeapInfo();
 
   request.response.json["version"] = QUOTE(TREAT_DISPENSER_VERSION);
   request.response.json["variant"] = QUOTE(FIRMWARE_VARIANT);
   request.response.json["free_heap"] = freeHeap;
   request.response.json["sdk_version"] = ESP.getSdkVersion();
+
+  JsonObject heap = request.response.json.createNestedObject("heap");
+  heap["largest_free_block"] = heapInfo.largestFreeBlock;
+  heap["fragmentation"] = heapInfo.fragmentation;
+
+  // operator new usage only; see HeapAccounting.h
+  JsonObject subsystems = heap.createNestedObject("subsystems");
+  const uint32_t now = millis();
+
+  for (size_t i = 0; i < static_cast<size_t>(HeapAccounting::Subsystem::COUNT); ++i) {
+    const HeapAccounting::Subsystem subsystem = static_cast<HeapAccounting::Subsystem>(i);
+    const HeapAccounting::Usage usage = HeapAccounting::getUsage(subsystem);
+
+    JsonObject json = subsystems.createNestedObject(HeapAccounting::subsystemToStr(subsystem));
+    json["bytes"] = usage.currentBytes;
+    json["peak_bytes"] = usage.peakBytes;
+    json["allocations"] = usage.allocations;
+    json["allocations_per_second"] = HeapAccounting::getAllocationRate(subsystem, now);
+  }
+}
+
+void HttpServer::handleGetMetrics(RequestContext& request) {
+  std::shared_ptr<MetricsWriter> writer = std::make_shared<MetricsWriter>();
+
+  auto* response = request.rawRequest->beginChunkedResponse(
+    F("text/plain; version=0.0.4"),
+    [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return writer->fill(buffer, maxLen);
+    }
+  );
+  request.rawRequest->send(response);
+}
+
+void HttpServer::handleGetTrace(RequestContext& request) {
+  std::shared_ptr<TraceWriter> writer = std::make_shared<TraceWriter>();
+
+  auto* response = request.rawRequest->beginChunkedResponse(
+    APPLICATION_JSON,
+    [writer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return writer->fill(buffer, maxLen);
+    }
+  );
+  request.rawRequest->send(response);
 }
 
 ////////============== Handler wrappers
 
+HandlerFn HttpServer::timed(const char* labels, HandlerFn handler) {
+  // Lives as long as the route
+  Histogram* histogram = new Histogram("http_handler_seconds", "Time spent in HTTP request handlers", labels);
+
+  return [histogram, labels, handler](RequestContext& request) {
+    // Handlers, response fillers and uploads all run on the async TCP task
+    HeapAccounting::registerTask(HeapAccounting::Subsystem::HTTP);
+
+    Histogram::Timer timer(*histogram);
+    Trace::Scope trace(labels);
+    handler(request);
+  };
+}
+
+bool HttpServer::getSoundPath(const char* filename, char (&path)[AUDIO_MAX_PATH_LENGTH]) {
+  const int len = snprintf(path, sizeof(path), "%s/%s", SOUNDS_DIRECTORY, filename);
+  return len > 0 && static_cast<size_t>(len) < sizeof(path);
+}
+
+bool HttpServer::isQueryFlagSet(RequestContext& request, const char* name) {
+  AsyncWebParameter* param = request.rawRequest->getParam(name);
+  return param != NULL && param->value().equalsIgnoreCase("true");
+}
+
+HttpServer::UploadState::UploadState(const String& path)
+  : file(path)
+{ }
+
 void HttpServer::handleCreateFile(const char* filePrefix, RequestContext& request) {
-  static File updateFile;
+  AsyncWebServerRequest* rawRequest = request.rawRequest;
+  const String path = String(filePrefix) + "/" + request.upload.filename;
 
   if (request.upload.index == 0) {
-    String path = String(filePrefix) + "/" + request.upload.filename;
-    updateFile = SPIFFS.open(path, FILE_WRITE);
+    // However the request ends, drop its state.  An upload that wasn't
+    // committed takes its temp file with it.
+    rawRequest->onDisconnect([this, rawRequest]() {
+      uploads.erase(rawRequest);
+      uploadResults.erase(rawRequest);
+    });
+
+    if (uploads.size() >= UPLOAD_MAX_CONCURRENT) {
+      request.response.json["error"] = F("Too many uploads in progress");
+      finishUpload(request, 503);
+      return;
+    }
+
+    std::unique_ptr<UploadState> upload(new UploadState(path));
 
-    if (!updateFile) {
+    if (! upload->file.begin()) {
       request.response.json["error"] = F("Failed to open file");
-      request.response.setCode(500);
+      finishUpload(request, 500);
       return;
     }
+
+    uploads[rawRequest] = std::move(upload);
+  }
+
+  auto it = uploads.find(rawRequest);
+
+  // Already failed
+  if (it == uploads.end()) {
+    return;
   }
 
-  if (!updateFile || updateFile.write(request.upload.data, request.upload.length) != request.upload.length) {
+  UploadState& upload = *it->second;
+
+  if (! upload.file.write(request.upload.data, request.upload.length)) {
     request.response.json["error"] = F("Failed to write to file");
-    request.response.setCode(500);
+    finishUpload(request, 500);
+    return;
   }
 
-  if (updateFile && request.upload.isFinal) {
-    updateFile.close();
-    request.response.json["success"] = true;
+  upload.analyzer.update(request.upload.data, request.upload.length);
+
+  if (! request.upload.isFinal) {
+    return;
+  }
+
+  SoundInfo info;
+  upload.analyzer.finish(path.c_str(), info);
+
+  char crc[9];
+  sprintf(crc, "%08x", static_cast<unsigned>(info.crc32));
+
+  AsyncWebHeader* expectedCrc = rawRequest->getHeader("X-Content-CRC32");
+
+  if (expectedCrc != NULL && strtoul(expectedCrc->value().c_str(), NULL, 16) != info.crc32) {
+    request.response.json["error"] = F("Checksum mismatch");
+    request.response.json["crc32"] = crc;
+    finishUpload(request, 400);
+    return;
+  }
+
+  if (! upload.file.commit()) {
+    request.response.json["error"] = F("Failed to save file");
+    finishUpload(request, 500);
+    return;
+  }
+
+  request.response.json["success"] = true;
+  request.response.json["size"] = upload.file.getSize();
+  request.response.json["crc32"] = crc;
+  request.response.json["elapsed_ms"] = upload.file.getElapsedMs();
+  request.response.json["throughput_kbps"] = upload.file.getThroughputKbps();
+
+  if (strcmp(filePrefix, SOUNDS_DIRECTORY) == 0) {
+    soundIndex.put(info);
+
+    request.response.json["duration_ms"] = info.durationMs;
+    request.response.json["codec"] = SoundAnalyzer::codecToStr(info.codec);
+
+    if (isQueryFlagSet(request, "transcode")) {
+      request.response.json["transcoding"] = audio.transcodeToImaAdpcm(path);
+    }
   }
+
+  finishUpload(request, 200);
+}
+
+void HttpServer::finishUpload(RequestContext& request, uint16_t code) {
+  UploadResult& result = uploadResults[request.rawRequest];
+
+  result.code = code;
+  result.body = "";
+  serializeJson(request.response.json, result.body);
+
+  uploads.erase(request.rawRequest);
+}
+
+// The upload callback's response is thrown away, so the result it left
+// behind is sent from here
+void HttpServer::handleCreateFileComplete(RequestContext& request) {
+  auto it = uploadResults.find(request.rawRequest);
+
+  if (it == uploadResults.end()) {
+    request.response.json["error"] = F("No file uploaded");
+    request.response.setCode(400);
+    return;
+  }
+
+  request.rawRequest->send(it->second.code, APPLICATION_JSON, it->second.body);
+  uploadResults.erase(it);
+}
+
+size_t HttpServer::getQueryInt(RequestContext& request, const char* name, size_t defaultValue) {
+  AsyncWebParameter* param = request.rawRequest->getParam(name);
+
+  if (param == NULL) {
+    return defaultValue;
+  }
+
+  long value = param->value().toInt();
+  return value > 0 ? value : 0;
 }
 
 void HttpServer::handleListDirectory(const char* dirName, RequestContext& request) {
-  JsonArray response = request.response.json.to<JsonArray>();
+  AsyncWebParameter* fieldsParam = request.rawRequest->getParam("fields");
 
-#if defined(ESP8266)
-  Dir dir = SPIFFS.openDir(dirName);
+  const size_t offset = getQueryInt(request, "offset", 0);
+  const size_t limit = getQueryInt(request, "limit", 0);
+  const uint16_t fields = fieldsParam != NULL ? DirectoryListing::parseFields(fieldsParam->value()) : DirectoryListing::ALL_FIELDS;
+
+  std::shared_ptr<DirectoryListing> listing;
 
-  while (dir.next()) {
-    JsonObject file = response.createNestedObject();
-    file["name"] = dir.fileName();
-    file["size"] = dir.fileSize();
+  // Sounds are listed from the index, which also has their metadata
+  if (strcmp(dirName, SOUNDS_DIRECTORY) == 0) {
+    listing = std::make_shared<SoundIndexListing>(soundIndex, offset, limit, fields);
+  } else {
+    listing = std::make_shared<DirectoryListing>(dirName, offset, limit, fields);
   }
-#elif defined(ESP32)
-  File dir = SPIFFS.open(dirName);
 
-  if (!dir || !dir.isDirectory()) {
+  if (! listing->open()) {
     Serial.print(F("Path is not a directory - "));
     Serial.println(dirName);
 
@@ -234,11 +863,13 @@ void HttpServer::handleListDirectory(const char* dirName, RequestContext& reques
     return;
   }
 
-  while (File dirFile = dir.openNextFile()) {
-    JsonObject file = response.createNestedObject();
-
-    file["name"] = String(dirFile.name());
-    file["size"] = dirFile.size();
-  }
-#endif
-}
\ No newline at end of file
+  // Entries are serialized as the response is sent rather than buffered up
+  // front, so large directories don't run into the JSON buffer size.
+  auto* response = request.rawRequest->beginChunkedResponse(
+    APPLICATION_JSON,
+    [listing](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+      return listing->fill(buffer, maxLen);
+    }
+  );
+  request.rawRequest->send(response);
+}
@@ -1,10 +1,21 @@
 #include <ESPAsyncWebServer.h>
 #include <Settings.h>
+#include <SettingsJournal.h>
 #include <ArduCAM.h>
 #include <MotorControler.h>
 #include <CameraController.h>
 #include <AudioController.h>
 #include <RichHttpServer.h>
+#include <DirectoryListing.h>
+#include <SoundIndexListing.h>
+#include <FileUpload.h>
+#include <CameraWebSocket.h>
+#include <Metrics.h>
+#include <MetricsWriter.h>
+#include <HeapAccounting.h>
+#include <TraceWriter.h>
+
+#include <map>
 
 #if defined(ESP32)
 extern "C" {
@@ -12,49 +23,108 @@ extern "C" {
 }
 #endif
 
+// Each upload holds a write buffer of UPLOAD_BUFFER_SIZE bytes
+#ifndef UPLOAD_MAX_CONCURRENT
+#define UPLOAD_MAX_CONCURRENT 2
+#endif
+
 #ifndef _HTTP_SERVER_H
 #define _HTTP_SERVER_H
 
 using RichHttpConfig = RichHttp::Generics::Configs::AsyncWebServer;
 using RequestContext = RichHttpConfig::RequestContextType;
+using HandlerFn = std::function<void(RequestContext&)>;
 
 class HttpServer {
 public:
-  HttpServer(Settings& settings, CameraController& camera, MotorController& motor, AudioController& audio);
+  HttpServer(Settings& settings, SettingsJournal& settingsJournal, CameraController& camera, MotorController& motor, AudioController& audio, SoundIndex& soundIndex);
 
   void begin();
+  // Sends frames to WebSocket clients.  Call from the main loop.
+  void loop();
 
 private:
   Settings& settings;
+  SettingsJournal& settingsJournal;
   PassthroughAuthProvider<HttpSettings> authProvider;
   RichHttpServer<RichHttpConfig> server;
   MotorController& motor;
   CameraController& camera;
   AudioController& audio;
+  SoundIndex& soundIndex;
+  CameraWebSocket cameraSocket;
+
+  // Serialized settings are cached until the next update.  The ETag combines
+  // a per-boot random value with the generation so it can't collide with one
+  // handed out before a reboot.
+  uint32_t settingsBootId;
+  uint32_t settingsGeneration;
+  uint32_t cachedSettingsGeneration;
+  String cachedSettingsBody;
+  String cachedSettingsEtag;
+
+  struct UploadState {
+    UploadState(const String& path);
+
+    FileUpload file;
+    SoundAnalyzer analyzer;
+  };
+
+  // What the completion handler sends once the last chunk is in
+  struct UploadResult {
+    uint16_t code;
+    String body;
+  };
+
+  // Uploads in progress and finished uploads waiting on their completion
+  // handler, keyed by request.  Only touched from the web server task.
+  std::map<AsyncWebServerRequest*, std::unique_ptr<UploadState>> uploads;
+  std::map<AsyncWebServerRequest*, UploadResult> uploadResults;
 
   // Settings CRUD
-  String getSettingsBody();
+  const String& getSettingsBody();
+  void invalidateSettings();
   void handleUpdateSettings(RequestContext& request);
   void handleListSettings(RequestContext& request);
 
   // General info routes
   void handleAbout(RequestContext& request);
+  void handleGetMetrics(RequestContext& request);
+  void handleGetTrace(RequestContext& request);
 
   // Camera
   void handleGetCameraStill(RequestContext& request);
   void handleGetCameraStream(RequestContext& request);
+  void handleGetCameraStats(RequestContext& request);
+  void handleGetCameraMotion(RequestContext& request);
+  void handleGetCameraMotionCapture(RequestContext& request);
+  CameraController::CallbackFn cameraCallback(RequestContext& request, bool continuous);
 
   // Motor
   void handlePostMotorCommand(RequestContext& request);
+  void handleGetMotorJob(RequestContext& request);
 
   // Audio
   void handleDeleteSound(RequestContext& request);
   void handleShowSound(RequestContext& request);
   void handlePostAudioCommand(RequestContext& request);
+  // Builds SOUNDS_DIRECTORY/filename into path without allocating.  Returns
+  // false if it wouldn't fit.
+  static bool getSoundPath(const char* filename, char (&path)[AUDIO_MAX_PATH_LENGTH]);
 
   // General helpers
+  // Wraps a handler to record its run time in an http_handler_seconds
+  // histogram for the route, and in the trace.  For streamed responses this only covers setting
+  // the response up.
+  HandlerFn timed(const char* labels, HandlerFn handler);
+  bool isQueryFlagSet(RequestContext& request, const char* name);
+  size_t getQueryInt(RequestContext& request, const char* name, size_t defaultValue);
   void handleListDirectory(const char* dir, RequestContext& request);
   void handleCreateFile(const char* filePrefix, RequestContext& request);
+  void handleCreateFileComplete(RequestContext& request);
+  // Records the upload callback's response for the completion handler and
+  // drops the upload's state
+  void finishUpload(RequestContext& request, uint16_t code);
 };
 
 #endif
\ No newline at end of file
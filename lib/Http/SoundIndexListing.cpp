@@ -0,0 +1,73 @@
+#include <SoundIndexListing.h>
+
+#include <algorithm>
+#include <string.h>
+
+SoundIndexListing::SoundIndexListing(SoundIndex& index, size_t offset, size_t limit, uint16_t fields)
+  : DirectoryListing(SOUNDS_DIRECTORY, offset, limit, fields)
+  , index(index)
+  , batchLen(0)
+  , batchIx(0)
+  , recordIx(0)
+{ }
+
+bool SoundIndexListing::open() {
+  return true;
+}
+
+bool SoundIndexListing::nextEntry(char* name, size_t& size) {
+  while (true) {
+    // batchIx points one past the current entry
+    if (batchIx >= batchLen) {
+      batchLen = index.read(recordIx, batch, SOUND_INDEX_LISTING_BATCH_SIZE);
+      batchIx = 0;
+      recordIx += batchLen;
+
+      if (batchLen == 0) {
+        return false;
+      }
+    }
+
+    const SoundInfo& info = batch[batchIx++];
+
+    // Skip tombstones
+    if (info.name[0] != 0) {
+      // Index names aren't terminated when they fill the field
+      const size_t length = strnlen(info.name, std::min(sizeof(info.name), MAX_NAME_LENGTH));
+      memcpy(name, info.name, length);
+      name[length] = 0;
+      size = info.size;
+
+      return true;
+    }
+  }
+}
+
+size_t SoundIndexListing::writeExtraFields(char* out) {
+  const SoundInfo& info = batch[batchIx - 1];
+  char* p = out;
+
+  if (fields & FIELD_DURATION) {
+    p += sprintf(p, ",\"duration_ms\":%u", static_cast<unsigned>(info.durationMs));
+  }
+  if (fields & FIELD_BITRATE) {
+    p += sprintf(p, ",\"bitrate_kbps\":%u", static_cast<unsigned>(info.bitrateKbps));
+  }
+  if (fields & FIELD_SAMPLE_RATE) {
+    p += sprintf(p, ",\"sample_rate\":%u", static_cast<unsigned>(info.sampleRate));
+  }
+  if (fields & FIELD_CHANNELS) {
+    p += sprintf(p, ",\"channels\":%u", static_cast<unsigned>(info.channels));
+  }
+  if (fields & FIELD_CODEC) {
+    p += sprintf(p, ",\"codec\":\"%s\"", SoundAnalyzer::codecToStr(info.codec).c_str());
+  }
+  if (fields & FIELD_HASH) {
+    p += sprintf(p, ",\"crc32\":\"%08x\"", static_cast<unsigned>(info.crc32));
+  }
+  if (fields & FIELD_MODIFIED) {
+    p += sprintf(p, ",\"modified\":%u", static_cast<unsigned>(info.modifiedAt));
+  }
+
+  return p - out;
+}
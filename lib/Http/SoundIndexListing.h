@@ -0,0 +1,34 @@
+#include <DirectoryListing.h>
+#include <Settings.h>
+#include <SoundIndex.h>
+
+// Records read from the index per batch
+#ifndef SOUND_INDEX_LISTING_BATCH_SIZE
+#define SOUND_INDEX_LISTING_BATCH_SIZE 4
+#endif
+
+#ifndef _SOUND_INDEX_LISTING_H
+#define _SOUND_INDEX_LISTING_H
+
+// Lists the sounds directory from the sound index instead of walking the
+// directory, which also makes each sound's metadata available.
+class SoundIndexListing : public DirectoryListing {
+public:
+  SoundIndexListing(SoundIndex& index, size_t offset, size_t limit, uint16_t fields);
+
+  virtual bool open() override;
+
+protected:
+  virtual bool nextEntry(char* name, size_t& size) override;
+  virtual size_t writeExtraFields(char* out) override;
+
+private:
+  SoundIndex& index;
+
+  SoundInfo batch[SOUND_INDEX_LISTING_BATCH_SIZE];
+  size_t batchLen;
+  size_t batchIx;
+  size_t recordIx;
+};
+
+#endif
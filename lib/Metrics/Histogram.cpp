@@ -0,0 +1,94 @@
+#include <Histogram.h>
+
+// 50us to 10s, roughly 1-2.5-5 per decade
+const uint32_t Histogram::BUCKET_BOUNDS[Histogram::NUM_BUCKETS - 1] = {
+  50, 100, 250, 500,
+  1000, 2500, 5000,
+  10000, 25000, 50000,
+  100000, 250000, 500000,
+  1000000, 2500000, 5000000,
+  10000000
+};
+
+Histogram* Histogram::head = NULL;
+Histogram* Histogram::tail = NULL;
+
+Histogram::Timer::Timer(Histogram& histogram)
+  : histogram(histogram)
+  , start(micros())
+{ }
+
+Histogram::Timer::~Timer() {
+  histogram.recordSince(start);
+}
+
+Histogram::Histogram(const char* name, const char* help, const char* labels)
+  : name(name)
+  , help(help)
+  , labels(labels)
+  , sumLow(0)
+  , sumHigh(0)
+  , nextHistogram(NULL)
+{
+  for (uint8_t i = 0; i < NUM_BUCKETS; ++i) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+
+  if (tail == NULL) {
+    head = this;
+  } else {
+    tail->nextHistogram = this;
+  }
+  tail = this;
+}
+
+void Histogram::record(uint32_t micros) {
+  uint8_t bucket = 0;
+
+  while (bucket < NUM_BUCKETS - 1 && micros > BUCKET_BOUNDS[bucket]) {
+    ++bucket;
+  }
+
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  const uint32_t before = sumLow.fetch_add(micros, std::memory_order_relaxed);
+  if (static_cast<uint32_t>(before + micros) < before) {
+    sumHigh.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::recordSince(uint32_t startMicros) {
+  record(micros() - startMicros);
+}
+
+void Histogram::snapshot(Snapshot& snapshot) const {
+  snapshot.count = 0;
+
+  for (uint8_t i = 0; i < NUM_BUCKETS; ++i) {
+    snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    snapshot.count += snapshot.buckets[i];
+  }
+
+  snapshot.sumMicros = (static_cast<uint64_t>(sumHigh.load(std::memory_order_relaxed)) << 32)
+    | sumLow.load(std::memory_order_relaxed);
+}
+
+const char* Histogram::getName() const {
+  return name;
+}
+
+const char* Histogram::getHelp() const {
+  return help;
+}
+
+const char* Histogram::getLabels() const {
+  return labels;
+}
+
+Histogram* Histogram::first() {
+  return head;
+}
+
+Histogram* Histogram::next() const {
+  return nextHistogram;
+}
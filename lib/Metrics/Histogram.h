@@ -0,0 +1,75 @@
+#include <Arduino.h>
+#include <atomic>
+
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+// Latency histogram with fixed bucket boundaries.  Recording is a couple of
+// atomic increments, so it's safe from any task without a lock.
+//
+// Every histogram registers itself on construction so /metrics can find it.
+// They're expected to live forever (globals, or members of objects that do).
+class Histogram {
+public:
+  // Including the implicit +Inf bucket
+  static const uint8_t NUM_BUCKETS = 18;
+  // Upper bound of each bucket, in microseconds
+  static const uint32_t BUCKET_BOUNDS[NUM_BUCKETS - 1];
+
+  struct Snapshot {
+    // Not cumulative
+    uint32_t buckets[NUM_BUCKETS];
+    uint32_t count;
+    uint64_t sumMicros;
+  };
+
+  // Records the time from construction to destruction
+  class Timer {
+  public:
+    Timer(Histogram& histogram);
+    ~Timer();
+
+  private:
+    Histogram& histogram;
+    const uint32_t start;
+  };
+
+  // labels are in Prometheus syntax without braces (e.g., handler="/about"),
+  // and must outlive the histogram.
+  Histogram(const char* name, const char* help, const char* labels = NULL);
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void record(uint32_t micros);
+  void recordSince(uint32_t startMicros);
+
+  // Counts may be slightly inconsistent with each other if a value is
+  // recorded mid-snapshot
+  void snapshot(Snapshot& snapshot) const;
+
+  const char* getName() const;
+  const char* getHelp() const;
+  const char* getLabels() const;
+
+  // Registered histograms, in registration order
+  static Histogram* first();
+  Histogram* next() const;
+
+private:
+  const char* name;
+  const char* help;
+  const char* labels;
+
+  std::atomic<uint32_t> buckets[NUM_BUCKETS];
+  // 64-bit sum as two words.  Whoever's add wraps the low word carries.
+  std::atomic<uint32_t> sumLow;
+  std::atomic<uint32_t> sumHigh;
+
+  Histogram* nextHistogram;
+
+  static Histogram* head;
+  static Histogram* tail;
+};
+
+#endif
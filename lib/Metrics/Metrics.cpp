@@ -0,0 +1,24 @@
+#include <Metrics.h>
+
+namespace Metrics {
+  Histogram cameraCapture(
+    "camera_capture_seconds",
+    "Time from triggering a capture to the frame being ready in the camera FIFO"
+  );
+  Histogram cameraFifoRead(
+    "camera_fifo_read_seconds",
+    "Time to read a frame out of the camera FIFO over SPI"
+  );
+  Histogram cameraFrameSend(
+    "camera_frame_send_seconds",
+    "Time from a frame being captured to its last chunk being sent"
+  );
+  Histogram motorCommand(
+    "motor_command_seconds",
+    "Time spent executing a motor command"
+  );
+  Histogram audioStart(
+    "audio_start_seconds",
+    "Time from a play request to playback starting"
+  );
+};
@@ -0,0 +1,22 @@
+#include <Histogram.h>
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+// Latency histograms for the hot paths, exported at /metrics
+namespace Metrics {
+  // Capture trigger to CAP_DONE
+  extern Histogram cameraCapture;
+  // Burst read of a frame out of the camera FIFO
+  extern Histogram cameraFifoRead;
+  // Frame published to its last chunk handed to the web server
+  extern Histogram cameraFrameSend;
+
+  // Motor command execution, excluding time spent queued
+  extern Histogram motorCommand;
+
+  // Play request queued to playback started
+  extern Histogram audioStart;
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include <MetricsWriter.h>
+
+// Formats a duration in seconds without trailing zeros, e.g. "0.00025"
+static size_t formatSeconds(char* out, uint64_t micros) {
+  size_t len = sprintf(
+    out,
+    "%lu.%06lu",
+    static_cast<unsigned long>(micros / 1000000),
+    static_cast<unsigned long>(micros % 1000000)
+  );
+
+  while (out[len - 1] == '0') {
+    --len;
+  }
+  if (out[len - 1] == '.') {
+    --len;
+  }
+
+  out[len] = 0;
+  return len;
+}
+
+static const size_t NUM_SUBSYSTEMS = static_cast<size_t>(HeapAccounting::Subsystem::COUNT);
+
+// Per-subsystem series, each a header line followed by one line per subsystem
+enum class HeapSeries { CURRENT, PEAK, ALLOCATIONS, COUNT };
+
+static const char* HEAP_SERIES_NAMES[] = {
+  "heap_subsystem_bytes",
+  "heap_subsystem_peak_bytes",
+  "heap_subsystem_allocations_total"
+};
+
+static const char* HEAP_SERIES_HELP[] = {
+  "Bytes currently allocated with operator new, by subsystem.",
+  "Most bytes allocated at once with operator new, by subsystem.",
+  "Allocations made with operator new, by subsystem."
+};
+
+static const char* HEAP_SERIES_TYPES[] = { "gauge", "gauge", "counter" };
+
+// Heap-wide gauges come first, one line each
+static const uint8_t NUM_HEAP_GAUGES = 3;
+static const uint8_t NUM_HEAP_LINES =
+  NUM_HEAP_GAUGES + static_cast<uint8_t>(HeapSeries::COUNT) * (1 + NUM_SUBSYSTEMS);
+
+MetricsWriter::MetricsWriter()
+  : current(Histogram::first())
+  , previousName(NULL)
+  , line(Line::HEADER)
+  , bucketIx(0)
+  , cumulativeCount(0)
+  , heapLineIx(0)
+  , heapInfo()
+  , pendingLen(0)
+  , pendingIx(0)
+{ }
+
+size_t MetricsWriter::fill(uint8_t* buffer, size_t maxLen) {
+  size_t written = 0;
+
+  while (written < maxLen) {
+    if (pendingIx < pendingLen) {
+      const size_t toCopy = std::min(maxLen - written, pendingLen - pendingIx);
+
+      memcpy(buffer + written, pending + pendingIx, toCopy);
+      written += toCopy;
+      pendingIx += toCopy;
+    } else if (current != NULL) {
+      refill();
+    } else if (! heapDone()) {
+      refillHeap();
+    } else {
+      break;
+    }
+  }
+
+  return written;
+}
+
+size_t MetricsWriter::writeSeriesName(char* out, const char* suffix, const char* le) {
+  const char* labels = current->getLabels();
+  char* p = out;
+
+  p += sprintf(p, "%s%s", current->getName(), suffix);
+
+  if (labels != NULL || le != NULL) {
+    *p++ = '{';
+    if (labels != NULL) {
+      p += sprintf(p, "%s%s", labels, le != NULL ? "," : "");
+    }
+    if (le != NULL) {
+      p += sprintf(p, "le=\"%s\"", le);
+    }
+    *p++ = '}';
+  }
+
+  *p++ = ' ';
+
+  return p - out;
+}
+
+void MetricsWriter::refill() {
+  char* p = pending;
+
+  switch (line) {
+    case Line::HEADER:
+      current->snapshot(snapshot);
+      cumulativeCount = 0;
+      bucketIx = 0;
+      line = Line::BUCKET;
+
+      // Series of the same metric with different labels share a header
+      if (previousName == NULL || strcmp(previousName, current->getName()) != 0) {
+        p += sprintf(
+          p,
+          "# HELP %s %s\n# TYPE %s histogram\n",
+          current->getName(),
+          current->getHelp(),
+          current->getName()
+        );
+        previousName = current->getName();
+      }
+      break;
+
+    case Line::BUCKET: {
+      char le[24];
+
+      if (bucketIx < Histogram::NUM_BUCKETS - 1) {
+        formatSeconds(le, Histogram::BUCKET_BOUNDS[bucketIx]);
+      } else {
+        strcpy(le, "+Inf");
+      }
+
+      cumulativeCount += snapshot.buckets[bucketIx];
+
+      p += writeSeriesName(p, "_bucket", le);
+      p += sprintf(p, "%u\n", static_cast<unsigned>(cumulativeCount));
+
+      if (++bucketIx == Histogram::NUM_BUCKETS) {
+        line = Line::SUM;
+      }
+      break;
+    }
+
+    case Line::SUM:
+      p += writeSeriesName(p, "_sum", NULL);
+      p += formatSeconds(p, snapshot.sumMicros);
+      *p++ = '\n';
+      line = Line::COUNT;
+      break;
+
+    case Line::COUNT:
+      p += writeSeriesName(p, "_count", NULL);
+      p += sprintf(p, "%u\n", static_cast<unsigned>(snapshot.count));
+
+      current = current->next();
+      line = Line::HEADER;
+      break;
+  }
+
+  pendingLen = p - pending;
+  pendingIx = 0;
+}
+
+bool MetricsWriter::heapDone() const {
+  return heapLineIx >= NUM_HEAP_LINES;
+}
+
+void MetricsWriter::refillHeap() {
+  char* p = pending;
+
+  if (heapLineIx < NUM_HEAP_GAUGES) {
+    // Sample once so the three gauges are consistent with each other
+    if (heapLineIx == 0) {
+      heapInfo = HeapAccounting::getHeapInfo();
+    }
+
+    switch (heapLineIx) {
+      case 0:
+        p += sprintf(
+          p,
+          "# HELP heap_free_bytes Free heap.\n# TYPE heap_free_bytes gauge\nheap_free_bytes %u\n",
+          static_cast<unsigned>(heapInfo.freeBytes)
+        );
+        break;
+
+      case 1:
+        p += sprintf(
+          p,
+          "# HELP heap_largest_free_block_bytes Largest allocation that could succeed.\n"
+          "# TYPE heap_largest_free_block_bytes gauge\nheap_largest_free_block_bytes %u\n",
+          static_cast<unsigned>(heapInfo.largestFreeBlock)
+        );
+        break;
+
+      case 2:
+        p += sprintf(
+          p,
+          "# HELP heap_fragmentation_ratio 1 - largest free block / free heap.\n"
+          "# TYPE heap_fragmentation_ratio gauge\nheap_fragmentation_ratio %.3f\n",
+          heapInfo.fragmentation
+        );
+        break;
+    }
+  } else {
+    const uint8_t ix = heapLineIx - NUM_HEAP_GAUGES;
+    const uint8_t seriesIx = ix / (1 + NUM_SUBSYSTEMS);
+    const uint8_t lineIx = ix % (1 + NUM_SUBSYSTEMS);
+    const char* name = HEAP_SERIES_NAMES[seriesIx];
+
+    if (lineIx == 0) {
+      p += sprintf(
+        p,
+        "# HELP %s %s\n# TYPE %s %s\n",
+        name,
+        HEAP_SERIES_HELP[seriesIx],
+        name,
+        HEAP_SERIES_TYPES[seriesIx]
+      );
+    } else {
+      const HeapAccounting::Subsystem subsystem = static_cast<HeapAccounting::Subsystem>(lineIx - 1);
+      const HeapAccounting::Usage usage = HeapAccounting::getUsage(subsystem);
+      uint32_t value;
+
+      switch (static_cast<HeapSeries>(seriesIx)) {
+        case HeapSeries::CURRENT:
+          value = usage.currentBytes;
+          break;
+        case HeapSeries::PEAK:
+          value = usage.peakBytes;
+          break;
+        case HeapSeries::ALLOCATIONS:
+        default:
+          value = usage.allocations;
+          break;
+      }
+
+      p += sprintf(
+        p,
+        "%s{subsystem=\"%s\"} %u\n",
+        name,
+        HeapAccounting::subsystemToStr(subsystem),
+        static_cast<unsigned>(value)
+      );
+    }
+  }
+
+  ++heapLineIx;
+  pendingLen = p - pending;
+  pendingIx = 0;
+}
@@ -0,0 +1,42 @@
+#include <Histogram.h>
+#include <HeapAccounting.h>
+
+#ifndef _METRICS_WRITER_H
+#define _METRICS_WRITER_H
+
+// Serializes every registered histogram, followed by heap gauges, in the
+// Prometheus text format a line at a time, for use as a chunked response body.
+class MetricsWriter {
+public:
+  MetricsWriter();
+
+  // Writes up to maxLen bytes.  Returns 0 once everything has been written.
+  size_t fill(uint8_t* buffer, size_t maxLen);
+
+private:
+  static const size_t MAX_LINE_LENGTH = 320;
+
+  enum class Line { HEADER, BUCKET, SUM, COUNT };
+
+  Histogram* current;
+  const char* previousName;
+  Histogram::Snapshot snapshot;
+  Line line;
+  uint8_t bucketIx;
+  uint32_t cumulativeCount;
+
+  // Position within the heap gauges, which follow the histograms
+  uint8_t heapLineIx;
+  HeapAccounting::HeapInfo heapInfo;
+
+  char pending[MAX_LINE_LENGTH];
+  size_t pendingLen;
+  size_t pendingIx;
+
+  void refill();
+  void refillHeap();
+  bool heapDone() const;
+  size_t writeSeriesName(char* out, const char* suffix, const char* le);
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include <MotionPlanner.h>
+
+namespace {
+  template <size_t... Is>
+  struct IndexSequence { };
+
+  template <size_t N, size_t... Is>
+  struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, Is...> { };
+
+  template <size_t... Is>
+  struct MakeIndexSequence<0, Is...> {
+    typedef IndexSequence<Is...> type;
+  };
+
+  template <typename Seq>
+  struct DefaultRamp;
+
+  // Every element is a constant expression, so this is laid down in flash at
+  // compile time rather than computed at boot
+  template <size_t... Is>
+  struct DefaultRamp<IndexSequence<Is...>> {
+    static const uint16_t values[sizeof...(Is)];
+  };
+
+  template <size_t... Is>
+  const uint16_t DefaultRamp<IndexSequence<Is...>>::values[sizeof...(Is)] = {
+    MotionPlanner::rampInterval(
+      AccelerationProfile::TRAPEZOIDAL,
+      DEFAULT_START_MICROSECONDS_BETWEEN_STEPS,
+      DEFAULT_MICROSECONDS_BETWEEN_STEPS,
+      DEFAULT_ACCELERATION_STEPS,
+      Is
+    )...
+  };
+
+  typedef DefaultRamp<MakeIndexSequence<DEFAULT_ACCELERATION_STEPS>::type> DefaultTrapezoidalRamp;
+}
+
+MotionPlanner::MotionPlanner()
+  : profile(AccelerationProfile::TRAPEZOIDAL)
+  , startMicros(DEFAULT_START_MICROSECONDS_BETWEEN_STEPS)
+  , cruiseMicros(DEFAULT_MICROSECONDS_BETWEEN_STEPS)
+  , rampSteps(DEFAULT_ACCELERATION_STEPS)
+  , ramp(DefaultTrapezoidalRamp::values)
+{ }
+
+void MotionPlanner::configure(AccelerationProfile profile, uint16_t startMicros, uint16_t cruiseMicros, size_t rampSteps) {
+  // Nothing to ramp through if the motor can start at cruising speed
+  if (profile == AccelerationProfile::NONE || startMicros <= cruiseMicros) {
+    rampSteps = 0;
+  }
+  rampSteps = std::min(rampSteps, static_cast<size_t>(MOTION_PLANNER_MAX_RAMP_STEPS));
+
+  if (profile == this->profile
+    && startMicros == this->startMicros
+    && cruiseMicros == this->cruiseMicros
+    && rampSteps == this->rampSteps) {
+    return;
+  }
+
+  this->profile = profile;
+  this->startMicros = startMicros;
+  this->cruiseMicros = cruiseMicros;
+  this->rampSteps = rampSteps;
+
+  if (profile == AccelerationProfile::TRAPEZOIDAL
+    && startMicros == DEFAULT_START_MICROSECONDS_BETWEEN_STEPS
+    && cruiseMicros == DEFAULT_MICROSECONDS_BETWEEN_STEPS
+    && rampSteps == DEFAULT_ACCELERATION_STEPS) {
+    this->ramp = DefaultTrapezoidalRamp::values;
+    return;
+  }
+
+  for (size_t i = 0; i < rampSteps; ++i) {
+    runtimeRamp[i] = rampInterval(profile, startMicros, cruiseMicros, rampSteps, i);
+  }
+  this->ramp = runtimeRamp;
+}
+
+MotionPlanner::Move MotionPlanner::plan(size_t numSteps) const {
+  // Short moves never reach cruising speed.  Split them evenly between
+  // accelerating and decelerating, with any odd middle step taken at the
+  // speed the ramp had got to rather than at full speed.
+  const size_t rampLen = std::min(rampSteps, numSteps / 2);
+  const uint16_t peakMicros = rampLen < rampSteps ? ramp[rampLen] : cruiseMicros;
+
+  return Move(ramp, rampLen, peakMicros, numSteps);
+}
+
+MotionPlanner::Move::Move(const uint16_t* ramp, size_t rampLen, uint16_t peakMicros, size_t numSteps)
+  : ramp(ramp)
+  , rampLen(rampLen)
+  , peakMicros(peakMicros)
+  , numSteps(numSteps)
+{ }
+
+size_t MotionPlanner::Move::size() const {
+  return numSteps;
+}
+
+StepPulse MotionPlanner::Move::pulseAt(size_t ix) const {
+  uint16_t interval;
+
+  if (ix < rampLen) {
+    interval = ramp[ix];
+  } else if (ix >= numSteps - rampLen) {
+    interval = ramp[numSteps - 1 - ix];
+  } else {
+    interval = peakMicros;
+  }
+
+  return { interval, interval };
+}
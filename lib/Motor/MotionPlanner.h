@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <MotorTypes.h>
+#include <StepEngine.h>
+
+#ifndef MOTION_PLANNER_MAX_RAMP_STEPS
+#define MOTION_PLANNER_MAX_RAMP_STEPS 256
+#endif
+
+#ifndef _MOTION_PLANNER_H
+#define _MOTION_PLANNER_H
+
+// Turns a move into per-step intervals: accelerate from a speed the motor can
+// start at, cruise, then decelerate symmetrically.  Intervals are the time
+// between step edges, same as MotorSettings::microseconds_between_steps.
+class MotionPlanner {
+public:
+  // Intervals for one move, looked up per step rather than stored.  Only
+  // valid until the planner is reconfigured.
+  class Move : public PulseSource {
+  public:
+    // Steps between the ramps are taken at peakMicros
+    Move(const uint16_t* ramp, size_t rampLen, uint16_t peakMicros, size_t numSteps);
+
+    virtual size_t size() const;
+    virtual StepPulse pulseAt(size_t ix) const;
+
+  private:
+    const uint16_t* ramp;
+    size_t rampLen;
+    uint16_t peakMicros;
+    size_t numSteps;
+  };
+
+  MotionPlanner();
+
+  // Rebuilds the ramp table if any parameter changed.  The table for the
+  // default settings is computed at compile time.
+  void configure(AccelerationProfile profile, uint16_t startMicros, uint16_t cruiseMicros, size_t rampSteps);
+
+  Move plan(size_t numSteps) const;
+
+  // Interval for the ix-th step of a ramp with the given parameters
+  static constexpr uint16_t rampInterval(
+    AccelerationProfile profile,
+    uint16_t startMicros,
+    uint16_t cruiseMicros,
+    size_t rampSteps,
+    size_t ix
+  );
+
+private:
+  AccelerationProfile profile;
+  uint16_t startMicros;
+  uint16_t cruiseMicros;
+  size_t rampSteps;
+
+  // Either the precomputed default table or runtimeRamp
+  const uint16_t* ramp;
+  uint16_t runtimeRamp[MOTION_PLANNER_MAX_RAMP_STEPS];
+
+  static constexpr double sqrtNewton(double x, double guess, uint8_t iterations);
+  static constexpr double smoothstep(double t);
+};
+
+constexpr double MotionPlanner::sqrtNewton(double x, double guess, uint8_t iterations) {
+  return iterations == 0 ? guess : sqrtNewton(x, 0.5 * (guess + x / guess), iterations - 1);
+}
+
+constexpr double MotionPlanner::smoothstep(double t) {
+  return t * t * (3 - 2 * t);
+}
+
+constexpr uint16_t MotionPlanner::rampInterval(
+  AccelerationProfile profile,
+  uint16_t startMicros,
+  uint16_t cruiseMicros,
+  size_t rampSteps,
+  size_t ix
+) {
+  // Trapezoidal: constant acceleration, so v^2 grows linearly with distance
+  //   interval = s*c / sqrt((1-t)*c^2 + t*s^2)
+  // S-curve: velocity follows smoothstep(t), so jerk is bounded at both ends
+  //   interval = s*c / (c + (s-c)*smoothstep(t))
+  return profile == AccelerationProfile::TRAPEZOIDAL
+    ? static_cast<uint16_t>(
+        (static_cast<double>(startMicros) * cruiseMicros)
+          / sqrtNewton(
+              (1 - static_cast<double>(ix) / rampSteps) * cruiseMicros * cruiseMicros
+                + (static_cast<double>(ix) / rampSteps) * startMicros * startMicros,
+              startMicros,
+              20
+            )
+      )
+    : profile == AccelerationProfile::S_CURVE
+    ? static_cast<uint16_t>(
+        (static_cast<double>(startMicros) * cruiseMicros)
+          / (cruiseMicros + (static_cast<double>(startMicros) - cruiseMicros) * smoothstep(static_cast<double>(ix) / rampSteps))
+      )
+    : cruiseMicros;
+}
+
+#endif
@@ -4,10 +4,51 @@
 #include <MotorTypes.h>
 #include <CameraTypes.h>
 #include <ArduCAM.h>
+#include <StepEngine.h>
+#include <MotionPlanner.h>
+#include <Metrics.h>
+#include <Trace.h>
+#include <HeapAccounting.h>
+
+#if defined(ESP32)
+extern "C" {
+  #include "freertos/semphr.h"
+  #include "freertos/queue.h"
+}
+#endif
+
+// Commands waiting to run.  Further commands are rejected until one finishes.
+#ifndef MOTOR_JOB_QUEUE_SIZE
+#define MOTOR_JOB_QUEUE_SIZE 8
+#endif
+
+// Number of recent jobs whose status can be looked up
+#ifndef MOTOR_JOB_HISTORY_SIZE
+#define MOTOR_JOB_HISTORY_SIZE 16
+#endif
 
 #ifndef _MOTOR_CONTROLLER_H
 #define _MOTOR_CONTROLLER_H
 
+struct MotorCommand {
+  MotorCommandType type;
+
+  // Only used by SIMPLE commands
+  float numTurns;
+  MicrostepResolution resolution;
+  RotationDirection direction;
+};
+
+struct MotorJob {
+  uint32_t id;
+  MotorCommand command;
+  MotorJobState state;
+
+  uint32_t queuedAt;
+  uint32_t startedAt;
+  uint32_t finishedAt;
+};
+
 class MotorController {
 public:
   MotorController(Settings& settings);
@@ -15,7 +56,15 @@ public:
   void continuousTurn(float numTurns, MicrostepResolution speed, RotationDirection direction);
   void dispenseTurn();
 
-  bool jsonCommand(const JsonObject& command);
+  static bool parseCommand(const JsonObject& json, MotorCommand& command);
+
+  // Queues a command to run on the motor task.  Returns the job ID, or 0 if
+  // the queue is full.
+  uint32_t enqueue(const MotorCommand& command);
+
+  // Copies the job's current state into result.  Returns false if the job is
+  // unknown or has aged out of the history.
+  bool getJob(uint32_t id, MotorJob& result);
 
   void disable();
   void enable();
@@ -24,6 +73,19 @@ public:
 
 private:
   const Settings& settings;
+  StepEngine stepEngine;
+  MotionPlanner planner;
+
+  MotorJob jobs[MOTOR_JOB_HISTORY_SIZE];
+  uint32_t nextJobId;
+
+  TaskHandle_t jobTask;
+  QueueHandle_t jobQueue;
+  SemaphoreHandle_t jobsMtx;
+
+  static void runJobs(void*);
+  void runJobs();
+  void execute(const MotorCommand& command);
 };
 
 #endif
\ No newline at end of file
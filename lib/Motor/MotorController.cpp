@@ -1,8 +1,18 @@
-#include <vector>
 #include <MotorControler.h>
 
+static inline void setPins(uint8_t (&values)[3], uint8_t ms1, uint8_t ms2, uint8_t ms3) {
+  values[0] = ms1;
+  values[1] = ms2;
+  values[2] = ms3;
+}
+
 MotorController::MotorController(Settings& settings)
   : settings(settings)
+  , jobs()
+  , nextJobId(1)
+  , jobTask(NULL)
+  , jobQueue(xQueueCreate(MOTOR_JOB_QUEUE_SIZE, sizeof(uint32_t)))
+  , jobsMtx(xSemaphoreCreateMutex())
 { }
 
 void MotorController::continuousTurn(float numTurns, MicrostepResolution resolution, RotationDirection direction) {
@@ -12,28 +22,28 @@ void MotorController::continuousTurn(float numTurns, MicrostepResolution resolut
 
   digitalWrite(settings.motor.a4988.dir_pin, static_cast<uint8_t>(direction));
 
-  std::vector<uint8_t> speedPinValues;
+  uint8_t speedPinValues[3];
 
   switch (resolution) {
     case MicrostepResolution::HALF:
-      speedPinValues = {HIGH, LOW, LOW};
+      setPins(speedPinValues, HIGH, LOW, LOW);
       break;
       
     case MicrostepResolution::QUARTER:
-      speedPinValues = {LOW, HIGH, LOW};
+      setPins(speedPinValues, LOW, HIGH, LOW);
       break;
       
     case MicrostepResolution::EIGHTH:
-      speedPinValues = {HIGH, HIGH, LOW};
+      setPins(speedPinValues, HIGH, HIGH, LOW);
       break;
       
     case MicrostepResolution::SIXTEENTH:
-      speedPinValues = {HIGH, HIGH, HIGH};
+      setPins(speedPinValues, HIGH, HIGH, HIGH);
       break;
 
     case MicrostepResolution::FULL:
     default:
-      speedPinValues = {LOW, LOW, LOW};
+      setPins(speedPinValues, LOW, LOW, LOW);
       break;
   }
 
@@ -45,12 +55,14 @@ void MotorController::continuousTurn(float numTurns, MicrostepResolution resolut
 
   Serial.printf("Steping %d times...\n", numSteps);
 
-  for (size_t i = 0; i < numSteps; ++i) {
-    digitalWrite(settings.motor.a4988.step_pin, LOW);
-    delayMicroseconds(settings.motor.microseconds_between_steps);
-    digitalWrite(settings.motor.a4988.step_pin, HIGH);
-    delayMicroseconds(settings.motor.microseconds_between_steps);
-  }
+  planner.configure(
+    settings.motor.acceleration_profile,
+    settings.motor.start_microseconds_between_steps,
+    settings.motor.microseconds_between_steps,
+    settings.motor.acceleration_steps
+  );
+
+  stepEngine.run(planner.plan(numSteps));
 
   if (settings.motor.auto_enable) {
     disable();
@@ -65,7 +77,18 @@ void MotorController::init() {
   pinMode(settings.motor.a4988.ms3_pin, OUTPUT);
   pinMode(settings.motor.a4988.step_pin, OUTPUT);
 
+  stepEngine.init(settings.motor.a4988.step_pin);
+
   digitalWrite(settings.motor.a4988.en_pin, HIGH);
+
+  xTaskCreate(
+    &MotorController::runJobs,
+    "MotorJobs",
+    4096,
+    (void*)(this),
+    1,
+    &jobTask
+  );
 }
 
 void MotorController::disable() {
@@ -90,38 +113,141 @@ void MotorController::dispenseTurn() {
   continuousTurn(settings.motor.num_turns, settings.motor.microstep_resolution, settings.motor.rotation_direction);
 }
 
-bool MotorController::jsonCommand(const JsonObject& command) {
-  if (! command.containsKey("type")) {
+bool MotorController::parseCommand(const JsonObject& json, MotorCommand& command) {
+  if (! json.containsKey("type")) {
     return false;
   }
 
-  const String& type = command["type"];
+  const String& type = json["type"];
 
   if (type.equalsIgnoreCase("simple")) {
-    const JsonObject& args = command["args"];
+    const JsonObject& args = json["args"];
 
-    const RotationDirection dir = MotorTypes::rotationDirectionFromStr(args["direction"]);
-    const MicrostepResolution resolution = MotorTypes::microstepResolutionFromStr(args["resolution"]);
-    const float numTurns = args["num_turns"];
-
-    Serial.printf("Executing command: %d, %d, %f\n", static_cast<uint8_t>(dir), static_cast<uint8_t>(resolution), numTurns);
-
-    continuousTurn(numTurns, resolution, dir);
-
-    return true;
+    command.type = MotorCommandType::SIMPLE;
+    command.direction = MotorTypes::rotationDirectionFromStr(args["direction"]);
+    command.resolution = MotorTypes::microstepResolutionFromStr(args["resolution"]);
+    command.numTurns = args["num_turns"];
   } else if (type.equalsIgnoreCase("saved")) {
-    continuousTurn(settings.motor.num_turns, settings.motor.microstep_resolution, settings.motor.rotation_direction);
-    return true;
+    command.type = MotorCommandType::SAVED;
   } else if (type.equalsIgnoreCase("dispense")) {
-    dispenseTurn();
-    return true;
+    command.type = MotorCommandType::DISPENSE;
   } else if (type.equalsIgnoreCase("disable")) {
-    disable();
-    return true;
+    command.type = MotorCommandType::DISABLE;
   } else if (type.equalsIgnoreCase("enable")) {
-    enable();
-    return true;
+    command.type = MotorCommandType::ENABLE;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+uint32_t MotorController::enqueue(const MotorCommand& command) {
+  uint32_t id = 0;
+
+  Trace::begin("take_jobs_mtx");
+  xSemaphoreTake(jobsMtx, portMAX_DELAY);
+  Trace::end("take_jobs_mtx");
+
+  // Don't recycle a history slot whose job hasn't finished yet
+  MotorJob& job = jobs[nextJobId % MOTOR_JOB_HISTORY_SIZE];
+
+  // The motor task picks the job up from its slot only after taking the lock,
+  // so it's safe to fill the slot in after queueing its ID.
+  if ((job.id == 0 || job.state == MotorJobState::DONE) && xQueueSend(jobQueue, &nextJobId, 0) == pdTRUE) {
+    id = nextJobId++;
+
+    job.id = id;
+    job.command = command;
+    job.state = MotorJobState::QUEUED;
+    job.queuedAt = millis();
+    job.startedAt = 0;
+    job.finishedAt = 0;
+  }
+
+  xSemaphoreGive(jobsMtx);
+  Trace::instant("motor_enqueue", id);
+
+  return id;
+}
+
+bool MotorController::getJob(uint32_t id, MotorJob& result) {
+  bool found = false;
+
+  xSemaphoreTake(jobsMtx, portMAX_DELAY);
+
+  const MotorJob& job = jobs[id % MOTOR_JOB_HISTORY_SIZE];
+  if (id != 0 && job.id == id) {
+    result = job;
+    found = true;
+  }
+
+  xSemaphoreGive(jobsMtx);
+
+  return found;
+}
+
+void MotorController::runJobs(void* _this) {
+  static_cast<MotorController*>(_this)->runJobs();
+}
+
+void MotorController::runJobs() {
+  uint32_t id;
+
+  HeapAccounting::registerTask(HeapAccounting::Subsystem::MOTOR);
+
+  while (true) {
+    if (xQueueReceive(jobQueue, &id, portMAX_DELAY) == pdTRUE) {
+      Trace::instant("motor_job_received", id);
+      MotorJob& job = jobs[id % MOTOR_JOB_HISTORY_SIZE];
+
+      // The slot can't be reused until the job is done, so the command is
+      // stable without holding the lock while the motor turns
+      xSemaphoreTake(jobsMtx, portMAX_DELAY);
+      job.state = MotorJobState::RUNNING;
+      job.startedAt = millis();
+      xSemaphoreGive(jobsMtx);
+
+      {
+        Histogram::Timer timer(Metrics::motorCommand);
+        Trace::Scope trace("motor_job", id);
+        execute(job.command);
+      }
+
+      xSemaphoreTake(jobsMtx, portMAX_DELAY);
+      job.state = MotorJobState::DONE;
+      job.finishedAt = millis();
+      xSemaphoreGive(jobsMtx);
+    }
   }
+}
 
-  return false;
-}
\ No newline at end of file
+void MotorController::execute(const MotorCommand& command) {
+  switch (command.type) {
+    case MotorCommandType::SIMPLE:
+      Serial.printf(
+        "Executing command: %d, %d, %f\n",
+        static_cast<uint8_t>(command.direction),
+        static_cast<uint8_t>(command.resolution),
+        command.numTurns
+      );
+      continuousTurn(command.numTurns, command.resolution, command.direction);
+      break;
+
+    case MotorCommandType::SAVED:
+      continuousTurn(settings.motor.num_turns, settings.motor.microstep_resolution, settings.motor.rotation_direction);
+      break;
+
+    case MotorCommandType::DISPENSE:
+      dispenseTurn();
+      break;
+
+    case MotorCommandType::DISABLE:
+      disable();
+      break;
+
+    case MotorCommandType::ENABLE:
+      enable();
+      break;
+  }
+}
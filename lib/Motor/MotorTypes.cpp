@@ -36,4 +36,47 @@ String MotorTypes::rotationDirectionToStr(const RotationDirection dir) {
 RotationDirection MotorTypes::rotationDirectionFromStr(const String& str) {
   if (str.equalsIgnoreCase("CLOCKWISE")) return RotationDirection::CLOCKWISE;
   else return RotationDirection::COUNTERCLOCKWISE;
+}
+
+String MotorTypes::accelerationProfileToStr(const AccelerationProfile profile) {
+  switch (profile) {
+    case AccelerationProfile::TRAPEZOIDAL:
+      return "TRAPEZOIDAL";
+    case AccelerationProfile::S_CURVE:
+      return "S_CURVE";
+    default:
+      return "NONE";
+  }
+}
+
+AccelerationProfile MotorTypes::accelerationProfileFromStr(const String& str) {
+  if (str.equalsIgnoreCase("TRAPEZOIDAL")) return AccelerationProfile::TRAPEZOIDAL;
+  else if (str.equalsIgnoreCase("S_CURVE")) return AccelerationProfile::S_CURVE;
+  else return AccelerationProfile::NONE;
+}
+
+String MotorTypes::motorCommandTypeToStr(const MotorCommandType type) {
+  switch (type) {
+    case MotorCommandType::SIMPLE:
+      return "simple";
+    case MotorCommandType::SAVED:
+      return "saved";
+    case MotorCommandType::DISPENSE:
+      return "dispense";
+    case MotorCommandType::DISABLE:
+      return "disable";
+    default:
+      return "enable";
+  }
+}
+
+String MotorTypes::motorJobStateToStr(const MotorJobState state) {
+  switch (state) {
+    case MotorJobState::QUEUED:
+      return "queued";
+    case MotorJobState::RUNNING:
+      return "running";
+    default:
+      return "done";
+  }
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #ifndef _MOTOR_TYPES_H
 #define _MOTOR_TYPES_H
 
+// Shared by MotorSettings and the precomputed acceleration ramp in MotionPlanner
+#define DEFAULT_MICROSECONDS_BETWEEN_STEPS 800
+#define DEFAULT_START_MICROSECONDS_BETWEEN_STEPS 2000
+#define DEFAULT_ACCELERATION_STEPS 64
+
 enum class MicrostepResolution {
   FULL = 1, HALF = 2, QUARTER = 4, EIGHTH = 8, SIXTEENTH = 16
 };
@@ -9,6 +14,18 @@ enum class RotationDirection {
   CLOCKWISE, COUNTERCLOCKWISE
 };
 
+enum class AccelerationProfile {
+  NONE, TRAPEZOIDAL, S_CURVE
+};
+
+enum class MotorCommandType {
+  SIMPLE, SAVED, DISPENSE, DISABLE, ENABLE
+};
+
+enum class MotorJobState {
+  QUEUED, RUNNING, DONE
+};
+
 class MotorTypes {
 public:
   static String microstepResolutionToStr(const MicrostepResolution resolution);
@@ -16,6 +33,12 @@ public:
 
   static String rotationDirectionToStr(const RotationDirection dir);
   static RotationDirection rotationDirectionFromStr(const String& str);
+
+  static String accelerationProfileToStr(const AccelerationProfile profile);
+  static AccelerationProfile accelerationProfileFromStr(const String& str);
+
+  static String motorCommandTypeToStr(const MotorCommandType type);
+  static String motorJobStateToStr(const MotorJobState state);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include <StepEngine.h>
+
+const uint16_t StepEngine::MAX_LEVEL_MICROS;
+
+StepEngine::StepEngine()
+  : stepPin(0)
+{ }
+
+void StepEngine::init(uint8_t stepPin) {
+  this->stepPin = stepPin;
+
+#if defined(ESP32)
+  rmt_config_t config;
+  memset(&config, 0, sizeof(config));
+
+  config.rmt_mode = RMT_MODE_TX;
+  config.channel = STEP_ENGINE_RMT_CHANNEL;
+  config.gpio_num = static_cast<gpio_num_t>(stepPin);
+  config.mem_block_num = 1;
+  // 80 MHz APB clock / 80 = 1 tick per microsecond
+  config.clk_div = 80;
+  config.tx_config.loop_en = false;
+  config.tx_config.carrier_en = false;
+  config.tx_config.idle_output_en = true;
+  config.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+
+  rmt_config(&config);
+  rmt_driver_install(config.channel, 0, 0);
+#else
+  pinMode(stepPin, OUTPUT);
+#endif
+}
+
+StepPulse StepEngine::clamp(StepPulse pulse) {
+  // A zero duration would terminate the RMT sequence early
+  pulse.highMicros = std::max<uint16_t>(1, std::min(pulse.highMicros, MAX_LEVEL_MICROS));
+  pulse.lowMicros = std::max<uint16_t>(1, std::min(pulse.lowMicros, MAX_LEVEL_MICROS));
+  return pulse;
+}
+
+#if defined(ESP32)
+size_t StepEngine::fillChunk(rmt_item32_t* chunk, const PulseSource& source, size_t from) {
+  const size_t count = std::min(source.size() - from, static_cast<size_t>(STEP_ENGINE_CHUNK_PULSES));
+
+  for (size_t i = 0; i < count; ++i) {
+    const StepPulse pulse = clamp(source.pulseAt(from + i));
+
+    chunk[i].level0 = 1;
+    chunk[i].duration0 = pulse.highMicros;
+    chunk[i].level1 = 0;
+    chunk[i].duration1 = pulse.lowMicros;
+  }
+
+  return count;
+}
+#endif
+
+void StepEngine::run(const PulseSource& source) {
+  const size_t numPulses = source.size();
+
+  if (numPulses == 0) {
+    return;
+  }
+
+#if defined(ESP32)
+  // The driver copies from a written chunk in its ISR until the transmission
+  // finishes, so a chunk can't be refilled until then.  rmt_write_items waits
+  // for the previous transmission before starting the next, so filling one
+  // chunk while the other goes out keeps at most one in flight.  The step pin
+  // idles low between writes, which only stretches a low period slightly.
+  size_t sent = 0;
+  uint8_t current = 0;
+
+  while (sent < numPulses) {
+    const size_t count = fillChunk(chunks[current], source, sent);
+
+    rmt_write_items(STEP_ENGINE_RMT_CHANNEL, chunks[current], count, false);
+
+    sent += count;
+    current ^= 1;
+  }
+
+  rmt_wait_tx_done(STEP_ENGINE_RMT_CHANNEL, portMAX_DELAY);
+#else
+  for (size_t i = 0; i < numPulses; ++i) {
+    const StepPulse pulse = clamp(source.pulseAt(i));
+
+    digitalWrite(stepPin, HIGH);
+    delayMicroseconds(pulse.highMicros);
+    digitalWrite(stepPin, LOW);
+    delayMicroseconds(pulse.lowMicros);
+  }
+#endif
+}
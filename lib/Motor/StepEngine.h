@@ -0,0 +1,63 @@
+#include <Arduino.h>
+
+#if defined(ESP32)
+#include <driver/rmt.h>
+#endif
+
+#ifndef STEP_ENGINE_RMT_CHANNEL
+#define STEP_ENGINE_RMT_CHANNEL RMT_CHANNEL_0
+#endif
+
+// Pulses per RMT write.  Two chunks are buffered, so this bounds memory use
+// regardless of move length.  Larger chunks mean fewer gaps between writes.
+#ifndef STEP_ENGINE_CHUNK_PULSES
+#define STEP_ENGINE_CHUNK_PULSES 256
+#endif
+
+#ifndef _STEP_ENGINE_H
+#define _STEP_ENGINE_H
+
+struct StepPulse {
+  uint16_t highMicros;
+  uint16_t lowMicros;
+};
+
+// A move, as a sequence of pulses computed on demand
+class PulseSource {
+public:
+  virtual ~PulseSource() { }
+
+  virtual size_t size() const = 0;
+  virtual StepPulse pulseAt(size_t ix) const = 0;
+};
+
+// Generates step pulses for a PulseSource.  On the ESP32 the RMT peripheral
+// clocks them out, so timing isn't affected by interrupts and the CPU is free
+// while the motor turns.  Elsewhere it falls back to timed digitalWrites.
+class StepEngine {
+public:
+  // Longest a single level can be held (RMT duration fields are 15 bits)
+  static const uint16_t MAX_LEVEL_MICROS = 32767;
+
+  StepEngine();
+
+  void init(uint8_t stepPin);
+
+  // Emits every pulse in the source.  Blocks the calling task until the last
+  // one has gone out.
+  void run(const PulseSource& source);
+
+private:
+  uint8_t stepPin;
+
+#if defined(ESP32)
+  // One chunk is filled while the other is being sent
+  rmt_item32_t chunks[2][STEP_ENGINE_CHUNK_PULSES];
+
+  size_t fillChunk(rmt_item32_t* chunk, const PulseSource& source, size_t from);
+#endif
+
+  static StepPulse clamp(StepPulse pulse);
+};
+
+#endif
@@ -47,6 +47,67 @@ public:
       camera_resolutionString = CameraTypes::cameraResolutionToStr(camera_resolution);
     }
   );
+
+  // Frame rate MJPEG streams aim for.  0 means as fast as the client can take them.
+  persistentIntVar(target_fps, 10);
+
+  // Snapshots reuse the most recent frame if it's at most this old (in ms).
+  // 0 always captures a new one.
+  persistentIntVar(snapshot_max_age, 500);
+
+  // Start exposing the next frame as soon as the last one has been read out of
+  // the FIFO, so it's ready by the time anyone asks for it
+  persistentVar(
+    bool,
+    pipelined_capture,
+    true,
+    {
+      pipelined_capture = pipelined_captureString.equalsIgnoreCase("true");
+    },
+    {
+      pipelined_captureString = pipelined_capture ? "true" : "false";
+    }
+  );
+};
+
+class MotionSettings : public Configuration {
+public:
+  persistentVar(
+    bool,
+    enabled,
+    false,
+    {
+      enabled = enabledString.equalsIgnoreCase("true");
+    },
+    {
+      enabledString = enabled ? "true" : "false";
+    }
+  );
+
+  // Frames are captured at least this often (ms) while detection is enabled,
+  // whether or not anyone is streaming
+  persistentIntVar(interval_ms, 1000);
+
+  // A cell has changed if its brightness differs from the background by more
+  // than threshold (0-127).  Motion is reported once min_cells have changed.
+  persistentIntVar(threshold, 8);
+  persistentIntVar(min_cells, 4);
+  // The background moves 1/2^background_shift of the way toward each frame
+  persistentIntVar(background_shift, 3);
+
+  // Minimum time (ms) between motion events
+  persistentIntVar(cooldown_ms, 10000);
+  persistentVar(
+    MotionAction,
+    action,
+    MotionAction::NONE,
+    {
+      action = CameraTypes::motionActionFromStr(actionString);
+    },
+    {
+      actionString = CameraTypes::motionActionToStr(action);
+    }
+  );
 };
 
 class HttpSettings : public Configuration {
@@ -65,7 +126,7 @@ public:
   subconfig(A4988Settings, a4988);
 
   persistentIntVar(num_microsteps, 200);
-  persistentIntVar(microseconds_between_steps, 800);
+  persistentIntVar(microseconds_between_steps, DEFAULT_MICROSECONDS_BETWEEN_STEPS);
   persistentFloatVar(num_turns, 0.6);
 
   persistentIntVar(dispense_jitter_count, 10);
@@ -119,20 +180,57 @@ public:
     {
       jitter_microstep_resolutionString = MotorTypes::microstepResolutionToStr(jitter_microstep_resolution);
     }
-  )
+  );
+
+  // Moves ramp from start_microseconds_between_steps up to
+  // microseconds_between_steps over acceleration_steps steps, and back down
+  // again at the end.
+  persistentVar(
+    AccelerationProfile,
+    acceleration_profile,
+    AccelerationProfile::TRAPEZOIDAL,
+    {
+      acceleration_profile = MotorTypes::accelerationProfileFromStr(acceleration_profileString);
+    },
+    {
+      acceleration_profileString = MotorTypes::accelerationProfileToStr(acceleration_profile);
+    }
+  );
+  persistentIntVar(start_microseconds_between_steps, DEFAULT_START_MICROSECONDS_BETWEEN_STEPS);
+  persistentIntVar(acceleration_steps, DEFAULT_ACCELERATION_STEPS);
 };
 
 class AudioSettings : public Configuration {
 public:
   persistentIntVar(enable_pin, 16);
+
+  // Decoding runs in its own task.  Changes take effect after a reboot.
+  persistentIntVar(task_core, 1);
+  persistentIntVar(task_priority, 2);
+  // Same as AudioOutputI2S's default.  Fewer buffers leave less slack for the
+  // decoder when another task holds the core or SPIFFS is slow.
+  persistentIntVar(dma_buffer_count, 8);
+  // Transcoded sounds are downsampled to at most this rate (Hz).  IMA-ADPCM
+  // is 4 bits per sample, so 16 kHz is 8 KB/s, half a 128 kbps MP3.
+  persistentIntVar(transcode_sample_rate, 16000);
+};
+
+class StorageSettings : public Configuration {
+public:
+  // How long to wait after a settings change for more before writing to flash
+  persistentIntVar(flush_delay_ms, 2000);
+  // Journal size (bytes) at which pending changes are folded into the full configuration
+  persistentIntVar(max_journal_size, 4096);
 };
 
 class Settings : public RootConfiguration {
 public:
   subconfig(MotorSettings, motor);
   subconfig(ArduCamSettings, arducam);
+  subconfig(MotionSettings, motion);
   subconfig(HttpSettings, http);
   subconfig(AudioSettings, audio);
+  subconfig(StorageSettings, storage);
 };
 
 #endif
\ No newline at end of file
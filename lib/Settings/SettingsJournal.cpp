@@ -0,0 +1,186 @@
+#include <SettingsJournal.h>
+
+#if defined(ESP32)
+#include <esp_system.h>
+#endif
+
+SettingsJournal* SettingsJournal::instance = NULL;
+
+SettingsJournal::SettingsJournal(Settings& settings)
+  : settings(settings)
+  , lastUpdateAt(0)
+  , mutex(xSemaphoreCreateMutex())
+{ }
+
+void SettingsJournal::init() {
+  replay();
+
+  // Don't lose pending changes to a reboot (including the one after an OTA)
+  instance = this;
+  esp_register_shutdown_handler(&SettingsJournal::flushOnShutdown);
+}
+
+void SettingsJournal::flushOnShutdown() {
+  if (instance != NULL) {
+    instance->flush();
+  }
+}
+
+void SettingsJournal::update(const ConfigurationDictionary& changes) {
+  settings.setFromDictionary(changes);
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+
+  for (ConfigurationDictionary::const_iterator it = changes.begin(); it != changes.end(); ++it) {
+    dirty[it->first] = it->second;
+  }
+  lastUpdateAt = millis();
+
+  xSemaphoreGive(mutex);
+}
+
+void SettingsJournal::loop() {
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  const bool due = ! dirty.empty() && (millis() - lastUpdateAt) >= static_cast<uint32_t>(settings.storage.flush_delay_ms);
+  xSemaphoreGive(mutex);
+
+  if (due) {
+    flush();
+  }
+}
+
+void SettingsJournal::flush() {
+  Trace::Scope trace("settings_flush");
+  ConfigurationDictionary toWrite;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  toWrite.swap(dirty);
+  xSemaphoreGive(mutex);
+
+  if (toWrite.empty()) {
+    return;
+  }
+
+  File journal = SPIFFS.open(SETTINGS_JOURNAL_FILE, FILE_APPEND);
+
+  if (! journal) {
+    Serial.println(F("Failed to open settings journal.  Persisting everything instead."));
+    compact();
+    return;
+  }
+
+  bool written = true;
+  bool tooLarge = false;
+
+  for (ConfigurationDictionary::const_iterator it = toWrite.begin(); written && it != toWrite.end(); ++it) {
+    const String& key = it->first;
+    const String& value = it->second;
+
+    // Doesn't fit a record.  Goes out with the full persist below.
+    if (key.length() > 0xFF || value.length() > 0xFFFF) {
+      tooLarge = true;
+      continue;
+    }
+
+    uint8_t header[3] = {
+      static_cast<uint8_t>(key.length()),
+      static_cast<uint8_t>(value.length()),
+      static_cast<uint8_t>(value.length() >> 8)
+    };
+
+    written = journal.write(header, 1) == 1
+      && journal.write(reinterpret_cast<const uint8_t*>(key.c_str()), key.length()) == key.length()
+      && journal.write(header + 1, 2) == 2
+      && journal.write(reinterpret_cast<const uint8_t*>(value.c_str()), value.length()) == value.length();
+  }
+
+  const size_t journalSize = journal.size();
+  journal.close();
+
+  // A short write leaves a partial record that would end the next replay
+  // early, hiding anything appended after it.  Settings already hold every
+  // change, so persist them all and start a fresh journal.
+  if (! written) {
+    Serial.println(F("Failed to write settings journal.  Persisting everything instead."));
+    compact();
+  } else if (tooLarge) {
+    Serial.println(F("Setting too large for the settings journal.  Persisting everything instead."));
+    compact();
+  } else if (journalSize > static_cast<size_t>(settings.storage.max_journal_size)) {
+    compact();
+  }
+}
+
+void SettingsJournal::replay() {
+  File journal = SPIFFS.open(SETTINGS_JOURNAL_FILE, FILE_READ);
+
+  if (! journal) {
+    return;
+  }
+
+  ConfigurationDictionary entries;
+  char buffer[256];
+  bool torn = false;
+
+  while (journal.available()) {
+    // Anything that stops short of a whole record
+    torn = true;
+
+    uint8_t keyLen;
+    uint8_t valueLenBytes[2];
+
+    if (journal.read(&keyLen, 1) != 1 || journal.read(reinterpret_cast<uint8_t*>(buffer), keyLen) != keyLen) {
+      break;
+    }
+    buffer[keyLen] = 0;
+    String key = buffer;
+
+    if (journal.read(valueLenBytes, 2) != 2) {
+      break;
+    }
+
+    const size_t valueLen = valueLenBytes[0] | (valueLenBytes[1] << 8);
+    String value;
+    value.reserve(valueLen);
+
+    size_t remaining = valueLen;
+    while (remaining > 0) {
+      const size_t toRead = std::min(remaining, sizeof(buffer) - 1);
+
+      if (journal.read(reinterpret_cast<uint8_t*>(buffer), toRead) != toRead) {
+        break;
+      }
+
+      buffer[toRead] = 0;
+      value += buffer;
+      remaining -= toRead;
+    }
+
+    // A record cut short by a reset mid-write.  Everything before it is good.
+    if (remaining > 0) {
+      break;
+    }
+
+    entries[key] = value;
+    torn = false;
+  }
+
+  journal.close();
+
+  if (! entries.empty()) {
+    Serial.printf("Replaying %u settings from journal\n", static_cast<unsigned>(entries.size()));
+    settings.setFromDictionary(entries);
+  }
+
+  // Records appended after the torn one would never be read.  Fold what was
+  // replayed into the stored configuration and start over.
+  if (torn) {
+    Serial.println(F("Settings journal ends in a partial record.  Compacting."));
+    compact();
+  }
+}
+
+void SettingsJournal::compact() {
+  Bleeper.storage.persist();
+  SPIFFS.remove(SETTINGS_JOURNAL_FILE);
+}
@@ -0,0 +1,56 @@
+#include <Settings.h>
+#include <Trace.h>
+
+#if defined(ESP32)
+#include <SPIFFS.h>
+extern "C" {
+  #include "freertos/semphr.h"
+}
+#endif
+
+#ifndef SETTINGS_JOURNAL_FILE
+#define SETTINGS_JOURNAL_FILE "/settings.journal"
+#endif
+
+#ifndef _SETTINGS_JOURNAL_H
+#define _SETTINGS_JOURNAL_H
+
+// Persists settings changes without rewriting the whole configuration each
+// time.  Changed keys are collected for storage.flush_delay_ms after the
+// last update, then appended to a journal file as key/value records.  The
+// journal is replayed over Bleeper's stored configuration at boot, and folded
+// back into it (one full persist) once it grows past
+// storage.max_journal_size.
+//
+// Journal records are [u8 key length][key][u16 value length, LE][value].
+class SettingsJournal {
+public:
+  SettingsJournal(Settings& settings);
+
+  // Replays the journal.  Call after Bleeper has loaded settings.
+  void init();
+
+  // Applies changes to settings immediately and schedules them to be written
+  void update(const ConfigurationDictionary& changes);
+
+  // Writes pending changes once the debounce window has passed
+  void loop();
+
+  // Writes pending changes now
+  void flush();
+
+private:
+  Settings& settings;
+  ConfigurationDictionary dirty;
+  uint32_t lastUpdateAt;
+
+  SemaphoreHandle_t mutex;
+
+  static SettingsJournal* instance;
+  static void flushOnShutdown();
+
+  void replay();
+  void compact();
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include <Trace.h>
+
+namespace Trace {
+  static Event ring[TRACE_RING_SIZE];
+  static std::atomic<uint32_t> writeSequence(0);
+
+  void record(Phase phase, const char* name, uint32_t arg) {
+    const uint32_t sequence = writeSequence.fetch_add(1, std::memory_order_relaxed);
+    Event& event = ring[sequence % TRACE_RING_SIZE];
+
+    // Marks the slot as in progress.  The fence keeps the writes below from
+    // becoming visible before the mark does.
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event.timestamp = micros();
+    event.name = name;
+    event.task = xTaskGetCurrentTaskHandle();
+    event.arg = arg;
+    event.phase = phase;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    event.sequence.store(sequence + 1, std::memory_order_relaxed);
+  }
+
+  Scope::Scope(const char* name, uint32_t arg)
+    : name(name)
+  {
+    begin(name, arg);
+  }
+
+  Scope::~Scope() {
+    end(name);
+  }
+
+  uint32_t nextSequence() {
+    return writeSequence.load(std::memory_order_relaxed);
+  }
+
+  bool read(uint32_t sequence, Event& event) {
+    const Event& slot = ring[sequence % TRACE_RING_SIZE];
+
+    if (slot.sequence.load(std::memory_order_acquire) != sequence + 1) {
+      return false;
+    }
+
+    event.timestamp = slot.timestamp;
+    event.name = slot.name;
+    event.task = slot.task;
+    event.arg = slot.arg;
+    event.phase = slot.phase;
+
+    // Overwritten while being copied.  The fence keeps the copy above from
+    // being read after the check.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == sequence + 1;
+  }
+};
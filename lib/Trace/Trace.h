@@ -0,0 +1,76 @@
+#include <Arduino.h>
+#include <atomic>
+
+#if defined(ESP32)
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+}
+#endif
+
+// Number of events kept.  Each takes 20 bytes.
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 512
+#endif
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+// Fixed-size ring of timestamped events, shared by every task.  Recording
+// claims a slot with a single atomic increment and never blocks, so trace
+// points can stay in place in production.  Once the ring wraps, the oldest
+// events are overwritten.
+//
+// Event names must be string literals (only the pointer is stored).
+namespace Trace {
+  enum class Phase : char {
+    BEGIN = 'B',
+    END = 'E',
+    INSTANT = 'i'
+  };
+
+  struct Event {
+    // Set to the slot's sequence number + 1 once the event is fully written,
+    // so readers can tell a finished event from one being overwritten
+    std::atomic<uint32_t> sequence;
+    uint32_t timestamp;
+    const char* name;
+    TaskHandle_t task;
+    uint32_t arg;
+    Phase phase;
+  };
+
+  void record(Phase phase, const char* name, uint32_t arg = 0);
+
+  inline void begin(const char* name, uint32_t arg = 0) {
+    record(Phase::BEGIN, name, arg);
+  }
+
+  inline void end(const char* name, uint32_t arg = 0) {
+    record(Phase::END, name, arg);
+  }
+
+  inline void instant(const char* name, uint32_t arg = 0) {
+    record(Phase::INSTANT, name, arg);
+  }
+
+  // Begin/end pair around a scope
+  class Scope {
+  public:
+    Scope(const char* name, uint32_t arg = 0);
+    ~Scope();
+
+  private:
+    const char* name;
+  };
+
+  // Sequence number the next event will get.  Events from
+  // max(0, next - TRACE_RING_SIZE) onward may still be in the ring.
+  uint32_t nextSequence();
+
+  // Copies the event with the given sequence number.  Returns false if it's
+  // been overwritten or isn't finished.
+  bool read(uint32_t sequence, Event& event);
+};
+
+#endif
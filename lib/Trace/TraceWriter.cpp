@@ -0,0 +1,130 @@
+#include <TraceWriter.h>
+
+// Writes s as a quoted JSON string, truncated to fit in maxLen bytes.
+// Returns the number of bytes written.
+static size_t writeJsonString(char* out, const char* s, size_t maxLen) {
+  char* p = out;
+
+  *p++ = '"';
+
+  for (; *s && (p - out) < static_cast<int>(maxLen) - 3; ++s) {
+    if (*s == '"' || *s == '\\') {
+      *p++ = '\\';
+    }
+    *p++ = *s < 0x20 ? ' ' : *s;
+  }
+
+  *p++ = '"';
+
+  return p - out;
+}
+
+TraceWriter::TraceWriter()
+  : endSequence(Trace::nextSequence())
+  , numNamedTasks(0)
+  , started(false)
+  , finished(false)
+  , first(true)
+  , pendingLen(0)
+  , pendingIx(0)
+{
+  sequence = endSequence > TRACE_RING_SIZE ? endSequence - TRACE_RING_SIZE : 0;
+}
+
+size_t TraceWriter::fill(uint8_t* buffer, size_t maxLen) {
+  size_t written = 0;
+
+  while (written < maxLen) {
+    if (pendingIx < pendingLen) {
+      const size_t toCopy = std::min(maxLen - written, pendingLen - pendingIx);
+
+      memcpy(buffer + written, pending + pendingIx, toCopy);
+      written += toCopy;
+      pendingIx += toCopy;
+    } else if (finished) {
+      break;
+    } else {
+      refill();
+    }
+  }
+
+  return written;
+}
+
+size_t TraceWriter::writeEventStart(char* out) {
+  char* p = out;
+
+  if (! first) {
+    *p++ = ',';
+  }
+  first = false;
+
+  return p - out;
+}
+
+void TraceWriter::refill() {
+  char* p = pending;
+
+  pendingIx = 0;
+  pendingLen = 0;
+
+  if (! started) {
+    p += sprintf(p, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    started = true;
+    pendingLen = p - pending;
+    return;
+  }
+
+  Trace::Event event;
+
+  // Skip anything overwritten since the writer was created
+  while (sequence < endSequence && ! Trace::read(sequence, event)) {
+    ++sequence;
+  }
+
+  if (sequence >= endSequence) {
+    p += sprintf(p, "]}");
+    finished = true;
+    pendingLen = p - pending;
+    return;
+  }
+
+  ++sequence;
+
+  const uint32_t tid = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(event.task));
+
+  // Name each task the first time it shows up
+  bool named = false;
+  for (uint8_t i = 0; i < numNamedTasks && ! named; ++i) {
+    named = namedTasks[i] == event.task;
+  }
+
+  if (! named && numNamedTasks < MAX_TASKS) {
+    namedTasks[numNamedTasks++] = event.task;
+
+    p += writeEventStart(p);
+    p += sprintf(p, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", tid);
+    p += writeJsonString(p, pcTaskGetTaskName(event.task), configMAX_TASK_NAME_LEN + 3);
+    p += sprintf(p, "}}");
+  }
+
+  p += writeEventStart(p);
+  p += sprintf(p, "{\"name\":");
+  p += writeJsonString(p, event.name, MAX_EVENT_LENGTH - 128);
+  p += sprintf(
+    p,
+    ",\"ph\":\"%c\",\"ts\":%u,\"pid\":1,\"tid\":%u",
+    static_cast<char>(event.phase),
+    static_cast<unsigned>(event.timestamp),
+    tid
+  );
+
+  if (event.phase == Trace::Phase::INSTANT) {
+    // Thread-scoped, so it's drawn on the task's own track
+    p += sprintf(p, ",\"s\":\"t\"");
+  }
+
+  p += sprintf(p, ",\"args\":{\"arg\":%u}}", static_cast<unsigned>(event.arg));
+
+  pendingLen = p - pending;
+}
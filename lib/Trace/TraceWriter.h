@@ -0,0 +1,37 @@
+#include <Trace.h>
+
+#ifndef _TRACE_WRITER_H
+#define _TRACE_WRITER_H
+
+// Serializes the trace ring in Chrome's trace event format (loadable in
+// chrome://tracing or Perfetto) an event at a time, for use as a chunked
+// response body.  Covers the events in the ring when the writer is created.
+class TraceWriter {
+public:
+  TraceWriter();
+
+  // Writes up to maxLen bytes.  Returns 0 once everything has been written.
+  size_t fill(uint8_t* buffer, size_t maxLen);
+
+private:
+  // Tasks named so far with a thread_name metadata event
+  static const uint8_t MAX_TASKS = 16;
+  static const size_t MAX_EVENT_LENGTH = 256;
+
+  uint32_t sequence;
+  const uint32_t endSequence;
+  TaskHandle_t namedTasks[MAX_TASKS];
+  uint8_t numNamedTasks;
+  bool started;
+  bool finished;
+  bool first;
+
+  char pending[2 * MAX_EVENT_LENGTH];
+  size_t pendingLen;
+  size_t pendingIx;
+
+  void refill();
+  size_t writeEventStart(char* out);
+};
+
+#endif
@@ -12,12 +12,17 @@
 #include <Bleeper.h>
 #include <AudioController.h>
 #include <Settings.h>
+#include <SettingsJournal.h>
+#include <SoundIndex.h>
+#include <HeapAccounting.h>
 
 Settings settings;
+SettingsJournal settingsJournal(settings);
+SoundIndex soundIndex(SOUNDS_DIRECTORY);
 CameraController cameraController(settings);
 MotorController motor(settings);
-AudioController audioController(settings);
-HttpServer httpServer(settings, cameraController, motor, audioController);
+AudioController audioController(settings, soundIndex);
+HttpServer httpServer(settings, settingsJournal, cameraController, motor, audioController, soundIndex);
 WiFiManager wifiManager;
 
 void setup() {
@@ -25,22 +30,53 @@ void setup() {
 
   SPIFFS.begin();
 
-  Bleeper.verbose()
-      .configuration
-        .set(&settings)
-        .done()
-      .init();
+  {
+    HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::SETTINGS);
+
+    Bleeper.verbose()
+        .configuration
+          .set(&settings)
+          .done()
+        .init();
+    settingsJournal.init();
+  }
 
   SPI.begin();
   SPI.setFrequency(4000000); //4MHz
 
-  audioController.init();
-  motor.init();
-  cameraController.init();
+  {
+    HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::AUDIO);
+    soundIndex.init();
+    audioController.init();
+  }
+
+  {
+    HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::MOTOR);
+    motor.init();
+  }
+
+  {
+    HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::CAMERA);
+    // Before init(), so no event that wants a dispense is missed
+    cameraController.onMotion([](const MotionResult&) {
+      if (settings.motion.action == MotionAction::DISPENSE) {
+        MotorCommand command;
+        command.type = MotorCommandType::DISPENSE;
+        motor.enqueue(command);
+      }
+    });
+    cameraController.init();
+  }
 
   wifiManager.autoConnect();
 
-  httpServer.begin();
+  {
+    HeapAccounting::Scope heapScope(HeapAccounting::Subsystem::HTTP);
+    httpServer.begin();
+  }
+
+  // All the loop task does from here on
+  HeapAccounting::registerTask(HeapAccounting::Subsystem::SETTINGS);
 
   disableLoopWDT();
   disableCore0WDT();
@@ -50,5 +86,6 @@ time_t lastS = 0;
 
 void loop() {
   Bleeper.handle();
-  audioController.loop();
+  settingsJournal.loop();
+  httpServer.loop();
 }
\ No newline at end of file
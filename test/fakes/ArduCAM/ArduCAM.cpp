@@ -0,0 +1,237 @@
+#include <ArduCAM.h>
+#include <SPI.h>
+
+#include <mutex>
+
+namespace {
+  class Module : public Fake::Spi::Device {
+  public:
+    Module() {
+      reset();
+    }
+
+    void reset() {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      memset(registers, 0, sizeof(registers));
+      frames.clear();
+      nextFrame = 0;
+      captureMicros = 0;
+      jpegSize = OV2640_320x240;
+      capturing = false;
+      captureStartedAt = 0;
+      current = NULL;
+      readPos = 0;
+      dummyPending = false;
+      captures = 0;
+      capDonePolls = 0;
+      bytesRead = 0;
+    }
+
+    uint8_t transfer(uint8_t data) override {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      if (dummyPending) {
+        dummyPending = false;
+        return 0x00;
+      }
+
+      if (current != NULL && readPos < current->size()) {
+        bytesRead++;
+        return (*current)[readPos++];
+      }
+      return 0x00;
+    }
+
+    bool isDone() {
+      return capturing && (micros() - captureStartedAt) >= captureMicros;
+    }
+
+    std::mutex mutex;
+
+    uint8_t registers[256];
+    std::vector<std::vector<uint8_t>> frames;
+    size_t nextFrame;
+    uint32_t captureMicros;
+    uint8_t jpegSize;
+
+    bool capturing;
+    uint32_t captureStartedAt;
+    const std::vector<uint8_t>* current;
+    size_t readPos;
+    bool dummyPending;
+
+    uint32_t captures;
+    uint32_t capDonePolls;
+    uint32_t bytesRead;
+  };
+
+  Module& module() {
+    static Module* instance = new Module();
+    return *instance;
+  }
+}
+
+ArduCAM::ArduCAM() { }
+
+ArduCAM::ArduCAM(uint8_t model, int cs) { }
+
+void ArduCAM::InitCAM() { }
+
+void ArduCAM::set_format(uint8_t format) { }
+
+void ArduCAM::OV2640_set_JPEG_size(uint8_t size) {
+  std::lock_guard<std::mutex> lock(module().mutex);
+  module().jpegSize = size;
+}
+
+void ArduCAM::write_reg(uint8_t addr, uint8_t data) {
+  if (addr == ARDUCHIP_FIFO) {
+    if (data & FIFO_CLEAR_MASK) {
+      clear_fifo_flag();
+    }
+    if (data & FIFO_START_MASK) {
+      start_capture();
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(module().mutex);
+  module().registers[addr] = data;
+}
+
+uint8_t ArduCAM::read_reg(uint8_t addr) {
+  Module& m = module();
+  std::lock_guard<std::mutex> lock(m.mutex);
+
+  if (addr == ARDUCHIP_TRIG) {
+    return m.isDone() ? CAP_DONE_MASK : 0;
+  }
+  return m.registers[addr];
+}
+
+uint8_t ArduCAM::get_bit(uint8_t addr, uint8_t bit) {
+  if (addr == ARDUCHIP_TRIG && (bit & CAP_DONE_MASK)) {
+    std::lock_guard<std::mutex> lock(module().mutex);
+    module().capDonePolls++;
+  }
+
+  return read_reg(addr) & bit;
+}
+
+int ArduCAM::wrSensorReg8_8(int regID, int regDat) {
+  return 0;
+}
+
+int ArduCAM::rdSensorReg8_8(uint8_t regID, uint8_t* regDat) {
+  switch (regID) {
+    case OV2640_CHIPID_HIGH:
+      *regDat = 0x26;
+      break;
+    case OV2640_CHIPID_LOW:
+      *regDat = 0x42;
+      break;
+    default:
+      *regDat = 0;
+      break;
+  }
+  return 0;
+}
+
+void ArduCAM::flush_fifo() {
+  Module& m = module();
+  std::lock_guard<std::mutex> lock(m.mutex);
+
+  m.current = NULL;
+  m.readPos = 0;
+}
+
+void ArduCAM::clear_fifo_flag() {
+  Module& m = module();
+  std::lock_guard<std::mutex> lock(m.mutex);
+
+  m.capturing = false;
+}
+
+void ArduCAM::start_capture() {
+  Module& m = module();
+  std::lock_guard<std::mutex> lock(m.mutex);
+
+  m.capturing = true;
+  m.captureStartedAt = micros();
+  m.captures++;
+  m.readPos = 0;
+  m.current = NULL;
+
+  if (! m.frames.empty()) {
+    m.current = &m.frames[m.nextFrame];
+    m.nextFrame = (m.nextFrame + 1) % m.frames.size();
+  }
+}
+
+uint32_t ArduCAM::read_fifo_length() {
+  Module& m = module();
+  std::lock_guard<std::mutex> lock(m.mutex);
+
+  return (m.isDone() && m.current != NULL) ? m.current->size() : 0;
+}
+
+void ArduCAM::set_fifo_burst() {
+  Module& m = module();
+  std::lock_guard<std::mutex> lock(m.mutex);
+
+  m.readPos = 0;
+  m.dummyPending = true;
+}
+
+uint8_t ArduCAM::read_fifo() {
+  return SPI.transfer(0x00);
+}
+
+void ArduCAM::CS_LOW() {
+  Fake::Spi::select(&module());
+}
+
+void ArduCAM::CS_HIGH() {
+  Fake::Spi::deselect(&module());
+}
+
+namespace Fake {
+  namespace Camera {
+    void reset() {
+      module().reset();
+    }
+
+    void setFrames(const std::vector<std::vector<uint8_t>>& frames) {
+      std::lock_guard<std::mutex> lock(module().mutex);
+      module().frames = frames;
+      module().nextFrame = 0;
+      module().current = NULL;
+    }
+
+    void setCaptureMicros(uint32_t micros) {
+      std::lock_guard<std::mutex> lock(module().mutex);
+      module().captureMicros = micros;
+    }
+
+    uint8_t jpegSize() {
+      std::lock_guard<std::mutex> lock(module().mutex);
+      return module().jpegSize;
+    }
+
+    uint32_t captures() {
+      std::lock_guard<std::mutex> lock(module().mutex);
+      return module().captures;
+    }
+
+    uint32_t capDonePolls() {
+      std::lock_guard<std::mutex> lock(module().mutex);
+      return module().capDonePolls;
+    }
+
+    uint32_t bytesRead() {
+      std::lock_guard<std::mutex> lock(module().mutex);
+      return module().bytesRead;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#include <Arduino.h>
+#include <vector>
+
+#ifndef _FAKE_ARDUCAM_H
+#define _FAKE_ARDUCAM_H
+
+#define OV2640 5
+#define BMP 0
+#define JPEG 1
+#define RAW 2
+
+#define ARDUCHIP_TEST1 0x00
+#define ARDUCHIP_FRAMES 0x01
+#define ARDUCHIP_FIFO 0x04
+#define FIFO_CLEAR_MASK 0x01
+#define FIFO_START_MASK 0x02
+#define ARDUCHIP_TRIG 0x41
+#define CAP_DONE_MASK 0x08
+#define BURST_FIFO_READ 0x3C
+
+#define OV2640_CHIPID_HIGH 0x0A
+#define OV2640_CHIPID_LOW 0x0B
+
+#define OV2640_160x120 0
+#define OV2640_176x144 1
+#define OV2640_320x240 2
+#define OV2640_352x288 3
+#define OV2640_640x480 4
+#define OV2640_800x600 5
+#define OV2640_1024x768 6
+#define OV2640_1280x1024 7
+#define OV2640_1600x1200 8
+
+// Replays recorded frames through the FIFO interface.  Each capture takes the
+// next frame in turn and is done once the configured capture time has passed.
+// A burst read returns a dummy byte, then the frame.  Every instance drives
+// the same simulated module.
+class ArduCAM {
+public:
+  ArduCAM();
+  ArduCAM(uint8_t model, int cs);
+
+  void InitCAM();
+  void set_format(uint8_t format);
+  void OV2640_set_JPEG_size(uint8_t size);
+
+  void write_reg(uint8_t addr, uint8_t data);
+  uint8_t read_reg(uint8_t addr);
+  uint8_t get_bit(uint8_t addr, uint8_t bit);
+  int wrSensorReg8_8(int regID, int regDat);
+  int rdSensorReg8_8(uint8_t regID, uint8_t* regDat);
+
+  void flush_fifo();
+  void clear_fifo_flag();
+  void start_capture();
+  uint32_t read_fifo_length();
+  void set_fifo_burst();
+  uint8_t read_fifo();
+
+  void CS_LOW();
+  void CS_HIGH();
+};
+
+namespace Fake {
+  namespace Camera {
+    void reset();
+
+    // Frames replayed by successive captures, in order, wrapping around
+    void setFrames(const std::vector<std::vector<uint8_t>>& frames);
+    // Time from start_capture() to CAP_DONE
+    void setCaptureMicros(uint32_t micros);
+
+    uint8_t jpegSize();
+    // Captures started, CAP_DONE reads, and frame bytes read out
+    uint32_t captures();
+    uint32_t capDonePolls();
+    uint32_t bytesRead();
+  }
+}
+
+#endif
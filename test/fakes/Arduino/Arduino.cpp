@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include <FakeEsp.h>
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const Clock::time_point startedAt = Clock::now();
+
+  std::atomic<uint8_t> pinModes[Fake::Gpio::NUM_PINS];
+  std::atomic<uint8_t> pinLevels[Fake::Gpio::NUM_PINS];
+  std::atomic<uint32_t> pinWrites[Fake::Gpio::NUM_PINS];
+}
+
+unsigned long millis() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startedAt).count();
+}
+
+// Wraps like the real counter does, every ~71 minutes
+unsigned long micros() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startedAt).count());
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < Fake::Gpio::NUM_PINS) {
+    pinModes[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < Fake::Gpio::NUM_PINS) {
+    pinLevels[pin] = value ? HIGH : LOW;
+    pinWrites[pin]++;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < Fake::Gpio::NUM_PINS ? pinLevels[pin].load() : LOW;
+}
+
+bool psramFound() {
+  return Fake::Esp::hasPsram();
+}
+
+size_t HardwareSerial::printf(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  const int written = vprintf(format, args);
+  va_end(args);
+
+  return written > 0 ? written : 0;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return Fake::Esp::freeHeap();
+}
+
+uint32_t EspClass::getHeapSize() {
+  return 320 * 1024;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return Fake::Esp::freeHeap();
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return Fake::Esp::freeHeap();
+}
+
+const char* EspClass::getSdkVersion() {
+  return "host";
+}
+
+void EspClass::restart() {
+  Fake::Esp::shutdown();
+}
+
+namespace Fake {
+  namespace Gpio {
+    void reset() {
+      for (uint8_t i = 0; i < NUM_PINS; ++i) {
+        pinModes[i] = 0;
+        pinLevels[i] = LOW;
+        pinWrites[i] = 0;
+      }
+    }
+
+    uint8_t mode(uint8_t pin) {
+      return pin < NUM_PINS ? pinModes[pin].load() : 0;
+    }
+
+    uint8_t level(uint8_t pin) {
+      return pin < NUM_PINS ? pinLevels[pin].load() : LOW;
+    }
+
+    uint32_t writes(uint8_t pin) {
+      return pin < NUM_PINS ? pinWrites[pin].load() : 0;
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include <WString.h>
+#include <esp_system.h>
+
+// The ESP32 core pulls these in for every sketch
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "freertos/semphr.h"
+  #include "freertos/queue.h"
+}
+
+#ifndef _FAKE_ARDUINO_H
+#define _FAKE_ARDUINO_H
+
+// Host stand-in for the Arduino core.  Time is wall-clock time since the
+// process started, pins are an array of levels, and Serial goes to stdout.
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define F(s) (s)
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define memcpy_P memcpy
+#define printf_P printf
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t*>(addr))
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+
+#define SS 5
+#define SCK 18
+#define MISO 19
+#define MOSI 23
+#define SDA 21
+#define SCL 22
+
+#define BIT(n) (1UL << (n))
+#define BIT0 BIT(0)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+bool psramFound();
+
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) { }
+
+  size_t print(const String& s) { return fputs(s.c_str(), stdout) >= 0 ? s.length() : 0; }
+  size_t print(const char* s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+  size_t print(char c) { return fputc(c, stdout) != EOF; }
+  size_t print(int value) { return printf("%d", value); }
+  size_t print(unsigned int value) { return printf("%u", value); }
+  size_t print(long value) { return printf("%ld", value); }
+  size_t print(unsigned long value) { return printf("%lu", value); }
+  size_t print(double value, int decimals = 2) { return printf("%.*f", decimals, value); }
+
+  template <typename T>
+  size_t println(const T& value) { return print(value) + println(); }
+  size_t println() { return print('\n'); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getFreeHeap();
+  uint32_t getHeapSize();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  const char* getSdkVersion();
+  void restart();
+};
+
+extern EspClass ESP;
+
+// Test controls
+namespace Fake {
+  namespace Gpio {
+    const uint8_t NUM_PINS = 40;
+
+    void reset();
+    uint8_t mode(uint8_t pin);
+    uint8_t level(uint8_t pin);
+    // Writes to the pin since the last reset
+    uint32_t writes(uint8_t pin);
+  }
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+#ifndef _FAKE_WSTRING_H
+#define _FAKE_WSTRING_H
+
+class __FlashStringHelper;
+
+// Enough of Arduino's String for the firmware and ArduinoJson's String
+// adapters, backed by std::string.
+class String {
+public:
+  String(const char* str = "") : str(str != NULL ? str : "") { }
+  String(const std::string& str) : str(str) { }
+  String(char c) : str(1, c) { }
+  String(int value) : str(std::to_string(value)) { }
+  String(unsigned int value) : str(std::to_string(value)) { }
+  String(long value) : str(std::to_string(value)) { }
+  String(unsigned long value) : str(std::to_string(value)) { }
+  String(float value, unsigned int decimals = 2) : str(formatFloat(value, decimals)) { }
+  String(double value, unsigned int decimals = 2) : str(formatFloat(value, decimals)) { }
+
+  const char* c_str() const { return str.c_str(); }
+  unsigned int length() const { return str.size(); }
+  bool reserve(unsigned int size) { str.reserve(size); return true; }
+
+  bool concat(const String& other) { str += other.str; return true; }
+  bool concat(const char* other) { str += other; return true; }
+  bool concat(char c) { str += c; return true; }
+
+  String& operator+=(const String& other) { str += other.str; return *this; }
+  String& operator+=(const char* other) { str += other; return *this; }
+  String& operator+=(char c) { str += c; return *this; }
+
+  friend String operator+(const String& a, const String& b) { return String(a.str + b.str); }
+  friend String operator+(const String& a, const char* b) { return String(a.str + b); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.str); }
+
+  bool equals(const String& other) const { return str == other.str; }
+  bool equalsIgnoreCase(const String& other) const { return strcasecmp(str.c_str(), other.str.c_str()) == 0; }
+  bool operator==(const String& other) const { return str == other.str; }
+  bool operator==(const char* other) const { return str == other; }
+  bool operator!=(const String& other) const { return str != other.str; }
+  bool operator!=(const char* other) const { return str != other; }
+  bool operator<(const String& other) const { return str < other.str; }
+
+  char charAt(unsigned int ix) const { return ix < str.size() ? str[ix] : 0; }
+  char operator[](unsigned int ix) const { return charAt(ix); }
+
+  int indexOf(char c, unsigned int from = 0) const { return toIndex(str.find(c, from)); }
+  int indexOf(const String& other, unsigned int from = 0) const { return toIndex(str.find(other.str, from)); }
+  int lastIndexOf(char c) const { return toIndex(str.rfind(c)); }
+  int lastIndexOf(const String& other) const { return toIndex(str.rfind(other.str)); }
+
+  bool startsWith(const String& prefix) const { return str.compare(0, prefix.str.size(), prefix.str) == 0; }
+  bool endsWith(const String& suffix) const {
+    return str.size() >= suffix.str.size()
+      && str.compare(str.size() - suffix.str.size(), suffix.str.size(), suffix.str) == 0;
+  }
+
+  String substring(unsigned int from) const { return from < str.size() ? String(str.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < to && from < str.size() ? String(str.substr(from, to - from)) : String();
+  }
+
+  void remove(unsigned int from) { if (from < str.size()) str.erase(from); }
+  void remove(unsigned int from, unsigned int count) { if (from < str.size()) str.erase(from, count); }
+  void toLowerCase() { for (char& c : str) c = tolower(c); }
+  void toUpperCase() { for (char& c : str) c = toupper(c); }
+
+  long toInt() const { return atol(str.c_str()); }
+  float toFloat() const { return atof(str.c_str()); }
+
+private:
+  std::string str;
+
+  static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : static_cast<int>(pos); }
+
+  static std::string formatFloat(double value, unsigned int decimals) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+    return buffer;
+  }
+};
+
+#endif
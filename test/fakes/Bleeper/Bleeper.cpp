@@ -0,0 +1,92 @@
+#include <Bleeper.h>
+
+BleeperClass Bleeper;
+
+namespace {
+  Configuration* rootConfiguration = NULL;
+  uint32_t persistCount = 0;
+  ConfigurationDictionary persistedValues;
+}
+
+void Configuration::setFromDictionary(const ConfigurationDictionary& dictionary) {
+  apply("", dictionary);
+}
+
+ConfigurationDictionary Configuration::getAsDictionary(bool onlyPersistent) {
+  ConfigurationDictionary dictionary;
+  collect("", dictionary);
+  return dictionary;
+}
+
+int Configuration::addVariable(const char* name, std::function<void(const String&)> setter, std::function<String()> getter) {
+  Variable variable = { name, setter, getter };
+  variables.push_back(variable);
+  return 0;
+}
+
+int Configuration::addSubconfig(const char* name, Configuration* subconfig) {
+  subconfigs.push_back(std::make_pair(String(name), subconfig));
+  return 0;
+}
+
+void Configuration::apply(const String& prefix, const ConfigurationDictionary& dictionary) {
+  for (std::vector<Variable>::const_iterator it = variables.begin(); it != variables.end(); ++it) {
+    ConfigurationDictionary::const_iterator value = dictionary.find(prefix + it->name);
+
+    if (value != dictionary.end()) {
+      it->setter(value->second);
+    }
+  }
+
+  for (std::vector<std::pair<String, Configuration*>>::const_iterator it = subconfigs.begin(); it != subconfigs.end(); ++it) {
+    it->second->apply(prefix + it->first + ".", dictionary);
+  }
+}
+
+void Configuration::collect(const String& prefix, ConfigurationDictionary& dictionary) {
+  for (std::vector<Variable>::const_iterator it = variables.begin(); it != variables.end(); ++it) {
+    dictionary[prefix + it->name] = it->getter();
+  }
+
+  for (std::vector<std::pair<String, Configuration*>>::const_iterator it = subconfigs.begin(); it != subconfigs.end(); ++it) {
+    it->second->collect(prefix + it->first + ".", dictionary);
+  }
+}
+
+void BleeperStorage::persist() {
+  persistCount++;
+
+  if (rootConfiguration != NULL) {
+    persistedValues = rootConfiguration->getAsDictionary(true);
+  }
+}
+
+BleeperClass& BleeperClass::verbose() {
+  return *this;
+}
+
+void BleeperClass::init() { }
+
+void BleeperClass::handle() { }
+
+namespace Fake {
+  namespace Bleeper {
+    void setConfiguration(Configuration* configuration) {
+      rootConfiguration = configuration;
+    }
+
+    uint32_t persists() {
+      return persistCount;
+    }
+
+    const ConfigurationDictionary& persisted() {
+      return persistedValues;
+    }
+
+    void reset() {
+      rootConfiguration = NULL;
+      persistCount = 0;
+      persistedValues.clear();
+    }
+  }
+}
@@ -0,0 +1,106 @@
+#include <Arduino.h>
+#include <functional>
+#include <map>
+#include <vector>
+
+#ifndef _FAKE_BLEEPER_H
+#define _FAKE_BLEEPER_H
+
+typedef std::map<String, String> ConfigurationDictionary;
+
+// Same declarations as Bleeper's configuration macros.  Each variable
+// registers a string setter and getter with its Configuration, and
+// subconfigurations are addressed with dotted keys (e.g. "motor.num_turns").
+class Configuration {
+public:
+  Configuration(const Configuration&) = delete;
+  Configuration& operator=(const Configuration&) = delete;
+
+  void setFromDictionary(const ConfigurationDictionary& dictionary);
+  ConfigurationDictionary getAsDictionary(bool onlyPersistent = false);
+
+protected:
+  Configuration() { }
+
+  int addVariable(const char* name, std::function<void(const String&)> setter, std::function<String()> getter);
+  int addSubconfig(const char* name, Configuration* subconfig);
+
+private:
+  struct Variable {
+    String name;
+    std::function<void(const String&)> setter;
+    std::function<String()> getter;
+  };
+
+  std::vector<Variable> variables;
+  std::vector<std::pair<String, Configuration*>> subconfigs;
+
+  void apply(const String& prefix, const ConfigurationDictionary& dictionary);
+  void collect(const String& prefix, ConfigurationDictionary& dictionary);
+};
+
+class RootConfiguration : public Configuration { };
+
+#define persistentVar(type, name, defaultValue, setBody, getBody) \
+  type name = (addVariable( \
+    #name, \
+    [this](const String& _value) { name##String = _value; setBody }, \
+    [this]() -> String { getBody return name##String; } \
+  ), defaultValue); \
+  String name##String
+
+#define persistentIntVar(name, defaultValue) \
+  int name = (addVariable( \
+    #name, \
+    [this](const String& _value) { name = _value.toInt(); }, \
+    [this]() -> String { return String(name); } \
+  ), defaultValue)
+
+#define persistentFloatVar(name, defaultValue) \
+  float name = (addVariable( \
+    #name, \
+    [this](const String& _value) { name = _value.toFloat(); }, \
+    [this]() -> String { return String(name); } \
+  ), defaultValue)
+
+#define persistentStringVar(name, defaultValue) \
+  String name = (addVariable( \
+    #name, \
+    [this](const String& _value) { name = _value; }, \
+    [this]() -> String { return name; } \
+  ), String(defaultValue))
+
+#define subconfig(type, name) \
+  type name; \
+  int name##Registration = addSubconfig(#name, &name)
+
+class BleeperStorage {
+public:
+  // Snapshots the configuration given to Fake::Bleeper::setConfiguration()
+  void persist();
+};
+
+class BleeperClass {
+public:
+  BleeperStorage storage;
+
+  BleeperClass& verbose();
+  void init();
+  void handle();
+};
+
+extern BleeperClass Bleeper;
+
+namespace Fake {
+  namespace Bleeper {
+    void setConfiguration(Configuration* configuration);
+
+    // Calls to Bleeper.storage.persist() since the last reset, and what the
+    // last one stored
+    uint32_t persists();
+    const ConfigurationDictionary& persisted();
+    void reset();
+  }
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include <esp_system.h>
+#include <esp_heap_caps.h>
+#include <rom/crc.h>
+#include <FakeEsp.h>
+
+#include <stdlib.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace {
+  std::atomic<bool> psram(false);
+  std::atomic<uint32_t> freeHeapBytes(200 * 1024);
+  std::atomic<uint32_t> restartCount(0);
+
+  std::mutex heapMutex;
+  std::map<void*, size_t> heapCapsAllocations;
+  size_t heapCapsBytes = 0;
+  size_t heapCapsLimit = 0;
+  uint32_t heapCapsFailureCount = 0;
+
+  std::vector<shutdown_handler_t> shutdownHandlers;
+
+  uint32_t randomState = 0x12345678;
+}
+
+extern "C" {
+
+uint32_t esp_random(void) {
+  // xorshift32
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+int esp_register_shutdown_handler(shutdown_handler_t handler) {
+  shutdownHandlers.push_back(handler);
+  return 0;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+
+  if (((caps & MALLOC_CAP_SPIRAM) && ! psram)
+    || (heapCapsLimit > 0 && heapCapsBytes + size > heapCapsLimit)) {
+    heapCapsFailureCount++;
+    return NULL;
+  }
+
+  void* ptr = malloc(size);
+
+  if (ptr != NULL) {
+    heapCapsAllocations[ptr] = size;
+    heapCapsBytes += size;
+  }
+
+  return ptr;
+}
+
+void heap_caps_free(void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(heapMutex);
+    std::map<void*, size_t>::iterator it = heapCapsAllocations.find(ptr);
+
+    if (it != heapCapsAllocations.end()) {
+      heapCapsBytes -= it->second;
+      heapCapsAllocations.erase(it);
+    }
+  }
+
+  free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return freeHeapBytes;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  std::lock_guard<std::mutex> lock(heapMutex);
+
+  if (heapCapsLimit > 0) {
+    return heapCapsLimit > heapCapsBytes ? heapCapsLimit - heapCapsBytes : 0;
+  }
+  return freeHeapBytes;
+}
+
+uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+  crc = ~crc;
+
+  for (uint32_t i = 0; i < len; ++i) {
+    crc ^= buf[i];
+
+    for (uint8_t bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+
+  return ~crc;
+}
+
+}
+
+namespace Fake {
+  namespace Esp {
+    void setPsram(bool found) {
+      psram = found;
+    }
+
+    bool hasPsram() {
+      return psram;
+    }
+
+    void setFreeHeap(uint32_t bytes) {
+      freeHeapBytes = bytes;
+    }
+
+    uint32_t freeHeap() {
+      return freeHeapBytes;
+    }
+
+    void setHeapCapsLimit(size_t bytes) {
+      std::lock_guard<std::mutex> lock(heapMutex);
+      heapCapsLimit = bytes;
+      heapCapsFailureCount = 0;
+    }
+
+    size_t heapCapsAllocated() {
+      std::lock_guard<std::mutex> lock(heapMutex);
+      return heapCapsBytes;
+    }
+
+    uint32_t heapCapsFailures() {
+      std::lock_guard<std::mutex> lock(heapMutex);
+      return heapCapsFailureCount;
+    }
+
+    void shutdown() {
+      restartCount++;
+
+      for (size_t i = 0; i < shutdownHandlers.size(); ++i) {
+        shutdownHandlers[i]();
+      }
+    }
+
+    uint32_t restarts() {
+      return restartCount;
+    }
+  }
+}
@@ -0,0 +1,30 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef _FAKE_ESP_H
+#define _FAKE_ESP_H
+
+// Test controls for the ESP32 system and heap fakes
+namespace Fake {
+  namespace Esp {
+    void setPsram(bool found);
+    bool hasPsram();
+
+    // What ESP.getFreeHeap() and heap_caps_get_free_size() report
+    void setFreeHeap(uint32_t bytes);
+    uint32_t freeHeap();
+
+    // heap_caps_malloc() fails if it would take more than this many bytes
+    // outstanding.  0 removes the limit.
+    void setHeapCapsLimit(size_t bytes);
+    size_t heapCapsAllocated();
+    uint32_t heapCapsFailures();
+
+    // Runs the handlers registered with esp_register_shutdown_handler(), as
+    // esp_restart() does
+    void shutdown();
+    uint32_t restarts();
+  }
+}
+
+#endif
@@ -0,0 +1,37 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <driver/rmt.h>
+
+#ifndef _FAKE_RMT_H
+#define _FAKE_RMT_H
+
+// Test controls for the RMT fake.  Each channel records every item written to
+// it, in order.
+//
+// Time is virtual: a write with wait_tx_done = false stays in flight until the
+// next write or rmt_wait_tx_done, which then advance the channel's clock by
+// the items' durations.  Like the driver's ISR, the fake reads an in-flight
+// buffer when the transmission finishes, so a caller that reuses the buffer
+// too early is caught.
+namespace Fake {
+  namespace Rmt {
+    void reset();
+
+    bool installed(rmt_channel_t channel);
+    const rmt_config_t& config(rmt_channel_t channel);
+    const std::vector<rmt_item32_t>& items(rmt_channel_t channel);
+
+    // Calls to rmt_write_items()
+    uint32_t writes(rmt_channel_t channel);
+    // Most items passed to a single rmt_write_items()
+    size_t largestWrite(rmt_channel_t channel);
+    // Writes whose buffer changed while they were being sent
+    uint32_t overwrites(rmt_channel_t channel);
+    // Sum of the durations sent, in ticks
+    uint64_t elapsedTicks(rmt_channel_t channel);
+  }
+}
+
+#endif
@@ -0,0 +1,156 @@
+#include <driver/rmt.h>
+#include <FakeRmt.h>
+
+#include <string.h>
+#include <algorithm>
+
+namespace {
+  struct Channel {
+    bool installed;
+    rmt_config_t config;
+    std::vector<rmt_item32_t> items;
+    uint32_t writes;
+    size_t largestWrite;
+    uint32_t overwrites;
+    uint64_t elapsedTicks;
+
+    // The transmission in progress, and its items as they were when written
+    const rmt_item32_t* inFlight;
+    std::vector<rmt_item32_t> written;
+  };
+
+  Channel channels[RMT_CHANNEL_MAX];
+
+  bool isValid(rmt_channel_t channel) {
+    return channel >= RMT_CHANNEL_0 && channel < RMT_CHANNEL_MAX;
+  }
+
+  void finish(Channel& ch) {
+    if (ch.inFlight == NULL) {
+      return;
+    }
+
+    const size_t count = ch.written.size();
+
+    if (memcmp(ch.inFlight, ch.written.data(), count * sizeof(rmt_item32_t)) != 0) {
+      ch.overwrites++;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+      ch.elapsedTicks += ch.inFlight[i].duration0 + ch.inFlight[i].duration1;
+    }
+
+    ch.items.insert(ch.items.end(), ch.inFlight, ch.inFlight + count);
+    ch.inFlight = NULL;
+    ch.written.clear();
+  }
+}
+
+extern "C" {
+
+esp_err_t rmt_config(const rmt_config_t* config) {
+  if (config == NULL || ! isValid(config->channel)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  channels[config->channel].config = *config;
+  return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags) {
+  if (! isValid(channel)) {
+    return ESP_ERR_INVALID_ARG;
+  } else if (channels[channel].installed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  channels[channel].installed = true;
+  return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel) {
+  if (! isValid(channel)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  channels[channel].installed = false;
+  return ESP_OK;
+}
+
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t* rmt_item, int item_num, bool wait_tx_done) {
+  if (! isValid(channel) || ! channels[channel].installed || rmt_item == NULL || item_num <= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  Channel& ch = channels[channel];
+
+  // The driver waits for the previous transmission before starting another
+  finish(ch);
+
+  ch.inFlight = rmt_item;
+  ch.written.assign(rmt_item, rmt_item + item_num);
+  ch.writes++;
+  ch.largestWrite = std::max(ch.largestWrite, static_cast<size_t>(item_num));
+
+  if (wait_tx_done) {
+    finish(ch);
+  }
+
+  return ESP_OK;
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time) {
+  if (! isValid(channel) || ! channels[channel].installed) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  finish(channels[channel]);
+  return ESP_OK;
+}
+
+}
+
+namespace Fake {
+  namespace Rmt {
+    void reset() {
+      for (size_t i = 0; i < RMT_CHANNEL_MAX; ++i) {
+        channels[i].installed = false;
+        channels[i].items.clear();
+        channels[i].writes = 0;
+        channels[i].largestWrite = 0;
+        channels[i].overwrites = 0;
+        channels[i].elapsedTicks = 0;
+        channels[i].inFlight = NULL;
+        channels[i].written.clear();
+      }
+    }
+
+    bool installed(rmt_channel_t channel) {
+      return channels[channel].installed;
+    }
+
+    const rmt_config_t& config(rmt_channel_t channel) {
+      return channels[channel].config;
+    }
+
+    const std::vector<rmt_item32_t>& items(rmt_channel_t channel) {
+      return channels[channel].items;
+    }
+
+    uint32_t writes(rmt_channel_t channel) {
+      return channels[channel].writes;
+    }
+
+    size_t largestWrite(rmt_channel_t channel) {
+      return channels[channel].largestWrite;
+    }
+
+    uint32_t overwrites(rmt_channel_t channel) {
+      return channels[channel].overwrites;
+    }
+
+    uint64_t elapsedTicks(rmt_channel_t channel) {
+      return channels[channel].elapsedTicks;
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+#ifndef _FAKE_DRIVER_RMT_H
+#define _FAKE_DRIVER_RMT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef int gpio_num_t;
+
+typedef enum {
+  RMT_CHANNEL_0 = 0,
+  RMT_CHANNEL_1,
+  RMT_CHANNEL_2,
+  RMT_CHANNEL_3,
+  RMT_CHANNEL_4,
+  RMT_CHANNEL_5,
+  RMT_CHANNEL_6,
+  RMT_CHANNEL_7,
+  RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef enum {
+  RMT_MODE_TX = 0,
+  RMT_MODE_RX,
+  RMT_MODE_MAX
+} rmt_mode_t;
+
+typedef enum {
+  RMT_IDLE_LEVEL_LOW = 0,
+  RMT_IDLE_LEVEL_HIGH,
+  RMT_IDLE_LEVEL_MAX
+} rmt_idle_level_t;
+
+typedef enum {
+  RMT_CARRIER_LEVEL_LOW = 0,
+  RMT_CARRIER_LEVEL_HIGH,
+  RMT_CARRIER_LEVEL_MAX
+} rmt_carrier_level_t;
+
+typedef struct {
+  union {
+    struct {
+      uint32_t duration0 :15;
+      uint32_t level0 :1;
+      uint32_t duration1 :15;
+      uint32_t level1 :1;
+    };
+    uint32_t val;
+  };
+} rmt_item32_t;
+
+typedef struct {
+  bool loop_en;
+  uint32_t carrier_freq_hz;
+  uint8_t carrier_duty_percent;
+  rmt_carrier_level_t carrier_level;
+  bool carrier_en;
+  rmt_idle_level_t idle_level;
+  bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+  rmt_mode_t rmt_mode;
+  rmt_channel_t channel;
+  uint8_t clk_div;
+  gpio_num_t gpio_num;
+  uint8_t mem_block_num;
+  union {
+    rmt_tx_config_t tx_config;
+  };
+} rmt_config_t;
+
+esp_err_t rmt_config(const rmt_config_t* config);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags);
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel);
+
+// Items are "sent" as soon as they're written; see FakeRmt.h
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t* rmt_item, int item_num, bool wait_tx_done);
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,22 @@
+#include <stdint.h>
+
+#ifndef _FAKE_ESP_SYSTEM_H
+#define _FAKE_ESP_SYSTEM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*shutdown_handler_t)(void);
+
+// Deterministic, so tests are repeatable
+uint32_t esp_random(void);
+
+// Handlers run from Fake::Esp::shutdown()
+int esp_register_shutdown_handler(shutdown_handler_t handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
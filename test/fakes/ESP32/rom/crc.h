@@ -0,0 +1,17 @@
+#include <stdint.h>
+
+#ifndef _FAKE_ROM_CRC_H
+#define _FAKE_ROM_CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CRC-32 (IEEE 802.3), continued from crc.  crc32_le(0, ...) starts a new one.
+uint32_t crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
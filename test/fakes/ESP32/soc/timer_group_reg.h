@@ -0,0 +1 @@
+// Register definitions aren't used on the host
@@ -0,0 +1,23 @@
+#include <Arduino.h>
+
+#ifndef _FAKE_AUDIO_FILE_SOURCE_H
+#define _FAKE_AUDIO_FILE_SOURCE_H
+
+// Same interface as ESP8266Audio's
+class AudioFileSource {
+public:
+  AudioFileSource() { }
+  virtual ~AudioFileSource() { }
+
+  virtual bool open(const char* filename) { return false; }
+  virtual uint32_t read(void* data, uint32_t len) { return 0; }
+  virtual uint32_t readNonBlock(void* data, uint32_t len) { return read(data, len); }
+  virtual bool seek(int32_t pos, int dir) { return false; }
+  virtual bool close() { return false; }
+  virtual bool isOpen() { return false; }
+  virtual uint32_t getSize() { return 0; }
+  virtual uint32_t getPos() { return 0; }
+  virtual bool loop() { return true; }
+};
+
+#endif
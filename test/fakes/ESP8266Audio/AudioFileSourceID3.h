@@ -0,0 +1,23 @@
+#include <AudioFileSource.h>
+
+#ifndef _FAKE_AUDIO_FILE_SOURCE_ID3_H
+#define _FAKE_AUDIO_FILE_SOURCE_ID3_H
+
+// Passes reads straight through; the fake MP3 format has no tags to skip
+class AudioFileSourceID3 : public AudioFileSource {
+public:
+  AudioFileSourceID3(AudioFileSource* src) : src(src) { }
+
+  virtual bool open(const char* filename) override { return src->open(filename); }
+  virtual uint32_t read(void* data, uint32_t len) override { return src->read(data, len); }
+  virtual bool seek(int32_t pos, int dir) override { return src->seek(pos, dir); }
+  virtual bool close() override { return src->close(); }
+  virtual bool isOpen() override { return src->isOpen(); }
+  virtual uint32_t getSize() override { return src->getSize(); }
+  virtual uint32_t getPos() override { return src->getPos(); }
+
+private:
+  AudioFileSource* src;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include <AudioFileSource.h>
+#include <SPIFFS.h>
+
+#ifndef _FAKE_AUDIO_FILE_SOURCE_SPIFFS_H
+#define _FAKE_AUDIO_FILE_SOURCE_SPIFFS_H
+
+// Reads from the SPIFFS fake
+class AudioFileSourceSPIFFS : public AudioFileSource {
+public:
+  AudioFileSourceSPIFFS() { }
+  AudioFileSourceSPIFFS(const char* filename) { open(filename); }
+  virtual ~AudioFileSourceSPIFFS() override { close(); }
+
+  virtual bool open(const char* filename) override {
+    f = SPIFFS.open(filename, FILE_READ);
+    return static_cast<bool>(f);
+  }
+
+  virtual uint32_t read(void* data, uint32_t len) override {
+    return f ? f.read(static_cast<uint8_t*>(data), len) : 0;
+  }
+
+  virtual bool seek(int32_t pos, int dir) override {
+    return f && f.seek(pos, static_cast<SeekMode>(dir));
+  }
+
+  virtual bool close() override {
+    f.close();
+    return true;
+  }
+
+  virtual bool isOpen() override { return static_cast<bool>(f); }
+  virtual uint32_t getSize() override { return f ? f.size() : 0; }
+  virtual uint32_t getPos() override { return f ? f.position() : 0; }
+
+private:
+  File f;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include <AudioFileSource.h>
+#include <AudioOutput.h>
+
+#ifndef _FAKE_AUDIO_GENERATOR_H
+#define _FAKE_AUDIO_GENERATOR_H
+
+// Same interface as ESP8266Audio's
+class AudioGenerator {
+public:
+  AudioGenerator() : running(false), file(NULL), output(NULL) { lastSample[0] = 0; lastSample[1] = 0; }
+  virtual ~AudioGenerator() { }
+
+  virtual bool begin(AudioFileSource* source, AudioOutput* output) { return false; }
+  virtual bool loop() { return false; }
+  virtual bool stop() { return false; }
+  virtual bool isRunning() { return false; }
+
+protected:
+  bool running;
+  AudioFileSource* file;
+  AudioOutput* output;
+  int16_t lastSample[2];
+};
+
+#endif
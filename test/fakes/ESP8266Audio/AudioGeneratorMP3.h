@@ -0,0 +1,34 @@
+#include <AudioGenerator.h>
+#include <string>
+#include <vector>
+
+#ifndef _FAKE_AUDIO_GENERATOR_MP3_H
+#define _FAKE_AUDIO_GENERATOR_MP3_H
+
+// Stands in for the libmad decoder.  "MP3s" are raw PCM behind a small
+// header (see Fake::Mp3::encode), so tests can control exactly what comes
+// out.  Like the real decoder, loop() pushes samples until the output turns
+// one away.
+class AudioGeneratorMP3 : public AudioGenerator {
+public:
+  AudioGeneratorMP3();
+  virtual ~AudioGeneratorMP3() override;
+
+  virtual bool begin(AudioFileSource* source, AudioOutput* output) override;
+  virtual bool loop() override;
+  virtual bool stop() override;
+  virtual bool isRunning() override;
+
+private:
+  uint8_t channels;
+  bool samplePending;
+};
+
+namespace Fake {
+  namespace Mp3 {
+    // A file the fake decoder plays as the given interleaved samples
+    std::string encode(uint32_t sampleRate, uint8_t channels, const std::vector<int16_t>& samples);
+  }
+}
+
+#endif
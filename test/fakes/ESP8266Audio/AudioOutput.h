@@ -0,0 +1,32 @@
+#include <Arduino.h>
+
+#ifndef _FAKE_AUDIO_OUTPUT_H
+#define _FAKE_AUDIO_OUTPUT_H
+
+// Same interface as ESP8266Audio's
+class AudioOutput {
+public:
+  AudioOutput() : hertz(0), bps(16), channels(2), gainF2P6(1 << 6) { }
+  virtual ~AudioOutput() { }
+
+  virtual bool SetRate(int hz) { hertz = hz; return true; }
+  virtual bool SetBitsPerSample(int bits) { bps = bits; return true; }
+  virtual bool SetChannels(int chan) { channels = chan; return true; }
+  virtual bool SetGain(float f) { gainF2P6 = static_cast<uint8_t>(std::min(std::max(f, 0.0f), 4.0f) * (1 << 6)); return true; }
+  virtual bool begin() { return false; }
+
+  typedef enum { LEFTCHANNEL = 0, RIGHTCHANNEL = 1 } SampleIndex;
+
+  virtual bool ConsumeSample(int16_t sample[2]) { return false; }
+  virtual bool stop() { return false; }
+  virtual void flush() { }
+  virtual bool loop() { return true; }
+
+protected:
+  uint16_t hertz;
+  uint8_t bps;
+  uint8_t channels;
+  uint8_t gainF2P6;
+};
+
+#endif
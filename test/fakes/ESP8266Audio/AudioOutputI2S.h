@@ -0,0 +1,25 @@
+#include <AudioOutput.h>
+
+#ifndef _FAKE_AUDIO_OUTPUT_I2S_H
+#define _FAKE_AUDIO_OUTPUT_I2S_H
+
+// Accepts every sample and throws it away
+class AudioOutputI2S : public AudioOutput {
+public:
+  enum { EXTERNAL_I2S = 0, INTERNAL_DAC = 1, INTERNAL_PDM = 2 };
+
+  AudioOutputI2S(int port = 0, int output_mode = EXTERNAL_I2S, int dma_buf_count = 8, int use_apll = 0)
+    : dmaBufferCount(dma_buf_count)
+  { }
+
+  virtual bool begin() override { return true; }
+  virtual bool ConsumeSample(int16_t sample[2]) override { return true; }
+  virtual bool stop() override { return true; }
+
+  int getDmaBufferCount() const { return dmaBufferCount; }
+
+private:
+  int dmaBufferCount;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#include <AudioOutputI2S.h>
+
+#ifndef _FAKE_AUDIO_OUTPUT_I2S_NO_DAC_H
+#define _FAKE_AUDIO_OUTPUT_I2S_NO_DAC_H
+
+class AudioOutputI2SNoDAC : public AudioOutputI2S {
+public:
+  AudioOutputI2SNoDAC(int port = 0) : AudioOutputI2S(port) { }
+};
+
+#endif
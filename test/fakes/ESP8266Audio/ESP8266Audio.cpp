@@ -0,0 +1,110 @@
+#include <AudioGeneratorMP3.h>
+
+namespace {
+  const char MAGIC[4] = { 'F', 'M', 'P', '3' };
+  // magic, sample rate (4), channels (1), padding (3)
+  const size_t HEADER_SIZE = 12;
+  // Samples per channel in an MP3 frame.  The real decoder returns from
+  // loop() after each one.
+  const size_t FRAME_SAMPLES = 1152;
+}
+
+AudioGeneratorMP3::AudioGeneratorMP3()
+  : channels(0)
+  , samplePending(false)
+{ }
+
+AudioGeneratorMP3::~AudioGeneratorMP3() { }
+
+bool AudioGeneratorMP3::begin(AudioFileSource* source, AudioOutput* output) {
+  uint8_t header[HEADER_SIZE];
+
+  if (source == NULL || output == NULL) {
+    return false;
+  }
+
+  file = source;
+  this->output = output;
+
+  if (file->read(header, sizeof(header)) != sizeof(header) || memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+    return false;
+  }
+
+  uint32_t sampleRate;
+  memcpy(&sampleRate, header + 4, sizeof(sampleRate));
+  channels = header[8];
+
+  if (channels < 1 || channels > 2) {
+    return false;
+  }
+
+  output->SetRate(sampleRate);
+  output->SetBitsPerSample(16);
+  output->SetChannels(2);
+
+  if (! output->begin()) {
+    return false;
+  }
+
+  samplePending = false;
+  running = true;
+  return true;
+}
+
+bool AudioGeneratorMP3::loop() {
+  if (! running) {
+    return false;
+  }
+
+  for (size_t i = 0; i < FRAME_SAMPLES; ++i) {
+    if (! samplePending) {
+      int16_t frame[2];
+      const uint32_t len = channels * sizeof(int16_t);
+
+      if (file->read(frame, len) != len) {
+        output->flush();
+        running = false;
+        return false;
+      }
+
+      lastSample[AudioOutput::LEFTCHANNEL] = frame[0];
+      lastSample[AudioOutput::RIGHTCHANNEL] = channels == 2 ? frame[1] : frame[0];
+    }
+
+    if (! output->ConsumeSample(lastSample)) {
+      samplePending = true;
+      return true;
+    }
+    samplePending = false;
+  }
+
+  return true;
+}
+
+bool AudioGeneratorMP3::stop() {
+  running = false;
+
+  if (output != NULL) {
+    output->stop();
+  }
+
+  return file != NULL ? file->close() : true;
+}
+
+bool AudioGeneratorMP3::isRunning() {
+  return running;
+}
+
+namespace Fake {
+  namespace Mp3 {
+    std::string encode(uint32_t sampleRate, uint8_t channels, const std::vector<int16_t>& samples) {
+      std::string result(MAGIC, sizeof(MAGIC));
+      result.append(reinterpret_cast<const char*>(&sampleRate), sizeof(sampleRate));
+      result.push_back(static_cast<char>(channels));
+      result.append(3, '\0');
+      result.append(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(int16_t));
+
+      return result;
+    }
+  }
+}
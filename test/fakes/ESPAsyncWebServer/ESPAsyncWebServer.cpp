@@ -0,0 +1,343 @@
+#include <ESPAsyncWebServer.h>
+
+namespace {
+  // One TCP segment, as AsyncTCP hands to response fillers
+  const size_t FILL_CHUNK_SIZE = 1436;
+  // Fillers that keep asking to try again give up after this long
+  const uint32_t FILL_TIMEOUT_MS = 10000;
+
+  AsyncWebServer* activeServer = NULL;
+}
+
+////////============== Responses
+
+AsyncWebServerResponse::AsyncWebServerResponse(int code, const String& contentType, const String& content)
+  : _code(code)
+  , _contentType(contentType)
+  , _body(content.c_str())
+  , _length(0)
+{ }
+
+AsyncWebServerResponse::AsyncWebServerResponse(const String& contentType, size_t length, AwsResponseFiller filler)
+  : _code(200)
+  , _contentType(contentType)
+  , _filler(filler)
+  , _length(length)
+{ }
+
+void AsyncWebServerResponse::addHeader(const String& name, const String& value) {
+  _headers.push_back(AsyncWebHeader(name, value));
+}
+
+const AsyncWebHeader* AsyncWebServerResponse::header(const char* name) const {
+  for (size_t i = 0; i < _headers.size(); ++i) {
+    if (_headers[i].name().equalsIgnoreCase(name)) {
+      return &_headers[i];
+    }
+  }
+  return NULL;
+}
+
+void AsyncWebServerResponse::drain() {
+  if (! _filler) {
+    return;
+  }
+
+  uint8_t chunk[FILL_CHUNK_SIZE];
+  const uint32_t deadline = millis() + FILL_TIMEOUT_MS;
+
+  while (_body.size() < _length && millis() < deadline) {
+    const size_t len = _filler(chunk, std::min(sizeof(chunk), _length - _body.size()), _body.size());
+
+    if (len == RESPONSE_TRY_AGAIN) {
+      delay(1);
+      continue;
+    } else if (len == 0) {
+      break;
+    }
+
+    _body.append(reinterpret_cast<char*>(chunk), len);
+  }
+
+  _filler = AwsResponseFiller();
+}
+
+////////============== Requests
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethod method, const String& url)
+  : _method(method)
+  , _url(url)
+  , _uploadChunkSize(0)
+{ }
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+  if (_onDisconnect) {
+    _onDisconnect();
+  }
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) {
+  for (size_t i = 0; i < _params.size(); ++i) {
+    if (_params[i].name() == name) {
+      return &_params[i];
+    }
+  }
+  return NULL;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) {
+  for (size_t i = 0; i < _headers.size(); ++i) {
+    if (_headers[i].name().equalsIgnoreCase(name)) {
+      return &_headers[i];
+    }
+  }
+  return NULL;
+}
+
+bool AsyncWebServerRequest::authenticate(const char* username, const char* password) {
+  return _username == username && _password == password;
+}
+
+void AsyncWebServerRequest::requestAuthentication() {
+  AsyncWebServerResponse* response = beginResponse(401);
+  response->addHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+  send(response);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType, const String& content) {
+  _pending.emplace_back(new AsyncWebServerResponse(code, contentType, content));
+  return _pending.back().get();
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(const String& contentType, size_t length, AwsResponseFiller filler) {
+  _pending.emplace_back(new AsyncWebServerResponse(contentType, length, filler));
+  return _pending.back().get();
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String& contentType, AwsResponseFiller filler) {
+  _pending.emplace_back(new AsyncWebServerResponse(contentType, SIZE_MAX, filler));
+  return _pending.back().get();
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response) {
+  // Like the real server, the first response sent is the one that goes out
+  if (_response) {
+    return;
+  }
+
+  for (auto it = _pending.begin(); it != _pending.end(); ++it) {
+    if (it->get() == response) {
+      _response = std::move(*it);
+      _pending.erase(it);
+      return;
+    }
+  }
+}
+
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content) {
+  send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(FS& fs, const String& path, const String& contentType, bool download) {
+  File file = fs.open(path, FILE_READ);
+
+  if (! file) {
+    send(404);
+    return;
+  }
+
+  std::string contents(file.size(), 0);
+  file.read(reinterpret_cast<uint8_t*>(&contents[0]), contents.size());
+
+  send(beginResponse(200, contentType, String(contents)));
+}
+
+void AsyncWebServerRequest::addParam(const String& name, const String& value) {
+  _params.push_back(AsyncWebParameter(name, value));
+}
+
+void AsyncWebServerRequest::addHeader(const String& name, const String& value) {
+  _headers.push_back(AsyncWebHeader(name, value));
+}
+
+void AsyncWebServerRequest::setCredentials(const String& username, const String& password) {
+  _username = username;
+  _password = password;
+}
+
+void AsyncWebServerRequest::setBody(const std::string& body) {
+  _body = body;
+}
+
+void AsyncWebServerRequest::setUpload(const String& filename, const std::string& file, size_t chunkSize) {
+  _uploadFilename = filename;
+  _upload = file;
+  _uploadChunkSize = chunkSize;
+}
+
+////////============== Server
+
+AsyncWebServer::~AsyncWebServer() {
+  if (activeServer == this) {
+    activeServer = NULL;
+  }
+}
+
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler) {
+  handlers.push_back(handler);
+  return *handler;
+}
+
+void AsyncWebServer::begin() {
+  activeServer = this;
+}
+
+void AsyncWebServer::handle(AsyncWebServerRequest& request) {
+  AsyncWebHandler* handler = NULL;
+
+  for (size_t i = 0; i < handlers.size() && handler == NULL; ++i) {
+    if (handlers[i]->canHandle(&request)) {
+      handler = handlers[i];
+    }
+  }
+
+  if (handler == NULL) {
+    request.send(404);
+    return;
+  }
+
+  if (request.uploadFilename().length() > 0) {
+    std::string file = request.upload();
+    const size_t chunkSize = request.uploadChunkSize() > 0 ? request.uploadChunkSize() : file.size();
+    size_t index = 0;
+
+    // An empty file is still one (final) call
+    do {
+      const size_t len = std::min(chunkSize, file.size() - index);
+      uint8_t* data = reinterpret_cast<uint8_t*>(&file[0]) + index;
+
+      handler->handleUpload(&request, request.uploadFilename(), index, data, len, index + len == file.size());
+      index += len;
+    } while (index < file.size());
+  } else if (request.body().size() > 0) {
+    std::string body = request.body();
+    handler->handleBody(&request, reinterpret_cast<uint8_t*>(&body[0]), body.size(), 0, body.size());
+  }
+
+  handler->handleRequest(&request);
+}
+
+////////============== WebSockets
+
+void AsyncWebSocketClient::binary(AsyncWebSocketMessageBuffer* buffer) {
+  if (_status != WS_CONNECTED) {
+    return;
+  }
+
+  // Sent straight away, so the message lets go of the buffer again
+  buffer->lock();
+  binaries.push_back(std::string(reinterpret_cast<char*>(buffer->get()), buffer->length()));
+  buffer->unlock();
+
+  if (onBinary) {
+    onBinary();
+  }
+}
+
+AsyncWebSocketClient* AsyncWebSocket::client(uint32_t id) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  auto it = clients.find(id);
+  return it != clients.end() ? it->second.get() : NULL;
+}
+
+AsyncWebSocketMessageBuffer* AsyncWebSocket::makeBuffer(size_t size) {
+  std::lock_guard<std::mutex> guard(lock);
+
+  buffers.emplace_back(new AsyncWebSocketMessageBuffer(size));
+  return buffers.back().get();
+}
+
+void AsyncWebSocket::_cleanBuffers() {
+  std::lock_guard<std::mutex> guard(lock);
+
+  for (auto it = buffers.begin(); it != buffers.end(); ) {
+    if ((*it)->canDelete()) {
+      it = buffers.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+AsyncWebSocketClient* AsyncWebSocket::connect() {
+  AsyncWebSocketClient* client;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    client = new AsyncWebSocketClient(this, nextId++);
+    clients[client->id()].reset(client);
+  }
+
+  if (handler) {
+    handler(this, client, WS_EVT_CONNECT, NULL, NULL, 0);
+  }
+
+  return client;
+}
+
+void AsyncWebSocket::disconnect(AsyncWebSocketClient* client) {
+  std::unique_ptr<AsyncWebSocketClient> removed;
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+
+    client->_status = WS_DISCONNECTED;
+    removed = std::move(clients[client->id()]);
+    clients.erase(client->id());
+  }
+
+  if (handler) {
+    handler(this, client, WS_EVT_DISCONNECT, NULL, NULL, 0);
+  }
+}
+
+size_t AsyncWebSocket::bufferCount() {
+  std::lock_guard<std::mutex> guard(lock);
+  return buffers.size();
+}
+
+void AsyncWebSocket::receiveText(AsyncWebSocketClient* client, const char* message) {
+  const size_t len = strlen(message);
+  std::string data(message);
+
+  AwsFrameInfo info;
+  memset(&info, 0, sizeof(info));
+  info.message_opcode = WS_TEXT;
+  info.opcode = WS_TEXT;
+  info.final = 1;
+  info.len = len;
+  info.index = 0;
+
+  if (handler) {
+    handler(this, client, WS_EVT_DATA, &info, reinterpret_cast<uint8_t*>(&data[0]), len);
+  }
+}
+
+namespace Fake {
+  namespace Http {
+    void perform(AsyncWebServerRequest& request) {
+      if (activeServer == NULL) {
+        request.send(503);
+        return;
+      }
+
+      activeServer->handle(request);
+
+      if (request.response() != NULL) {
+        request.response()->drain();
+      }
+    }
+  }
+}
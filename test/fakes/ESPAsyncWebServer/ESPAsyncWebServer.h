@@ -0,0 +1,288 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _FAKE_ESP_ASYNC_WEB_SERVER_H
+#define _FAKE_ESP_ASYNC_WEB_SERVER_H
+
+// Host stand-in for ESPAsyncWebServer.  There's no network: tests build
+// requests, hand them to the running server with Fake::Http::perform(), and
+// read back what was sent.  Responses with a filler are drained into a string.
+
+// Returned by a response filler that has nothing to send yet
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
+typedef std::function<void(void)> ArDisconnectHandler;
+
+enum WebRequestMethod {
+  HTTP_GET     = 0b00000001,
+  HTTP_POST    = 0b00000010,
+  HTTP_DELETE  = 0b00000100,
+  HTTP_PUT     = 0b00001000,
+  HTTP_PATCH   = 0b00010000,
+  HTTP_HEAD    = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY     = 0b01111111,
+};
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String& name, const String& value) : _name(name), _value(value) { }
+
+  const String& name() const { return _name; }
+  const String& value() const { return _value; }
+
+private:
+  String _name;
+  String _value;
+};
+
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String& name, const String& value) : _name(name), _value(value) { }
+
+  const String& name() const { return _name; }
+  const String& value() const { return _value; }
+
+private:
+  String _name;
+  String _value;
+};
+
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String& contentType, const String& content);
+  AsyncWebServerResponse(const String& contentType, size_t length, AwsResponseFiller filler);
+
+  void setCode(int code) { _code = code; }
+  void addHeader(const String& name, const String& value);
+
+  // Test controls
+  int code() const { return _code; }
+  const String& contentType() const { return _contentType; }
+  const std::string& body() const { return _body; }
+  // NULL if the header wasn't added
+  const AsyncWebHeader* header(const char* name) const;
+  // Runs the filler to completion, like the TCP task would
+  void drain();
+
+private:
+  int _code;
+  String _contentType;
+  std::string _body;
+  std::vector<AsyncWebHeader> _headers;
+  AwsResponseFiller _filler;
+  // SIZE_MAX for chunked responses
+  size_t _length;
+};
+
+class AsyncWebServerRequest {
+public:
+  AsyncWebServerRequest(WebRequestMethod method, const String& url);
+  // However the request ends, the disconnect handler runs when it's freed
+  ~AsyncWebServerRequest();
+
+  WebRequestMethod method() const { return _method; }
+  const String& url() const { return _url; }
+
+  AsyncWebParameter* getParam(const String& name, bool post = false, bool file = false);
+  bool hasParam(const String& name) { return getParam(name) != NULL; }
+  AsyncWebHeader* getHeader(const String& name);
+  bool hasHeader(const String& name) { return getHeader(name) != NULL; }
+
+  void onDisconnect(ArDisconnectHandler fn) { _onDisconnect = fn; }
+
+  bool authenticate(const char* username, const char* password);
+  void requestAuthentication();
+
+  AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(), const String& content = String());
+  AsyncWebServerResponse* beginResponse(const String& contentType, size_t length, AwsResponseFiller filler);
+  AsyncWebServerResponse* beginChunkedResponse(const String& contentType, AwsResponseFiller filler);
+
+  void send(AsyncWebServerResponse* response);
+  void send(int code, const String& contentType = String(), const String& content = String());
+  void send(FS& fs, const String& path, const String& contentType = String(), bool download = false);
+
+  // Test controls
+  void addParam(const String& name, const String& value);
+  void addHeader(const String& name, const String& value);
+  void setCredentials(const String& username, const String& password);
+  void setBody(const std::string& body);
+  // Sends file as a multipart upload, handed to the server chunkSize bytes
+  // at a time
+  void setUpload(const String& filename, const std::string& file, size_t chunkSize);
+
+  const String& uploadFilename() const { return _uploadFilename; }
+  const std::string& upload() const { return _upload; }
+  size_t uploadChunkSize() const { return _uploadChunkSize; }
+  const std::string& body() const { return _body; }
+
+  // The response sent, or NULL if nothing has been
+  AsyncWebServerResponse* response() const { return _response.get(); }
+
+private:
+  WebRequestMethod _method;
+  String _url;
+  std::vector<AsyncWebParameter> _params;
+  std::vector<AsyncWebHeader> _headers;
+  String _username;
+  String _password;
+  std::string _body;
+  String _uploadFilename;
+  std::string _upload;
+  size_t _uploadChunkSize;
+  ArDisconnectHandler _onDisconnect;
+  std::unique_ptr<AsyncWebServerResponse> _response;
+  // Built but not sent
+  std::vector<std::unique_ptr<AsyncWebServerResponse>> _pending;
+};
+
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() { }
+
+  virtual bool canHandle(AsyncWebServerRequest* request) { return false; }
+  virtual void handleRequest(AsyncWebServerRequest* request) { }
+  virtual void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final) { }
+  virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) { }
+};
+
+class AsyncWebServer {
+public:
+  AsyncWebServer(uint16_t port) : port(port) { }
+  virtual ~AsyncWebServer();
+
+  AsyncWebHandler& addHandler(AsyncWebHandler* handler);
+  // Makes this the server Fake::Http::perform() sends requests to
+  void begin();
+
+  // Test controls
+  uint16_t getPort() const { return port; }
+  void handle(AsyncWebServerRequest& request);
+
+private:
+  uint16_t port;
+  std::vector<AsyncWebHandler*> handlers;
+};
+
+////////============== WebSockets
+
+enum AwsClientStatus { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING };
+enum AwsFrameType { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG };
+enum AwsEventType { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA };
+
+struct AwsFrameInfo {
+  uint8_t message_opcode;
+  uint32_t num;
+  uint8_t final;
+  uint8_t masked;
+  uint8_t opcode;
+  uint64_t len;
+  uint8_t mask[4];
+  uint64_t index;
+};
+
+class AsyncWebSocket;
+
+// Held by each message it's queued in, and only freed by
+// AsyncWebSocket::_cleanBuffers() once none is left
+class AsyncWebSocketMessageBuffer {
+public:
+  AsyncWebSocketMessageBuffer(size_t size) : data(size), count(0) { }
+
+  uint8_t* get() { return data.data(); }
+  size_t length() const { return data.size(); }
+
+  void lock() { ++count; }
+  void unlock() { if (count > 0) --count; }
+  bool canDelete() const { return count == 0; }
+
+private:
+  std::vector<uint8_t> data;
+  uint32_t count;
+};
+
+class AsyncWebSocketClient {
+public:
+  AsyncWebSocketClient(AsyncWebSocket* server, uint32_t id) : server(server), _id(id), _status(WS_CONNECTED), queueFull(false) { }
+
+  uint32_t id() const { return _id; }
+  AwsClientStatus status() const { return _status; }
+  bool queueIsFull() const { return queueFull; }
+
+  void text(const char* message) { texts.push_back(message); }
+  void text(const String& message) { texts.push_back(message.c_str()); }
+  void binary(AsyncWebSocketMessageBuffer* buffer);
+
+  // Test controls
+  void setQueueFull(bool full) { queueFull = full; }
+  // Called with each binary message as it's sent
+  std::function<void(void)> onBinary;
+  // Messages sent to this client, oldest first
+  std::vector<std::string> texts;
+  std::vector<std::string> binaries;
+
+private:
+  friend class AsyncWebSocket;
+
+  AsyncWebSocket* server;
+  uint32_t _id;
+  // Set by disconnect(), whichever thread that's on
+  std::atomic<AwsClientStatus> _status;
+  bool queueFull;
+};
+
+typedef std::function<void(AsyncWebSocket*, AsyncWebSocketClient*, AwsEventType, void*, uint8_t*, size_t)> AwsEventHandler;
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+  AsyncWebSocket(const String& url) : url(url), nextId(1) { }
+
+  void onEvent(AwsEventHandler handler) { this->handler = handler; }
+  void setAuthentication(const char* username, const char* password) { this->username = username; this->password = password; }
+
+  AsyncWebSocketClient* client(uint32_t id);
+  AsyncWebSocketMessageBuffer* makeBuffer(size_t size);
+  void _cleanBuffers();
+
+  // Test controls
+  AsyncWebSocketClient* connect();
+  // As when the TCP connection drops: the client leaves the list, then the
+  // disconnect event is raised from its destructor.  Safe from any thread.
+  void disconnect(AsyncWebSocketClient* client);
+  size_t bufferCount();
+  // Delivers message as a single unfragmented text frame
+  void receiveText(AsyncWebSocketClient* client, const char* message);
+  const String& getUsername() const { return username; }
+
+private:
+  String url;
+  String username;
+  String password;
+  AwsEventHandler handler;
+  uint32_t nextId;
+  // Guards clients and buffers
+  std::mutex lock;
+  std::map<uint32_t, std::unique_ptr<AsyncWebSocketClient>> clients;
+  std::vector<std::unique_ptr<AsyncWebSocketMessageBuffer>> buffers;
+};
+
+// Test controls
+namespace Fake {
+  namespace Http {
+    // Hands request to the server that last called begin(): uploads and
+    // bodies first, then the request handler, then drains whatever was sent
+    void perform(AsyncWebServerRequest& request);
+  }
+}
+
+#endif
@@ -0,0 +1,376 @@
+#include <FS.h>
+#include <SPIFFS.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+SPIFFSFS SPIFFS;
+
+// Matches the min_spiffs partition the firmware is built with
+static const size_t DEFAULT_CAPACITY = 0x30000;
+
+namespace Fake {
+  namespace Fs {
+    struct Node {
+      std::vector<uint8_t> bytes;
+    };
+
+    struct OpenFile {
+      std::string path;
+      std::shared_ptr<Node> node;
+      size_t pos;
+      bool readable;
+      bool writable;
+      bool append;
+
+      // Directories only
+      bool directory;
+      std::vector<std::string> entries;
+      size_t nextEntry;
+    };
+  }
+}
+
+using Fake::Fs::Node;
+using Fake::Fs::OpenFile;
+
+namespace {
+  std::recursive_mutex mutex;
+  std::map<std::string, std::shared_ptr<Node>> files;
+  size_t capacity = DEFAULT_CAPACITY;
+
+  size_t usedBytes() {
+    size_t used = 0;
+
+    for (std::map<std::string, std::shared_ptr<Node>>::const_iterator it = files.begin(); it != files.end(); ++it) {
+      used += it->second->bytes.size();
+    }
+
+    return used;
+  }
+
+  bool startsWith(const std::string& str, const std::string& prefix) {
+    return str.compare(0, prefix.size(), prefix) == 0;
+  }
+
+  bool isDirectory(const std::string& path) {
+    if (path == "/") {
+      return true;
+    }
+
+    for (std::map<std::string, std::shared_ptr<Node>>::const_iterator it = files.begin(); it != files.end(); ++it) {
+      if (it->first != path && startsWith(it->first, path)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
+
+File::File() { }
+
+File::File(std::shared_ptr<OpenFile> impl)
+  : impl(impl)
+{ }
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (! impl || ! impl->writable) {
+    return 0;
+  }
+
+  std::vector<uint8_t>& bytes = impl->node->bytes;
+
+  if (impl->append) {
+    impl->pos = bytes.size();
+  }
+
+  // Only growth counts against the capacity
+  const size_t used = ::usedBytes();
+  const size_t spare = capacity > used ? capacity - used : 0;
+  const size_t growth = impl->pos + size > bytes.size() ? impl->pos + size - bytes.size() : 0;
+  const size_t toWrite = growth > spare ? size - (growth - spare) : size;
+
+  if (impl->pos + toWrite > bytes.size()) {
+    bytes.resize(impl->pos + toWrite);
+  }
+  std::copy(buf, buf + toWrite, bytes.begin() + impl->pos);
+  impl->pos += toWrite;
+
+  return toWrite;
+}
+
+size_t File::print(const char* str) {
+  return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+size_t File::print(const String& str) {
+  return write(reinterpret_cast<const uint8_t*>(str.c_str()), str.length());
+}
+
+int File::available() {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (! impl || ! impl->readable) {
+    return 0;
+  }
+  return impl->node->bytes.size() - std::min(impl->pos, impl->node->bytes.size());
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (available() <= 0) {
+    return -1;
+  }
+  return impl->node->bytes[impl->pos];
+}
+
+void File::flush() { }
+
+size_t File::read(uint8_t* buf, size_t size) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  const size_t toRead = std::min(size, static_cast<size_t>(available()));
+
+  if (toRead > 0) {
+    memcpy(buf, impl->node->bytes.data() + impl->pos, toRead);
+    impl->pos += toRead;
+  }
+
+  return toRead;
+}
+
+size_t File::readBytes(char* buffer, size_t length) {
+  return read(reinterpret_cast<uint8_t*>(buffer), length);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if (! impl || impl->directory) {
+    return false;
+  }
+
+  size_t target;
+  switch (mode) {
+    case SeekCur:
+      target = impl->pos + pos;
+      break;
+    case SeekEnd:
+      target = impl->node->bytes.size() + pos;
+      break;
+    case SeekSet:
+    default:
+      target = pos;
+      break;
+  }
+
+  if (target > impl->node->bytes.size()) {
+    return false;
+  }
+
+  impl->pos = target;
+  return true;
+}
+
+size_t File::position() const {
+  return impl ? impl->pos : 0;
+}
+
+size_t File::size() const {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return impl && impl->node ? impl->node->bytes.size() : 0;
+}
+
+void File::close() {
+  impl.reset();
+}
+
+File::operator bool() const {
+  return static_cast<bool>(impl);
+}
+
+const char* File::name() const {
+  return impl ? impl->path.c_str() : NULL;
+}
+
+bool File::isDirectory() {
+  return impl && impl->directory;
+}
+
+File File::openNextFile(const char* mode) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  while (impl && impl->directory && impl->nextEntry < impl->entries.size()) {
+    File file = SPIFFS.open(impl->entries[impl->nextEntry++].c_str(), mode);
+
+    // Skip anything removed since the directory was opened
+    if (file) {
+      return file;
+    }
+  }
+
+  return File();
+}
+
+void File::rewindDirectory() {
+  if (impl) {
+    impl->nextEntry = 0;
+  }
+}
+
+File FS::open(const char* path, const char* mode) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  std::shared_ptr<OpenFile> file = std::make_shared<OpenFile>();
+  file->path = path;
+  file->pos = 0;
+  file->readable = mode[0] == 'r' || mode[1] == '+';
+  file->writable = mode[0] != 'r' || mode[1] == '+';
+  file->append = mode[0] == 'a';
+  file->directory = false;
+  file->nextEntry = 0;
+
+  std::map<std::string, std::shared_ptr<Node>>::iterator it = files.find(path);
+
+  if (mode[0] == 'r') {
+    if (it != files.end()) {
+      file->node = it->second;
+    } else if (mode[1] != '+' && isDirectory(path)) {
+      file->directory = true;
+      file->readable = false;
+
+      for (it = files.begin(); it != files.end(); ++it) {
+        if (startsWith(it->first, file->path == "/" ? "" : file->path)) {
+          file->entries.push_back(it->first);
+        }
+      }
+    } else {
+      return File();
+    }
+  } else if (mode[0] == 'w' || it == files.end()) {
+    file->node = std::make_shared<Node>();
+    files[path] = file->node;
+  } else {
+    file->node = it->second;
+  }
+
+  return File(file);
+}
+
+File FS::open(const String& path, const char* mode) {
+  return open(path.c_str(), mode);
+}
+
+bool FS::exists(const char* path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return files.count(path) > 0;
+}
+
+bool FS::exists(const String& path) {
+  return exists(path.c_str());
+}
+
+bool FS::remove(const char* path) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return files.erase(path) > 0;
+}
+
+bool FS::remove(const String& path) {
+  return remove(path.c_str());
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  std::map<std::string, std::shared_ptr<Node>>::iterator from = files.find(pathFrom);
+
+  if (from == files.end() || files.count(pathTo) > 0) {
+    return false;
+  }
+
+  files[pathTo] = from->second;
+  files.erase(from);
+  return true;
+}
+
+bool FS::rename(const String& pathFrom, const String& pathTo) {
+  return rename(pathFrom.c_str(), pathTo.c_str());
+}
+
+bool SPIFFSFS::begin(bool formatOnFail, const char* basePath, uint8_t maxOpenFiles) {
+  return true;
+}
+
+bool SPIFFSFS::format() {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  files.clear();
+  return true;
+}
+
+size_t SPIFFSFS::totalBytes() {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return capacity;
+}
+
+size_t SPIFFSFS::usedBytes() {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  return ::usedBytes();
+}
+
+void SPIFFSFS::end() { }
+
+namespace Fake {
+  namespace Fs {
+    void reset() {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      files.clear();
+      ::capacity = DEFAULT_CAPACITY;
+    }
+
+    void setCapacity(size_t bytes) {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      ::capacity = bytes;
+    }
+
+    size_t capacity() {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      return ::capacity;
+    }
+
+    size_t usedBytes() {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      return ::usedBytes();
+    }
+
+    std::string contents(const char* path) {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      std::map<std::string, std::shared_ptr<Node>>::const_iterator it = files.find(path);
+
+      if (it == files.end()) {
+        return std::string();
+      }
+      return std::string(it->second->bytes.begin(), it->second->bytes.end());
+    }
+
+    void setContents(const char* path, const std::string& contents) {
+      std::lock_guard<std::recursive_mutex> lock(mutex);
+      std::shared_ptr<Node> node = std::make_shared<Node>();
+      node->bytes.assign(contents.begin(), contents.end());
+      files[path] = node;
+    }
+  }
+}
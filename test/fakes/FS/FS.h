@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <memory>
+
+#ifndef _FAKE_FS_H
+#define _FAKE_FS_H
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode {
+  SeekSet = 0,
+  SeekCur = 1,
+  SeekEnd = 2
+};
+
+namespace Fake {
+  namespace Fs {
+    struct OpenFile;
+  }
+}
+
+class File {
+public:
+  File();
+  File(std::shared_ptr<Fake::Fs::OpenFile> impl);
+
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buf, size_t size);
+  size_t print(const char* str);
+  size_t print(const String& str);
+  int available();
+  int read();
+  int peek();
+  void flush();
+  size_t read(uint8_t* buf, size_t size);
+  size_t readBytes(char* buffer, size_t length);
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const;
+  const char* name() const;
+
+  bool isDirectory();
+  File openNextFile(const char* mode = FILE_READ);
+  void rewindDirectory();
+
+private:
+  std::shared_ptr<Fake::Fs::OpenFile> impl;
+};
+
+// Flat, in-memory file system with SPIFFS's quirks: there are no real
+// directories, and listing one matches every path that starts with its name.
+class FS {
+public:
+  File open(const char* path, const char* mode = FILE_READ);
+  File open(const String& path, const char* mode = FILE_READ);
+  bool exists(const char* path);
+  bool exists(const String& path);
+  bool remove(const char* path);
+  bool remove(const String& path);
+  bool rename(const char* pathFrom, const char* pathTo);
+  bool rename(const String& pathFrom, const String& pathTo);
+};
+
+namespace Fake {
+  namespace Fs {
+    // Removes every file and restores the default capacity
+    void reset();
+
+    // Writes that would take usage past this are cut short
+    void setCapacity(size_t bytes);
+    size_t capacity();
+    size_t usedBytes();
+
+    // Contents of a file, or an empty string if there isn't one
+    std::string contents(const char* path);
+    void setContents(const char* path, const std::string& contents);
+  }
+}
+
+#endif
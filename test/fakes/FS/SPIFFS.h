@@ -0,0 +1,17 @@
+#include <FS.h>
+
+#ifndef _FAKE_SPIFFS_H
+#define _FAKE_SPIFFS_H
+
+class SPIFFSFS : public FS {
+public:
+  bool begin(bool formatOnFail = false, const char* basePath = "/spiffs", uint8_t maxOpenFiles = 10);
+  bool format();
+  size_t totalBytes();
+  size_t usedBytes();
+  void end();
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif
@@ -0,0 +1,17 @@
+#include <stdint.h>
+
+#ifndef _FAKE_FREERTOS_CONTROLS_H
+#define _FAKE_FREERTOS_CONTROLS_H
+
+// Test controls for the FreeRTOS fake
+namespace Fake {
+  namespace FreeRtos {
+    // Time spent blocked in xSemaphoreTake(), and how many takes had to
+    // block, since the last reset
+    uint64_t semaphoreWaitMicros();
+    uint32_t semaphoreWaits();
+    void resetCounters();
+  }
+}
+
+#endif
@@ -0,0 +1,320 @@
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <FakeFreeRTOS.h>
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const Clock::time_point startedAt = Clock::now();
+
+  struct Task {
+    Task(const char* name)
+      : notifications(0)
+    {
+      strncpy(this->name, name, sizeof(this->name) - 1);
+      this->name[sizeof(this->name) - 1] = 0;
+    }
+
+    char name[configMAX_TASK_NAME_LEN];
+    std::mutex mutex;
+    std::condition_variable notified;
+    uint32_t notifications;
+  };
+
+  struct Semaphore {
+    Semaphore(UBaseType_t maxCount, UBaseType_t count)
+      : maxCount(maxCount)
+      , count(count)
+    { }
+
+    std::mutex mutex;
+    std::condition_variable available;
+    const UBaseType_t maxCount;
+    UBaseType_t count;
+  };
+
+  struct Queue {
+    Queue(UBaseType_t length, UBaseType_t itemSize)
+      : length(length)
+      , itemSize(itemSize)
+    { }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    const UBaseType_t length;
+    const UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+  };
+
+  // Tasks live as long as the process, like the firmware's do
+  thread_local Task* currentTask = NULL;
+
+  std::recursive_mutex criticalSection;
+
+  std::atomic<uint64_t> semaphoreWaitMicros(0);
+  std::atomic<uint32_t> semaphoreWaits(0);
+
+  // Waits on cv until ready() holds or ticks pass.  Returns ready().
+  template <typename Predicate>
+  bool waitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+      cv.wait(lock, ready);
+      return true;
+    }
+
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), ready);
+  }
+
+  struct TaskStart {
+    TaskFunction_t function;
+    void* parameters;
+    Task* task;
+  };
+}
+
+extern "C" {
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+  criticalSection.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+  criticalSection.unlock();
+}
+
+BaseType_t xTaskCreate(
+  TaskFunction_t function,
+  const char* name,
+  uint32_t stackDepth,
+  void* parameters,
+  UBaseType_t priority,
+  TaskHandle_t* createdTask
+) {
+  Task* task = new Task(name);
+  TaskStart start = { function, parameters, task };
+
+  if (createdTask != NULL) {
+    *createdTask = task;
+  }
+
+  std::thread([start]() {
+    currentTask = start.task;
+    start.function(start.parameters);
+  }).detach();
+
+  return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(
+  TaskFunction_t function,
+  const char* name,
+  uint32_t stackDepth,
+  void* parameters,
+  UBaseType_t priority,
+  TaskHandle_t* createdTask,
+  BaseType_t coreId
+) {
+  return xTaskCreate(function, name, stackDepth, parameters, priority, createdTask);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  if (currentTask == NULL) {
+    currentTask = new Task("host");
+  }
+  return currentTask;
+}
+
+char* pcTaskGetTaskName(TaskHandle_t task) {
+  if (task == NULL) {
+    task = xTaskGetCurrentTaskHandle();
+  }
+  return static_cast<Task*>(task)->name;
+}
+
+BaseType_t xTaskGetSchedulerState() {
+  return taskSCHEDULER_RUNNING;
+}
+
+BaseType_t xPortGetCoreID() {
+  return 0;
+}
+
+TickType_t xTaskGetTickCount() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - startedAt).count() / portTICK_PERIOD_MS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t period) {
+  *previousWakeTime += period;
+  const TickType_t now = xTaskGetTickCount();
+
+  if (static_cast<int32_t>(*previousWakeTime - now) > 0) {
+    vTaskDelay(*previousWakeTime - now);
+  }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  Task* task = static_cast<Task*>(xTaskGetCurrentTaskHandle());
+  std::unique_lock<std::mutex> lock(task->mutex);
+
+  waitFor(task->notified, lock, ticksToWait, [task]() { return task->notifications > 0; });
+
+  const uint32_t value = task->notifications;
+  if (value > 0) {
+    task->notifications = clearCountOnExit ? 0 : value - 1;
+  }
+
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+  Task* task = static_cast<Task*>(handle);
+  {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+  }
+  task->notified.notify_all();
+
+  return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new Semaphore(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return new Semaphore(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  return new Semaphore(maxCount, initialCount);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  delete static_cast<Semaphore*>(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t handle, TickType_t ticksToWait) {
+  Semaphore* semaphore = static_cast<Semaphore*>(handle);
+  std::unique_lock<std::mutex> lock(semaphore->mutex);
+
+  if (semaphore->count == 0) {
+    if (ticksToWait == 0) {
+      return pdFALSE;
+    }
+
+    const Clock::time_point waitStart = Clock::now();
+    const bool taken = waitFor(semaphore->available, lock, ticksToWait, [semaphore]() { return semaphore->count > 0; });
+
+    semaphoreWaits++;
+    semaphoreWaitMicros += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - waitStart).count();
+
+    if (! taken) {
+      return pdFALSE;
+    }
+  }
+
+  semaphore->count--;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t handle) {
+  Semaphore* semaphore = static_cast<Semaphore*>(handle);
+  {
+    std::lock_guard<std::mutex> lock(semaphore->mutex);
+
+    if (semaphore->count >= semaphore->maxCount) {
+      return pdFALSE;
+    }
+    semaphore->count++;
+  }
+  semaphore->available.notify_one();
+
+  return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t handle) {
+  Semaphore* semaphore = static_cast<Semaphore*>(handle);
+  std::lock_guard<std::mutex> lock(semaphore->mutex);
+  return semaphore->count;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return new Queue(length, itemSize);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete static_cast<Queue*>(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void* item, TickType_t ticksToWait) {
+  Queue* queue = static_cast<Queue*>(handle);
+  std::unique_lock<std::mutex> lock(queue->mutex);
+
+  if (! waitFor(queue->changed, lock, ticksToWait, [queue]() { return queue->items.size() < queue->length; })) {
+    return pdFALSE;
+  }
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(item);
+  queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+  lock.unlock();
+  queue->changed.notify_all();
+
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void* buffer, TickType_t ticksToWait) {
+  Queue* queue = static_cast<Queue*>(handle);
+  std::unique_lock<std::mutex> lock(queue->mutex);
+
+  if (! waitFor(queue->changed, lock, ticksToWait, [queue]() { return ! queue->items.empty(); })) {
+    return pdFALSE;
+  }
+
+  memcpy(buffer, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  lock.unlock();
+  queue->changed.notify_all();
+
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+  Queue* queue = static_cast<Queue*>(handle);
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  return queue->items.size();
+}
+
+}
+
+namespace Fake {
+  namespace FreeRtos {
+    uint64_t semaphoreWaitMicros() {
+      return ::semaphoreWaitMicros;
+    }
+
+    uint32_t semaphoreWaits() {
+      return ::semaphoreWaits;
+    }
+
+    void resetCounters() {
+      ::semaphoreWaitMicros = 0;
+      ::semaphoreWaits = 0;
+    }
+  }
+}
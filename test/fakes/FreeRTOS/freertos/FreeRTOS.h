@@ -0,0 +1,53 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef _FAKE_FREERTOS_H
+#define _FAKE_FREERTOS_H
+
+// Host stand-in for ESP-IDF's FreeRTOS.  Tasks are threads, ticks are
+// milliseconds, and semaphores, queues and notifications block for real, so
+// code that hands work between tasks behaves as it does on the device.
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE ((BaseType_t) 1)
+#define pdFALSE ((BaseType_t) 0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t) 1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms) * configTICK_RATE_HZ / 1000)
+
+#define configMAX_PRIORITIES 25
+#define configMAX_TASK_NAME_LEN 16
+#define tskNO_AFFINITY 0x7fffffff
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint32_t owner;
+  uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0, 0 }
+
+// One lock shared by every critical section
+void vPortEnterCritical(portMUX_TYPE* mux);
+void vPortExitCritical(portMUX_TYPE* mux);
+
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
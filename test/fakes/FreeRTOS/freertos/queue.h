@@ -0,0 +1,23 @@
+#include "FreeRTOS.h"
+
+#ifndef _FAKE_FREERTOS_QUEUE_H
+#define _FAKE_FREERTOS_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void* QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* buffer, TickType_t ticksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,27 @@
+#include "FreeRTOS.h"
+
+#ifndef _FAKE_FREERTOS_SEMPHR_H
+#define _FAKE_FREERTOS_SEMPHR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void* SemaphoreHandle_t;
+
+// Mutexes are counting semaphores with a count of one: they aren't recursive
+// and don't track their owner
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
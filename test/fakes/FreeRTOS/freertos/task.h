@@ -0,0 +1,54 @@
+#include "FreeRTOS.h"
+
+#ifndef _FAKE_FREERTOS_TASK_H
+#define _FAKE_FREERTOS_TASK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define taskSCHEDULER_SUSPENDED ((BaseType_t) 0)
+#define taskSCHEDULER_NOT_STARTED ((BaseType_t) 1)
+#define taskSCHEDULER_RUNNING ((BaseType_t) 2)
+#define tskIDLE_PRIORITY ((UBaseType_t) 0U)
+
+// Starts a detached thread.  Stack size, priority and core are ignored.
+BaseType_t xTaskCreate(
+  TaskFunction_t task,
+  const char* name,
+  uint32_t stackDepth,
+  void* parameters,
+  UBaseType_t priority,
+  TaskHandle_t* createdTask
+);
+BaseType_t xTaskCreatePinnedToCore(
+  TaskFunction_t task,
+  const char* name,
+  uint32_t stackDepth,
+  void* parameters,
+  UBaseType_t priority,
+  TaskHandle_t* createdTask,
+  BaseType_t coreId
+);
+
+// Threads that weren't started by xTaskCreate get a handle on first use
+TaskHandle_t xTaskGetCurrentTaskHandle();
+char* pcTaskGetTaskName(TaskHandle_t task);
+BaseType_t xTaskGetSchedulerState();
+BaseType_t xPortGetCoreID();
+
+TickType_t xTaskGetTickCount();
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t period);
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
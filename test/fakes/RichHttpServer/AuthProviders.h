@@ -0,0 +1,30 @@
+#include <Arduino.h>
+
+#ifndef _FAKE_AUTH_PROVIDERS_H
+#define _FAKE_AUTH_PROVIDERS_H
+
+class AuthProvider {
+public:
+  virtual ~AuthProvider() { }
+
+  virtual bool isAuthenticationEnabled() const = 0;
+  virtual const String& getUsername() const = 0;
+  virtual const String& getPassword() const = 0;
+};
+
+// Defers to a settings object with the same methods, so changes take effect
+// without rebuilding routes
+template <class T>
+class PassthroughAuthProvider : public AuthProvider {
+public:
+  PassthroughAuthProvider(T& settings) : settings(settings) { }
+
+  virtual bool isAuthenticationEnabled() const { return settings.isAuthenticationEnabled(); }
+  virtual const String& getUsername() const { return settings.getUsername(); }
+  virtual const String& getPassword() const { return settings.getPassword(); }
+
+private:
+  T& settings;
+};
+
+#endif
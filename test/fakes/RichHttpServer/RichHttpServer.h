@@ -0,0 +1,277 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <AuthProviders.h>
+#include <ESPAsyncWebServer.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _FAKE_RICH_HTTP_SERVER_H
+#define _FAKE_RICH_HTTP_SERVER_H
+
+#ifndef RICH_HTTP_REQUEST_BUFFER_SIZE
+#define RICH_HTTP_REQUEST_BUFFER_SIZE 4096
+#endif
+
+#ifndef RICH_HTTP_RESPONSE_BUFFER_SIZE
+#define RICH_HTTP_RESPONSE_BUFFER_SIZE 4096
+#endif
+
+// Host stand-in for rich_http_server on ESPAsyncWebServer, with the parts
+// handlers can observe kept the same:
+//
+//   - Each route pattern's :variables are bound by name.
+//   - A handler's response.json and code are sent once it returns, unless it
+//     already sent a response of its own.
+//   - What an upload callback puts in its response is thrown away.  Only the
+//     completion handler's response reaches the client.
+namespace RichHttp {
+  class UrlTokenBindings {
+  public:
+    // NULL if the pattern has no such variable
+    const char* get(const char* name) const {
+      for (size_t i = 0; i < bindings.size(); ++i) {
+        if (bindings[i].first == name) {
+          return bindings[i].second.c_str();
+        }
+      }
+      return NULL;
+    }
+
+    bool hasBinding(const char* name) const { return get(name) != NULL; }
+
+    // Binds pattern's variables to url's tokens.  Returns false if they
+    // don't match.
+    bool bind(const String& pattern, const String& url) {
+      std::vector<std::string> patternTokens = split(pattern.c_str());
+      std::vector<std::string> urlTokens = split(url.c_str());
+
+      bindings.clear();
+
+      if (patternTokens.size() != urlTokens.size()) {
+        return false;
+      }
+
+      for (size_t i = 0; i < patternTokens.size(); ++i) {
+        if (patternTokens[i][0] == ':') {
+          bindings.push_back(std::make_pair(patternTokens[i].substr(1), urlTokens[i]));
+        } else if (patternTokens[i] != urlTokens[i]) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+  private:
+    std::vector<std::pair<std::string, std::string>> bindings;
+
+    static std::vector<std::string> split(const std::string& path) {
+      std::vector<std::string> tokens;
+      size_t start = 0;
+
+      while (start < path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+          end = path.size();
+        }
+        if (end > start) {
+          tokens.push_back(path.substr(start, end - start));
+        }
+        start = end + 1;
+      }
+
+      return tokens;
+    }
+  };
+
+  struct UploadContext {
+    String filename;
+    size_t index;
+    uint8_t* data;
+    size_t length;
+    bool isFinal;
+  };
+
+  class ResponseContext {
+  public:
+    ResponseContext()
+      : doc(RICH_HTTP_RESPONSE_BUFFER_SIZE)
+      , json(doc.to<JsonObject>())
+      , code(200)
+    { }
+
+    void setCode(int code) { this->code = code; }
+    int getCode() const { return code; }
+
+  private:
+    DynamicJsonDocument doc;
+
+  public:
+    JsonObject json;
+
+  private:
+    int code;
+  };
+
+  template <class Config>
+  class RequestContext {
+  public:
+    RequestContext(AsyncWebServerRequest* rawRequest)
+      : rawRequest(rawRequest)
+      , upload()
+      , body(RICH_HTTP_REQUEST_BUFFER_SIZE)
+    { }
+
+    RequestContext(const RequestContext&) = delete;
+    RequestContext& operator=(const RequestContext&) = delete;
+
+    AsyncWebServerRequest* rawRequest;
+    UrlTokenBindings pathVariables;
+    ResponseContext response;
+    UploadContext upload;
+
+    JsonVariant getJsonBody() { return body.as<JsonVariant>(); }
+
+    // Test controls
+    DynamicJsonDocument body;
+  };
+
+  namespace Generics {
+    namespace Configs {
+      struct AsyncWebServer {
+        using ServerType = ::AsyncWebServer;
+        using RequestContextType = RequestContext<AsyncWebServer>;
+        using HandlerFn = std::function<void(RequestContextType&)>;
+      };
+    }
+  }
+}
+
+template <class Config>
+class RichHttpServer : public Config::ServerType {
+public:
+  using RequestContextType = typename Config::RequestContextType;
+  using HandlerFn = typename Config::HandlerFn;
+
+  class Handler : public AsyncWebHandler {
+  public:
+    Handler(const String& path, WebRequestMethod method, HandlerFn handler, HandlerFn uploadHandler, const AuthProvider& authProvider)
+      : path(path)
+      , method(method)
+      , handler(handler)
+      , uploadHandler(uploadHandler)
+      , authProvider(authProvider)
+    { }
+
+    virtual bool canHandle(AsyncWebServerRequest* request) {
+      RichHttp::UrlTokenBindings bindings;
+      return request->method() == method && bindings.bind(path, request->url());
+    }
+
+    virtual void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final) {
+      if (! uploadHandler || ! isAuthenticated(request)) {
+        return;
+      }
+
+      RequestContextType context(request);
+      context.pathVariables.bind(path, request->url());
+      context.upload.filename = filename;
+      context.upload.index = index;
+      context.upload.data = data;
+      context.upload.length = len;
+      context.upload.isFinal = final;
+
+      uploadHandler(context);
+    }
+
+    virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {
+      this->body.append(reinterpret_cast<char*>(data), len);
+    }
+
+    virtual void handleRequest(AsyncWebServerRequest* request) {
+      if (! isAuthenticated(request)) {
+        request->requestAuthentication();
+        return;
+      }
+
+      RequestContextType context(request);
+      context.pathVariables.bind(path, request->url());
+
+      if (body.size() > 0) {
+        deserializeJson(context.body, body.c_str(), body.size());
+        body.clear();
+      }
+
+      handler(context);
+
+      if (request->response() == NULL) {
+        String json;
+        serializeJson(context.response.json, json);
+        request->send(context.response.getCode(), "application/json", json);
+      }
+    }
+
+  private:
+    String path;
+    WebRequestMethod method;
+    HandlerFn handler;
+    HandlerFn uploadHandler;
+    const AuthProvider& authProvider;
+    std::string body;
+
+    bool isAuthenticated(AsyncWebServerRequest* request) {
+      return ! authProvider.isAuthenticationEnabled()
+        || request->authenticate(authProvider.getUsername().c_str(), authProvider.getPassword().c_str());
+    }
+  };
+
+  class Builder {
+  public:
+    Builder(RichHttpServer& server, const String& path) : server(server), path(path) { }
+
+    Builder& on(WebRequestMethod method, HandlerFn handler, HandlerFn uploadHandler = HandlerFn()) {
+      server.addRoute(new Handler(path, method, handler, uploadHandler, server.authProvider));
+      return *this;
+    }
+
+    // OTA updates aren't simulated.  The route answers like any other.
+    Builder& handleOTA() {
+      return on(HTTP_POST, [](RequestContextType& request) {
+        request.response.json["success"] = true;
+      });
+    }
+
+  private:
+    RichHttpServer& server;
+    String path;
+  };
+
+  RichHttpServer(uint16_t port, const AuthProvider& authProvider)
+    : Config::ServerType(port)
+    , authProvider(authProvider)
+  { }
+
+  Builder& buildHandler(const String& path) {
+    builders.emplace_back(new Builder(*this, path));
+    return *builders.back();
+  }
+
+  void clearBuilders() {
+    builders.clear();
+  }
+
+private:
+  const AuthProvider& authProvider;
+  std::vector<std::unique_ptr<Builder>> builders;
+  std::vector<std::shared_ptr<Handler>> routes;
+
+  void addRoute(Handler* handler) {
+    routes.push_back(std::shared_ptr<Handler>(handler));
+    this->addHandler(handler);
+  }
+};
+
+#endif
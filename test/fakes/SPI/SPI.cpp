@@ -0,0 +1,66 @@
+#include <SPI.h>
+
+#include <atomic>
+
+SPIClass SPI;
+
+namespace {
+  std::atomic<Fake::Spi::Device*> selected(NULL);
+  std::atomic<uint32_t> clockFrequency(1000000);
+  std::atomic<uint32_t> transferred(0);
+}
+
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss) { }
+
+void SPIClass::end() { }
+
+void SPIClass::setFrequency(uint32_t frequency) {
+  clockFrequency = frequency;
+}
+
+void SPIClass::beginTransaction(SPISettings settings) { }
+
+void SPIClass::endTransaction() { }
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  Fake::Spi::Device* device = selected;
+  transferred++;
+
+  return device != NULL ? device->transfer(data) : 0xFF;
+}
+
+void SPIClass::transferBytes(const uint8_t* data, uint8_t* out, uint32_t size) {
+  for (uint32_t i = 0; i < size; ++i) {
+    const uint8_t in = transfer(data != NULL ? data[i] : 0xFF);
+
+    if (out != NULL) {
+      out[i] = in;
+    }
+  }
+}
+
+namespace Fake {
+  namespace Spi {
+    void select(Device* device) {
+      selected = device;
+    }
+
+    void deselect(Device* device) {
+      Device* expected = device;
+      selected.compare_exchange_strong(expected, NULL);
+    }
+
+    uint32_t frequency() {
+      return clockFrequency;
+    }
+
+    uint32_t bytesTransferred() {
+      return transferred;
+    }
+
+    void reset() {
+      selected = NULL;
+      transferred = 0;
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#include <Arduino.h>
+
+#ifndef _FAKE_SPI_H
+#define _FAKE_SPI_H
+
+#define SPI_MODE0 0x00
+
+class SPISettings {
+public:
+  SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = 1, uint8_t dataMode = SPI_MODE0) { }
+};
+
+// Bytes go to whichever fake device has its chip select low (see
+// Fake::Spi::select()).  With none selected, reads return 0xFF.
+class SPIClass {
+public:
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1);
+  void end();
+  void setFrequency(uint32_t frequency);
+  void beginTransaction(SPISettings settings);
+  void endTransaction();
+
+  uint8_t transfer(uint8_t data);
+  void transferBytes(const uint8_t* data, uint8_t* out, uint32_t size);
+};
+
+extern SPIClass SPI;
+
+namespace Fake {
+  namespace Spi {
+    class Device {
+    public:
+      virtual ~Device() { }
+      virtual uint8_t transfer(uint8_t data) = 0;
+    };
+
+    void select(Device* device);
+    void deselect(Device* device);
+
+    uint32_t frequency();
+    // Bytes clocked since the last reset
+    uint32_t bytesTransferred();
+    void reset();
+  }
+}
+
+#endif
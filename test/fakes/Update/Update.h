@@ -0,0 +1,12 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef _FAKE_UPDATE_H
+#define _FAKE_UPDATE_H
+
+// Firmware updates aren't simulated.  This is here so code that includes the
+// core's Update library builds.
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+#endif
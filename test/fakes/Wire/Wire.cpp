@@ -0,0 +1,30 @@
+#include <Wire.h>
+
+TwoWire Wire;
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency) {
+  return true;
+}
+
+void TwoWire::beginTransmission(uint8_t address) { }
+
+// 2: address NACK
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  return 2;
+}
+
+size_t TwoWire::write(uint8_t data) {
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity) {
+  return 0;
+}
+
+int TwoWire::available() {
+  return 0;
+}
+
+int TwoWire::read() {
+  return -1;
+}
@@ -0,0 +1,20 @@
+#include <Arduino.h>
+
+#ifndef _FAKE_WIRE_H
+#define _FAKE_WIRE_H
+
+// No I2C devices on the host.  Sensor registers are faked by their drivers.
+class TwoWire {
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool sendStop = true);
+  size_t write(uint8_t data);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+  int available();
+  int read();
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,306 @@
+// Replays recorded frames through the fake ArduCAM FIFO and drains them the
+// way the web server does, reporting throughput, bytes copied per frame, and
+// time spent waiting on frames and semaphores.
+//
+//   pio test -e native -f test_camera_pipeline -v
+
+#include <CameraController.h>
+#include <ESPAsyncWebServer.h>
+#include <FakeFreeRTOS.h>
+#include <unity.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One TCP segment, as AsyncTCP hands to response fillers
+static const size_t CHUNK_SIZE = 1436;
+// OV2640 at 800x600 takes around this long per frame
+static const uint32_t CAPTURE_MICROS = 20000;
+static const size_t FRAMES_PER_RUN = 30;
+
+static const char FRAME_HEADER[] = "--frame\r\nContent-Type: image/jpeg\r\n\r\n";
+
+static Settings* settings;
+static CameraController* camera;
+static std::vector<std::vector<uint8_t>> recordedFrames;
+
+struct RunStats {
+  uint32_t elapsedMicros;
+  uint32_t framesSent;
+  uint32_t bytesCopied;
+  uint32_t frameWaitMicros;
+  uint64_t semaphoreWaitMicros;
+  uint32_t captures;
+  uint32_t capDonePolls;
+};
+
+// Baseline JPEG framing (SOI, APP0, ..., EOI) around noise, 24-36 KB like
+// OV2640 frames at 800x600
+static std::vector<std::vector<uint8_t>> makeFrames(size_t count) {
+  std::vector<std::vector<uint8_t>> frames;
+  uint32_t state = 0xC0FFEE;
+
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<uint8_t> frame(24 * 1024 + (i * 1637) % (12 * 1024));
+
+    for (size_t j = 0; j < frame.size(); ++j) {
+      state = state * 1664525 + 1013904223;
+      frame[j] = state >> 24;
+    }
+
+    const uint8_t soi[] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+    memcpy(frame.data(), soi, sizeof(soi));
+    frame[frame.size() - 2] = 0xFF;
+    frame[frame.size() - 1] = 0xD9;
+    // Tag the frame so it can be recognized after the trip
+    frame[4] = static_cast<uint8_t>(i);
+
+    frames.push_back(frame);
+  }
+
+  return frames;
+}
+
+static RunStats snapshot() {
+  const CameraStats& stats = camera->getStats();
+  RunStats result;
+
+  result.elapsedMicros = micros();
+  result.framesSent = stats.framesSent.load();
+  result.bytesCopied = stats.bytesCopied.load();
+  result.frameWaitMicros = stats.frameWaitMicros.load();
+  result.semaphoreWaitMicros = Fake::FreeRtos::semaphoreWaitMicros();
+  result.captures = Fake::Camera::captures();
+  result.capDonePolls = Fake::Camera::capDonePolls();
+
+  return result;
+}
+
+static void report(const char* name, const RunStats& start, const RunStats& end, size_t frames) {
+  const uint32_t elapsed = end.elapsedMicros - start.elapsedMicros;
+  const uint32_t captures = end.captures - start.captures;
+
+  printf(
+    "%s: %u frames in %u ms, %.1f fps, %u bytes copied/frame, %u us frame wait/frame, "
+    "%u us semaphore wait/frame, %u captures, %.2f CAP_DONE polls/capture\n",
+    name,
+    static_cast<unsigned>(frames),
+    static_cast<unsigned>(elapsed / 1000),
+    frames * 1e6 / elapsed,
+    static_cast<unsigned>((end.bytesCopied - start.bytesCopied) / frames),
+    static_cast<unsigned>((end.frameWaitMicros - start.frameWaitMicros) / frames),
+    static_cast<unsigned>((end.semaphoreWaitMicros - start.semaphoreWaitMicros) / frames),
+    static_cast<unsigned>(captures),
+    captures ? static_cast<double>(end.capDonePolls - start.capDonePolls) / captures : 0.0
+  );
+}
+
+// Calls the filler until `frames` whole frames have been sent, and returns
+// them.  Like the web server, a filler that returns RESPONSE_TRY_AGAIN is
+// called again later.
+static std::vector<std::string> drain(CameraController::CallbackFn& fill, size_t frames) {
+  std::string body;
+  std::vector<std::string> result;
+  uint8_t chunk[CHUNK_SIZE];
+  size_t index = 0;
+  const uint32_t deadline = millis() + 10000;
+
+  while (result.size() < frames && millis() < deadline) {
+    const size_t len = fill(chunk, sizeof(chunk), index);
+
+    if (len == RESPONSE_TRY_AGAIN) {
+      vTaskDelay(1);
+      continue;
+    } else if (len == 0) {
+      break;
+    }
+
+    body.append(reinterpret_cast<char*>(chunk), len);
+    index += len;
+
+    // A frame is complete once the next one's header arrives
+    size_t next;
+    while ((next = body.find(FRAME_HEADER, strlen(FRAME_HEADER))) != std::string::npos) {
+      result.push_back(body.substr(strlen(FRAME_HEADER), next - strlen(FRAME_HEADER)));
+      body.erase(0, next);
+    }
+  }
+
+  return result;
+}
+
+static bool isRecorded(const std::string& frame) {
+  if (frame.size() <= 4) {
+    return false;
+  }
+
+  const std::vector<uint8_t>& expected = recordedFrames[static_cast<uint8_t>(frame[4]) % recordedFrames.size()];
+  return expected.size() == frame.size() && memcmp(expected.data(), frame.data(), frame.size()) == 0;
+}
+
+static size_t totalSize(const std::vector<std::string>& frames) {
+  size_t total = 0;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    total += frames[i].size();
+  }
+  return total;
+}
+
+void setUp() {
+  settings->arducam.pipelined_capture = true;
+  Fake::Camera::setCaptureMicros(CAPTURE_MICROS);
+}
+
+void tearDown() { }
+
+void test_init_configures_sensor_and_captures() {
+  TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(CameraResolution::d800x600), Fake::Camera::jpegSize());
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, Fake::Camera::captures());
+  TEST_ASSERT_EQUAL_UINT32(0, camera->getStats().captureTimeouts.load());
+}
+
+void run_chunked_stream(const char* name) {
+  CameraController::CallbackFn fill = camera->chunkedResponseCallback(true, 0);
+  const RunStats start = snapshot();
+
+  std::vector<std::string> frames = drain(fill, FRAMES_PER_RUN);
+
+  const RunStats end = snapshot();
+  report(name, start, end, frames.size());
+
+  TEST_ASSERT_EQUAL_UINT32(FRAMES_PER_RUN, frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    TEST_ASSERT_TRUE(isRecorded(frames[i]));
+  }
+
+  // Each byte is copied once, from the frame ring into the response.  The
+  // last frame counted may still be partway through.
+  const uint32_t copied = end.bytesCopied - start.bytesCopied;
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(totalSize(frames), copied);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(totalSize(frames) + 40 * 1024, copied);
+
+  // Can't outrun the sensor
+  const uint32_t elapsed = end.elapsedMicros - start.elapsedMicros;
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(static_cast<uint32_t>(FRAMES_PER_RUN - 2) * CAPTURE_MICROS, elapsed);
+  // ...but shouldn't fall far behind it either
+  TEST_ASSERT_LESS_THAN_UINT32(static_cast<uint32_t>(FRAMES_PER_RUN) * CAPTURE_MICROS * 4, elapsed);
+}
+
+void test_chunked_stream_pipelined() {
+  run_chunked_stream("chunked, pipelined");
+}
+
+void test_chunked_stream_not_pipelined() {
+  settings->arducam.pipelined_capture = false;
+  run_chunked_stream("chunked, not pipelined");
+}
+
+void test_direct_stream_reads_fifo_into_response() {
+  CameraController::CallbackFn fill = camera->directResponseCallback(true, 0);
+  const RunStats start = snapshot();
+
+  std::vector<std::string> frames = drain(fill, FRAMES_PER_RUN);
+
+  const RunStats end = snapshot();
+  report("direct", start, end, frames.size());
+
+  TEST_ASSERT_EQUAL_UINT32(FRAMES_PER_RUN, frames.size());
+  for (size_t i = 0; i < frames.size(); ++i) {
+    TEST_ASSERT_TRUE(isRecorded(frames[i]));
+  }
+  TEST_ASSERT_EQUAL_UINT32(start.bytesCopied, end.bytesCopied);
+}
+
+void test_concurrent_streams_share_captures() {
+  // Unity can't fail a test from another thread, so workers only count
+  std::atomic<size_t> received[2];
+  std::atomic<size_t> intact[2];
+  std::thread streams[2];
+
+  const RunStats start = snapshot();
+
+  for (size_t i = 0; i < 2; ++i) {
+    received[i] = 0;
+    intact[i] = 0;
+    streams[i] = std::thread([i, &received, &intact]() {
+      CameraController::CallbackFn fill = camera->chunkedResponseCallback(true, 0);
+      std::vector<std::string> frames = drain(fill, FRAMES_PER_RUN);
+
+      received[i] = frames.size();
+      for (size_t j = 0; j < frames.size(); ++j) {
+        intact[i] += isRecorded(frames[j]);
+      }
+    });
+  }
+
+  for (size_t i = 0; i < 2; ++i) {
+    streams[i].join();
+  }
+
+  const RunStats end = snapshot();
+  report("two chunked streams", start, end, received[0] + received[1]);
+
+  for (size_t i = 0; i < 2; ++i) {
+    TEST_ASSERT_EQUAL_UINT32(FRAMES_PER_RUN, received[i]);
+    TEST_ASSERT_EQUAL_UINT32(FRAMES_PER_RUN, intact[i]);
+  }
+  // Readers waiting at the same time get the same capture
+  TEST_ASSERT_LESS_THAN_UINT32(2 * FRAMES_PER_RUN, end.captures - start.captures);
+}
+
+void test_snapshot_reuses_recent_frame() {
+  const uint32_t reusedBefore = camera->getStats().snapshotsReused.load();
+
+  FrameRing::FrameRef first = camera->acquireSnapshot(0);
+  TEST_ASSERT_TRUE(static_cast<bool>(first));
+  first.release();
+
+  FrameRing::FrameRef second = camera->acquireSnapshot(60000);
+  TEST_ASSERT_TRUE(static_cast<bool>(second));
+  TEST_ASSERT_EQUAL_UINT32(reusedBefore + 1, camera->getStats().snapshotsReused.load());
+}
+
+// Fillers run on the async_tcp task, so waiting out a capture there would hold
+// up every other connection
+void test_callbacks_dont_wait_for_captures() {
+  Fake::Camera::setCaptureMicros(200000);
+
+  CameraController::CallbackFn fills[] = {
+    camera->chunkedResponseCallback(true, 0),
+    camera->directResponseCallback(true, 0)
+  };
+  uint8_t chunk[CHUNK_SIZE];
+
+  for (size_t i = 0; i < 2; ++i) {
+    const uint32_t start = millis();
+    TEST_ASSERT_EQUAL_UINT32(RESPONSE_TRY_AGAIN, fills[i](chunk, sizeof(chunk), 0));
+    TEST_ASSERT_LESS_THAN_UINT32(20, millis() - start);
+  }
+
+  // ...and pick the frame up once it's there
+  std::vector<std::string> frames = drain(fills[1], 1);
+  TEST_ASSERT_EQUAL_UINT32(1, frames.size());
+}
+
+int main(int argc, char** argv) {
+  recordedFrames = makeFrames(8);
+  Fake::Camera::setFrames(recordedFrames);
+  Fake::Camera::setCaptureMicros(CAPTURE_MICROS);
+
+  // The capture task runs until the process exits, so these are never freed
+  settings = new Settings();
+  camera = new CameraController(*settings);
+  camera->init();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_init_configures_sensor_and_captures);
+  RUN_TEST(test_chunked_stream_pipelined);
+  RUN_TEST(test_chunked_stream_not_pipelined);
+  RUN_TEST(test_direct_stream_reads_fifo_into_response);
+  RUN_TEST(test_concurrent_streams_share_captures);
+  RUN_TEST(test_snapshot_reuses_recent_frame);
+  RUN_TEST(test_callbacks_dont_wait_for_captures);
+  return UNITY_END();
+}
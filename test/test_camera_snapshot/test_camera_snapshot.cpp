@@ -0,0 +1,83 @@
+// Takes snapshots from a camera whose frame ring only got one slot, as on a
+// board without PSRAM and a fragmented heap.
+//
+//   pio test -e native -f test_camera_snapshot
+
+#include <CameraController.h>
+#include <FakeEsp.h>
+#include <unity.h>
+
+#include <vector>
+
+static const uint32_t CAPTURE_MICROS = 20000;
+
+static Settings* settings;
+static CameraController* camera;
+
+// Just enough JPEG framing for the capture path
+static std::vector<std::vector<uint8_t>> makeFrames(size_t count) {
+  std::vector<std::vector<uint8_t>> frames;
+
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<uint8_t> frame(20 * 1024, static_cast<uint8_t>(i));
+    const uint8_t soi[] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+
+    memcpy(frame.data(), soi, sizeof(soi));
+    frame[frame.size() - 2] = 0xFF;
+    frame[frame.size() - 1] = 0xD9;
+
+    frames.push_back(frame);
+  }
+
+  return frames;
+}
+
+void setUp() { }
+void tearDown() { }
+
+void test_ring_has_one_slot() {
+  const FrameArenaInfo info = camera->getArenaInfo();
+  TEST_ASSERT_TRUE(FrameArenaState::DEGRADED == info.state);
+  TEST_ASSERT_EQUAL_UINT32(1, info.slotsAllocated);
+}
+
+void test_stale_snapshot_waits_for_a_new_frame() {
+  FrameRing::FrameRef first = camera->acquireSnapshot(0);
+  TEST_ASSERT_TRUE(static_cast<bool>(first));
+  const uint32_t firstSequence = first.sequence();
+  first.release();
+
+  delay(10);
+
+  // The stale frame is in the only slot.  Holding on to it while waiting
+  // would leave the capture task nowhere to write.
+  const uint32_t start = millis();
+  FrameRing::FrameRef second = camera->acquireSnapshot(0);
+
+  TEST_ASSERT_TRUE(static_cast<bool>(second));
+  TEST_ASSERT_GREATER_THAN_UINT32(firstSequence, second.sequence());
+  TEST_ASSERT_LESS_THAN_UINT32(CAMERA_FRAME_WAIT_MS, millis() - start);
+}
+
+int main(int argc, char** argv) {
+  Fake::Camera::setFrames(makeFrames(4));
+  Fake::Camera::setCaptureMicros(CAPTURE_MICROS);
+
+  // Room for one 800x600 slot, and not even the smallest second one
+  Fake::Esp::setPsram(false);
+  Fake::Esp::setHeapCapsLimit(
+    Fake::Esp::heapCapsAllocated()
+      + CameraTypes::expectedFrameSize(CameraResolution::d800x600)
+      + CAMERA_FRAME_MIN_SLOT_SIZE / 2
+  );
+
+  // The capture task runs until the process exits, so these are never freed
+  settings = new Settings();
+  camera = new CameraController(*settings);
+  camera->init();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_has_one_slot);
+  RUN_TEST(test_stale_snapshot_waits_for_a_new_frame);
+  return UNITY_END();
+}
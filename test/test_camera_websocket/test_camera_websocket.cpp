@@ -0,0 +1,158 @@
+// Sends control commands to the camera WebSocket from fake clients and
+// checks the status each one is answered with, and that frames keep coming
+// when another client goes away in the middle of a send.
+//
+//   pio test -e native -f test_camera_websocket
+
+#include <CameraWebSocket.h>
+#include <unity.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+// OV2640 at 800x600 takes around this long per frame
+static const uint32_t CAPTURE_MICROS = 20000;
+
+static Settings* settings;
+static CameraController* camera;
+static CameraWebSocket* cameraSocket;
+static AsyncWebSocketClient* client;
+
+// The status the last command was answered with
+static const std::string& command(const char* text) {
+  const size_t sent = client->texts.size();
+
+  cameraSocket->getHandler().receiveText(client, text);
+
+  TEST_ASSERT_EQUAL_UINT32(sent + 1, client->texts.size());
+  return client->texts.back();
+}
+
+// Just enough JPEG framing for the capture path
+static std::vector<std::vector<uint8_t>> makeFrames(size_t count) {
+  std::vector<std::vector<uint8_t>> frames;
+
+  for (size_t i = 0; i < count; ++i) {
+    std::vector<uint8_t> frame(20 * 1024, static_cast<uint8_t>(i));
+    const uint8_t soi[] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+
+    memcpy(frame.data(), soi, sizeof(soi));
+    frame[frame.size() - 2] = 0xFF;
+    frame[frame.size() - 1] = 0xD9;
+
+    frames.push_back(frame);
+  }
+
+  return frames;
+}
+
+static uint32_t sequenceOf(const std::string& message) {
+  CameraWsFrameHeader header;
+
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(sizeof(header), message.size());
+  memcpy(&header, message.data(), sizeof(header));
+  TEST_ASSERT_EQUAL_MEMORY(CAMERA_WS_MAGIC, header.magic, sizeof(header.magic));
+  TEST_ASSERT_EQUAL_UINT32(message.size() - sizeof(header), header.size);
+
+  return header.sequence;
+}
+
+static void assertFps(unsigned fps) {
+  char expected[24];
+  sprintf(expected, "\"fps\":%u,", fps);
+
+  const std::string& status = command("resume");
+  TEST_ASSERT_TRUE_MESSAGE(status.find(expected) != std::string::npos, status.c_str());
+}
+
+void setUp() {
+  client = cameraSocket->getHandler().connect();
+  command("rate 10");
+}
+
+void tearDown() {
+  cameraSocket->getHandler().disconnect(client);
+}
+
+void test_connect_sends_status() {
+  TEST_ASSERT_TRUE(client->texts.front().find("\"version\":") != std::string::npos);
+}
+
+void test_rate_sets_fps() {
+  command("rate 25");
+  assertFps(25);
+
+  command("rate 0");
+  assertFps(0);
+}
+
+void test_rate_rejects_non_numbers() {
+  const char* invalid[] = { "rate abc", "rate ", "rate 5fps", "rate 1.5", "rate -1", "rate 1001", "rate 99999999999999999999" };
+
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(*invalid); ++i) {
+    TEST_ASSERT_EQUAL_STRING_MESSAGE("{\"error\":\"Invalid rate\"}", command(invalid[i]).c_str(), invalid[i]);
+    // Left as it was, not set to 0
+    assertFps(10);
+  }
+}
+
+void test_unknown_command() {
+  TEST_ASSERT_EQUAL_STRING("{\"error\":\"Unknown command\"}", command("rates 5").c_str());
+}
+
+void test_client_leaving_mid_send() {
+  AsyncWebSocket& socket = cameraSocket->getHandler();
+  AsyncWebSocketClient* leaving = socket.connect();
+
+  command("rate 0");
+  socket.receiveText(leaving, "rate 0");
+
+  // Sent to first, being the older client.  The other one drops while the
+  // frame is going out.
+  std::thread disconnecting;
+  client->onBinary = [&]() {
+    if (! disconnecting.joinable()) {
+      disconnecting = std::thread([&socket, leaving]() { socket.disconnect(leaving); });
+      // Long enough for it to be off the socket's list and waiting on loop()
+      delay(20);
+    }
+  };
+
+  const uint32_t start = millis();
+  while (client->binaries.size() < 5 && millis() - start < 2000) {
+    cameraSocket->loop();
+    delay(1);
+  }
+
+  disconnecting.join();
+  client->onBinary = NULL;
+
+  TEST_ASSERT_EQUAL_UINT32(5, client->binaries.size());
+  for (size_t i = 1; i < client->binaries.size(); ++i) {
+    TEST_ASSERT_GREATER_THAN_UINT32(sequenceOf(client->binaries[i - 1]), sequenceOf(client->binaries[i]));
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(1, cameraSocket->getStats().clients);
+  // Every message has been sent, so none of their buffers is left
+  TEST_ASSERT_EQUAL_UINT32(0, socket.bufferCount());
+}
+
+int main(int argc, char** argv) {
+  Fake::Camera::setFrames(makeFrames(4));
+  Fake::Camera::setCaptureMicros(CAPTURE_MICROS);
+
+  // The capture task runs until the process exits, so these are never freed
+  settings = new Settings();
+  camera = new CameraController(*settings);
+  camera->init();
+  cameraSocket = new CameraWebSocket(*camera, *settings);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_sends_status);
+  RUN_TEST(test_rate_sets_fps);
+  RUN_TEST(test_rate_rejects_non_numbers);
+  RUN_TEST(test_unknown_command);
+  RUN_TEST(test_client_leaving_mid_send);
+  return UNITY_END();
+}
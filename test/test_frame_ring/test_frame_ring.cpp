@@ -0,0 +1,121 @@
+// Sizes the frame ring on a heap too small for every slot at full size, as on
+// boards without PSRAM, and checks what it settles for.
+//
+//   pio test -e native -f test_frame_ring
+
+#include <FrameRing.h>
+#include <FakeEsp.h>
+#include <unity.h>
+
+static const size_t FULL_SIZE = 128 * 1024;
+
+static void fill(CameraFrame* frame, size_t length) {
+  memset(frame->bytes, 0xAB, length);
+  frame->length = length;
+}
+
+void setUp() {
+  Fake::Esp::setPsram(false);
+  Fake::Esp::setHeapCapsLimit(0);
+}
+
+void tearDown() {
+  Fake::Esp::setHeapCapsLimit(0);
+}
+
+void test_full_size_when_there_is_room() {
+  FrameRing ring(3);
+  ring.setSlotSize(FULL_SIZE);
+
+  const FrameArenaInfo info = ring.getArenaInfo();
+  TEST_ASSERT_TRUE(FrameArenaState::OK == info.state);
+  TEST_ASSERT_EQUAL_UINT32(3, info.slotsAllocated);
+  TEST_ASSERT_EQUAL_UINT32(3 * FULL_SIZE, info.totalBytes);
+}
+
+void test_settles_for_smaller_slots() {
+  // Room for one full slot and change, not three
+  Fake::Esp::setHeapCapsLimit(Fake::Esp::heapCapsAllocated() + 200 * 1024);
+
+  FrameRing ring(3);
+  ring.setSlotSize(FULL_SIZE);
+
+  const FrameArenaInfo info = ring.getArenaInfo();
+  TEST_ASSERT_TRUE(FrameArenaState::DEGRADED == info.state);
+  // 128 KB, 64 KB, then nothing
+  TEST_ASSERT_EQUAL_UINT32(2, info.slotsAllocated);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(200 * 1024, info.totalBytes);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, info.allocationFailures);
+
+  // Frames still go through, one after another
+  for (uint32_t i = 1; i <= 5; ++i) {
+    CameraFrame* frame = ring.beginWrite();
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_TRUE(ring.reserve(frame, 12 * 1024));
+    fill(frame, 12 * 1024);
+    ring.commitWrite(millis());
+    TEST_ASSERT_EQUAL_UINT32(i, ring.latestSequence());
+  }
+}
+
+void test_out_of_memory_backs_off() {
+  // Not even the smallest slot fits
+  Fake::Esp::setHeapCapsLimit(Fake::Esp::heapCapsAllocated() + CAMERA_FRAME_MIN_SLOT_SIZE / 2);
+
+  FrameRing ring(3);
+  ring.setSlotSize(FULL_SIZE);
+
+  TEST_ASSERT_TRUE(FrameArenaState::OUT_OF_MEMORY == ring.getArenaInfo().state);
+
+  // Asking again straight away doesn't go back to the allocator
+  const uint32_t failures = Fake::Esp::heapCapsFailures();
+  for (size_t i = 0; i < 100; ++i) {
+    TEST_ASSERT_NULL(ring.beginWrite());
+  }
+  TEST_ASSERT_EQUAL_UINT32(failures, Fake::Esp::heapCapsFailures());
+
+  // Once memory frees up, the next try after the backoff gets it
+  Fake::Esp::setHeapCapsLimit(0);
+  delay(CAMERA_FRAME_RETRY_MS + 10);
+
+  CameraFrame* frame = ring.beginWrite();
+  TEST_ASSERT_NOT_NULL(frame);
+  TEST_ASSERT_EQUAL_UINT32(FULL_SIZE, frame->capacity);
+  ring.abortWrite();
+}
+
+void test_failed_growth_keeps_slot_and_backs_off() {
+  Fake::Esp::setHeapCapsLimit(Fake::Esp::heapCapsAllocated() + 3 * 32 * 1024);
+
+  FrameRing ring(3);
+  ring.setSlotSize(32 * 1024);
+  TEST_ASSERT_TRUE(FrameArenaState::OK == ring.getArenaInfo().state);
+
+  CameraFrame* frame = ring.beginWrite();
+  TEST_ASSERT_NOT_NULL(frame);
+
+  // Can't grow: the frame is dropped, but the slot is still usable
+  TEST_ASSERT_FALSE(ring.reserve(frame, 100 * 1024));
+  TEST_ASSERT_EQUAL_UINT32(32 * 1024, frame->capacity);
+
+  // Another oversized frame right away is dropped without trying
+  const uint32_t failures = Fake::Esp::heapCapsFailures();
+  TEST_ASSERT_FALSE(ring.reserve(frame, 100 * 1024));
+  TEST_ASSERT_EQUAL_UINT32(failures, Fake::Esp::heapCapsFailures());
+  TEST_ASSERT_EQUAL_UINT32(32 * 1024, frame->capacity);
+
+  // ...and frames that fit carry on
+  TEST_ASSERT_TRUE(ring.reserve(frame, 20 * 1024));
+  fill(frame, 20 * 1024);
+  ring.commitWrite(millis());
+  TEST_ASSERT_EQUAL_UINT32(1, ring.latestSequence());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_size_when_there_is_room);
+  RUN_TEST(test_settles_for_smaller_slots);
+  RUN_TEST(test_out_of_memory_backs_off);
+  RUN_TEST(test_failed_growth_keeps_slot_and_backs_off);
+  return UNITY_END();
+}
@@ -0,0 +1,132 @@
+// Counts the calling thread's allocations around the per-frame, per-step and
+// per-sample paths, which must not touch the heap once warmed up.
+//
+//   pio test -e native -f test_heap_accounting
+
+#include <HeapAccounting.h>
+#include <FrameRing.h>
+#include <ImaAdpcm.h>
+#include <Metrics.h>
+#include <MotionPlanner.h>
+#include <unity.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using HeapAccounting::allocationCount;
+
+void setUp() { }
+void tearDown() { }
+
+void test_counts_this_threads_allocations() {
+  const uint32_t before = allocationCount();
+  std::unique_ptr<int> allocated(new int(1));
+  TEST_ASSERT_EQUAL_UINT32(before + 1, allocationCount());
+}
+
+void test_other_threads_dont_count() {
+  std::atomic<bool> go(false);
+
+  std::thread other([&go]() {
+    while (! go) {
+      std::this_thread::yield();
+    }
+    std::vector<std::unique_ptr<int>> allocated;
+    for (size_t i = 0; i < 100; ++i) {
+      allocated.emplace_back(new int(1));
+    }
+  });
+
+  // After whatever starting the thread took
+  const uint32_t before = allocationCount();
+  go = true;
+  other.join();
+
+  TEST_ASSERT_EQUAL_UINT32(before, allocationCount());
+}
+
+void test_frame_ring_cycle_does_not_allocate() {
+  FrameRing ring(3);
+  ring.setSlotSize(32 * 1024);
+
+  uint32_t seen = 0;
+  uint32_t before = 0;
+
+  // The first lap sizes every slot
+  for (uint32_t i = 0; i < 20; ++i) {
+    if (i == 3) {
+      before = allocationCount();
+    }
+
+    CameraFrame* frame = ring.beginWrite();
+    TEST_ASSERT_NOT_NULL(frame);
+    TEST_ASSERT_TRUE(ring.reserve(frame, 20 * 1024));
+    frame->length = 20 * 1024;
+    ring.commitWrite(i);
+
+    FrameRing::FrameRef ref = ring.acquireNewerThan(seen);
+    TEST_ASSERT_TRUE(static_cast<bool>(ref));
+    seen = ref.sequence();
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(before, allocationCount());
+}
+
+void test_motion_plan_does_not_allocate() {
+  MotionPlanner planner;
+  planner.configure(AccelerationProfile::S_CURVE, 2000, 500, 100);
+
+  const uint32_t before = allocationCount();
+
+  uint32_t total = 0;
+  for (size_t numSteps = 1; numSteps < 500; numSteps += 7) {
+    MotionPlanner::Move move = planner.plan(numSteps);
+
+    for (size_t i = 0; i < move.size(); ++i) {
+      total += move.pulseAt(i).highMicros + move.pulseAt(i).lowMicros;
+    }
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(before, allocationCount());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, total);
+}
+
+void test_adpcm_encode_does_not_allocate() {
+  const uint32_t before = allocationCount();
+
+  ImaAdpcm::Encoder encoder;
+  ImaAdpcm::State decoder;
+  uint8_t code;
+
+  for (int32_t i = 0; i < 8000; ++i) {
+    if (encoder.addSample((i * 37) % 20000 - 10000, code)) {
+      ImaAdpcm::decodeSample(decoder, code & 0x0F);
+      ImaAdpcm::decodeSample(decoder, code >> 4);
+    }
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(before, allocationCount());
+}
+
+void test_histogram_record_does_not_allocate() {
+  const uint32_t before = allocationCount();
+
+  for (uint32_t i = 0; i < 1000; ++i) {
+    Metrics::cameraCapture.record(i * 100);
+  }
+
+  TEST_ASSERT_EQUAL_UINT32(before, allocationCount());
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_this_threads_allocations);
+  RUN_TEST(test_other_threads_dont_count);
+  RUN_TEST(test_frame_ring_cycle_does_not_allocate);
+  RUN_TEST(test_motion_plan_does_not_allocate);
+  RUN_TEST(test_adpcm_encode_does_not_allocate);
+  RUN_TEST(test_histogram_record_does_not_allocate);
+  return UNITY_END();
+}
@@ -0,0 +1,247 @@
+// Uploads sounds through the routes HttpServer registers, the way a client
+// would: multipart chunks to POST /sounds, then whatever the server sends
+// back once the request completes.  Reads them back, whole and by Range.
+//
+//   pio test -e native -f test_http_upload
+
+#include <HttpServer.h>
+#include <SPIFFS.h>
+#include <rom/crc.h>
+#include <unity.h>
+
+#include <string>
+
+static const size_t CHUNK_SIZE = 1436;
+
+static Settings* settings;
+static SettingsJournal* settingsJournal;
+static SoundIndex* soundIndex;
+static CameraController* camera;
+static MotorController* motor;
+static AudioController* audio;
+static HttpServer* httpServer;
+
+static std::string makeSound(size_t size, uint32_t seed) {
+  std::string sound(size, 0);
+  uint32_t state = seed;
+
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1664525 + 1013904223;
+    sound[i] = state >> 24;
+  }
+
+  return sound;
+}
+
+static String crcOf(const std::string& data) {
+  char crc[9];
+  sprintf(crc, "%08x", static_cast<unsigned>(crc32_le(0, reinterpret_cast<const uint8_t*>(data.data()), data.size())));
+  return crc;
+}
+
+static void upload(AsyncWebServerRequest& request, const char* filename, const std::string& sound) {
+  request.setUpload(filename, sound, CHUNK_SIZE);
+  Fake::Http::perform(request);
+  TEST_ASSERT_NOT_NULL(request.response());
+}
+
+static void parseBody(const AsyncWebServerRequest& request, DynamicJsonDocument& doc) {
+  TEST_ASSERT_EQUAL_STRING("application/json", request.response()->contentType().c_str());
+  TEST_ASSERT_FALSE(deserializeJson(doc, request.response()->body().c_str()));
+}
+
+static bool hasTempFiles() {
+  File dir = SPIFFS.open("/");
+  File file;
+
+  while ((file = dir.openNextFile())) {
+    if (String(file.name()).startsWith(UPLOAD_TEMP_PREFIX)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void setUp() {
+  Fake::Fs::reset();
+  soundIndex->init();
+}
+
+void tearDown() { }
+
+void test_upload_responds_with_result() {
+  const std::string sound = makeSound(10000, 1);
+  const String crc = crcOf(sound);
+  AsyncWebServerRequest request(HTTP_POST, "/sounds");
+  request.addHeader("X-Content-CRC32", crc);
+
+  upload(request, "chime.mp3", sound);
+
+  TEST_ASSERT_EQUAL_INT(200, request.response()->code());
+
+  DynamicJsonDocument doc(1024);
+  parseBody(request, doc);
+  TEST_ASSERT_TRUE(doc["success"].as<bool>());
+  TEST_ASSERT_EQUAL_UINT32(sound.size(), doc["size"].as<uint32_t>());
+  TEST_ASSERT_EQUAL_STRING(crc.c_str(), doc["crc32"].as<const char*>());
+  TEST_ASSERT_TRUE(doc.containsKey("elapsed_ms"));
+  TEST_ASSERT_TRUE(doc.containsKey("throughput_kbps"));
+
+  TEST_ASSERT_TRUE(SPIFFS.exists("/s/chime.mp3"));
+  TEST_ASSERT_FALSE(hasTempFiles());
+}
+
+void test_checksum_mismatch_is_rejected() {
+  const std::string sound = makeSound(10000, 2);
+  const String crc = crcOf(sound);
+  AsyncWebServerRequest request(HTTP_POST, "/sounds");
+  request.addHeader("X-Content-CRC32", "deadbeef");
+
+  upload(request, "chime.mp3", sound);
+
+  TEST_ASSERT_EQUAL_INT(400, request.response()->code());
+
+  DynamicJsonDocument doc(1024);
+  parseBody(request, doc);
+  TEST_ASSERT_EQUAL_STRING("Checksum mismatch", doc["error"].as<const char*>());
+  // What the server received, so the client can tell which end is wrong
+  TEST_ASSERT_EQUAL_STRING(crc.c_str(), doc["crc32"].as<const char*>());
+
+  // Nothing is kept, not even the temp file
+  TEST_ASSERT_FALSE(SPIFFS.exists("/s/chime.mp3"));
+  TEST_ASSERT_FALSE(hasTempFiles());
+
+  // ...and the listing doesn't pick it up
+  AsyncWebServerRequest list(HTTP_GET, "/sounds");
+  Fake::Http::perform(list);
+  TEST_ASSERT_EQUAL_INT(200, list.response()->code());
+  TEST_ASSERT_TRUE(list.response()->body().find("chime.mp3") == std::string::npos);
+}
+
+void test_checksum_mismatch_keeps_existing_file() {
+  const std::string original = makeSound(4000, 3);
+  Fake::Fs::setContents("/s/chime.mp3", original);
+
+  AsyncWebServerRequest request(HTTP_POST, "/sounds");
+  request.addHeader("X-Content-CRC32", crcOf(original));
+
+  upload(request, "chime.mp3", makeSound(10000, 4));
+
+  TEST_ASSERT_EQUAL_INT(400, request.response()->code());
+
+  File file = SPIFFS.open("/s/chime.mp3");
+  TEST_ASSERT_EQUAL_UINT32(original.size(), file.size());
+}
+
+void test_save_failure_is_reported() {
+  // Room for a couple of write buffers' worth, but not the whole file
+  const size_t capacity = Fake::Fs::capacity();
+  Fake::Fs::setCapacity(Fake::Fs::usedBytes() + 2 * UPLOAD_BUFFER_SIZE);
+
+  AsyncWebServerRequest request(HTTP_POST, "/sounds");
+  upload(request, "big.mp3", makeSound(8 * UPLOAD_BUFFER_SIZE, 5));
+
+  Fake::Fs::setCapacity(capacity);
+
+  TEST_ASSERT_EQUAL_INT(500, request.response()->code());
+
+  DynamicJsonDocument doc(1024);
+  parseBody(request, doc);
+  TEST_ASSERT_TRUE(doc.containsKey("error"));
+  TEST_ASSERT_FALSE(SPIFFS.exists("/s/big.mp3"));
+}
+
+void test_post_without_file_is_rejected() {
+  AsyncWebServerRequest request(HTTP_POST, "/sounds");
+  Fake::Http::perform(request);
+
+  TEST_ASSERT_NOT_NULL(request.response());
+  TEST_ASSERT_EQUAL_INT(400, request.response()->code());
+}
+
+void test_finished_uploads_release_their_slots() {
+  // Each finished request is freed, which drops its state
+  for (size_t i = 0; i < UPLOAD_MAX_CONCURRENT + 2; ++i) {
+    const std::string sound = makeSound(2000, 10 + i);
+    char filename[16];
+    sprintf(filename, "s%u.mp3", static_cast<unsigned>(i));
+
+    AsyncWebServerRequest request(HTTP_POST, "/sounds");
+    request.addHeader("X-Content-CRC32", i % 2 ? crcOf(sound) : String("00000000"));
+    upload(request, filename, sound);
+
+    TEST_ASSERT_EQUAL_INT(i % 2 ? 200 : 400, request.response()->code());
+  }
+}
+
+void test_get_still_lists_sounds() {
+  const std::string sound = makeSound(3000, 20);
+  AsyncWebServerRequest request(HTTP_POST, "/sounds");
+  upload(request, "listed.mp3", sound);
+  TEST_ASSERT_EQUAL_INT(200, request.response()->code());
+
+  AsyncWebServerRequest list(HTTP_GET, "/sounds");
+  Fake::Http::perform(list);
+
+  TEST_ASSERT_EQUAL_INT(200, list.response()->code());
+  TEST_ASSERT_TRUE(list.response()->body().find("listed.mp3") != std::string::npos);
+}
+
+void test_range_gets_part_of_sound() {
+  const std::string sound = makeSound(3000, 30);
+  AsyncWebServerRequest upload(HTTP_POST, "/sounds");
+  ::upload(upload, "ranged.mp3", sound);
+  TEST_ASSERT_EQUAL_INT(200, upload.response()->code());
+
+  AsyncWebServerRequest request(HTTP_GET, "/sounds/ranged.mp3");
+  request.addHeader("Range", "bytes=10-19");
+  Fake::Http::perform(request);
+
+  TEST_ASSERT_EQUAL_INT(206, request.response()->code());
+  TEST_ASSERT_TRUE(request.response()->body() == sound.substr(10, 10));
+}
+
+void test_malformed_range_gets_whole_sound() {
+  const std::string sound = makeSound(3000, 31);
+  AsyncWebServerRequest upload(HTTP_POST, "/sounds");
+  ::upload(upload, "ranged.mp3", sound);
+  TEST_ASSERT_EQUAL_INT(200, upload.response()->code());
+
+  const char* ranges[] = { "bytes=abc-", "bytes=-xyz", "bytes=5-x", "bytes=1x-5", "bytes=-", "bytes=10" };
+
+  for (size_t i = 0; i < sizeof(ranges) / sizeof(*ranges); ++i) {
+    AsyncWebServerRequest request(HTTP_GET, "/sounds/ranged.mp3");
+    request.addHeader("Range", ranges[i]);
+    Fake::Http::perform(request);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(200, request.response()->code(), ranges[i]);
+    TEST_ASSERT_TRUE_MESSAGE(request.response()->body() == sound, ranges[i]);
+  }
+}
+
+int main(int argc, char** argv) {
+  SPIFFS.begin();
+
+  // Never freed: the server holds on to them for as long as it runs
+  settings = new Settings();
+  settingsJournal = new SettingsJournal(*settings);
+  soundIndex = new SoundIndex(SOUNDS_DIRECTORY);
+  camera = new CameraController(*settings);
+  motor = new MotorController(*settings);
+  audio = new AudioController(*settings, *soundIndex);
+  httpServer = new HttpServer(*settings, *settingsJournal, *camera, *motor, *audio, *soundIndex);
+  httpServer->begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_upload_responds_with_result);
+  RUN_TEST(test_checksum_mismatch_is_rejected);
+  RUN_TEST(test_checksum_mismatch_keeps_existing_file);
+  RUN_TEST(test_save_failure_is_reported);
+  RUN_TEST(test_post_without_file_is_rejected);
+  RUN_TEST(test_finished_uploads_release_their_slots);
+  RUN_TEST(test_get_still_lists_sounds);
+  RUN_TEST(test_range_gets_part_of_sound);
+  RUN_TEST(test_malformed_range_gets_whole_sound);
+  return UNITY_END();
+}
@@ -0,0 +1,234 @@
+// Feeds MotionDetector flat grayscale frames and checks how its background
+// follows a lasting change in the scene.  Frames are baseline JPEGs with one
+// 8x8 block per grid cell and no AC coefficients, so a cell's luma is exactly
+// what the test asked for.
+//
+//   pio test -e native -f test_motion_detector
+
+#include <MotionDetector.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const uint16_t WIDTH = 8 * MOTION_GRID_WIDTH;
+static const uint16_t HEIGHT = 8 * MOTION_GRID_HEIGHT;
+
+class BitWriter {
+public:
+  BitWriter(std::vector<uint8_t>& out) : out(out), byte(0), bits(0) { }
+
+  void write(uint32_t value, uint8_t n) {
+    while (n-- > 0) {
+      byte = (byte << 1) | ((value >> n) & 1);
+
+      if (++bits == 8) {
+        flushByte();
+      }
+    }
+  }
+
+  // Pads with 1 bits, as encoders do
+  void finish() {
+    while (bits != 0) {
+      write(1, 1);
+    }
+  }
+
+private:
+  std::vector<uint8_t>& out;
+  uint8_t byte;
+  uint8_t bits;
+
+  void flushByte() {
+    out.push_back(byte);
+    if (byte == 0xFF) {
+      out.push_back(0x00);
+    }
+    byte = 0;
+    bits = 0;
+  }
+};
+
+static void segment(std::vector<uint8_t>& out, uint8_t marker, const std::vector<uint8_t>& body) {
+  const size_t length = body.size() + 2;
+
+  out.push_back(0xFF);
+  out.push_back(marker);
+  out.push_back(length >> 8);
+  out.push_back(length & 0xFF);
+  out.insert(out.end(), body.begin(), body.end());
+}
+
+// One luma value (0-255) per grid cell, row-major
+static std::vector<uint8_t> encode(const uint8_t* cells) {
+  std::vector<uint8_t> out = { 0xFF, 0xD8 };
+
+  // DQT: table 0, all ones
+  std::vector<uint8_t> dqt(65, 1);
+  dqt[0] = 0x00;
+  segment(out, 0xDB, dqt);
+
+  // SOF0: 8-bit, one component (id 1, 1x1, quant table 0)
+  segment(out, 0xC0, { 8, HEIGHT >> 8, HEIGHT & 0xFF, WIDTH >> 8, WIDTH & 0xFF, 1, 1, 0x11, 0 });
+
+  // DHT: DC table 0 codes categories 0-11 in 4 bits each.  AC table 0 only
+  // has end-of-block, coded as a single 0 bit.
+  std::vector<uint8_t> dht = { 0x00, 0, 0, 0, 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  for (uint8_t category = 0; category < 12; ++category) {
+    dht.push_back(category);
+  }
+  dht.insert(dht.end(), { 0x10, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00 });
+  segment(out, 0xC4, dht);
+
+  // SOS: component 1 with DC and AC table 0, full spectral range
+  segment(out, 0xDA, { 1, 1, 0x00, 0, 63, 0 });
+
+  BitWriter bits(out);
+  int32_t prediction = 0;
+
+  for (size_t i = 0; i < MOTION_GRID_CELLS; ++i) {
+    // DC is 8x the block's mean, level-shifted
+    const int32_t dc = 8 * (cells[i] - 128);
+    const int32_t diff = dc - prediction;
+    prediction = dc;
+
+    uint8_t category = 0;
+    for (int32_t magnitude = diff < 0 ? -diff : diff; magnitude > 0; magnitude >>= 1) {
+      ++category;
+    }
+
+    bits.write(category, 4);
+    bits.write(diff < 0 ? diff + (1 << category) - 1 : diff, category);
+    // End of block
+    bits.write(0, 1);
+  }
+
+  bits.finish();
+  out.push_back(0xFF);
+  out.push_back(0xD9);
+
+  return out;
+}
+
+static std::vector<uint8_t> flat(uint8_t luma) {
+  uint8_t cells[MOTION_GRID_CELLS];
+  memset(cells, luma, sizeof(cells));
+  return encode(cells);
+}
+
+static MotionResult analyze(MotionDetector& detector, const std::vector<uint8_t>& jpeg) {
+  MotionResult result;
+  TEST_ASSERT_TRUE(detector.analyze(jpeg.data(), jpeg.size(), result));
+  return result;
+}
+
+// Frames the scene changed to takes until it's no longer reported as motion,
+// and then until the background has caught up exactly.  Gives up after
+// maxFrames.
+static void settle(MotionDetector& detector, uint8_t from, uint8_t to, uint32_t maxFrames, uint32_t& quiet, uint32_t& exact) {
+  analyze(detector, flat(from));
+
+  const std::vector<uint8_t> changed = flat(to);
+  quiet = exact = maxFrames;
+
+  for (uint32_t frame = 1; frame <= maxFrames; ++frame) {
+    const MotionResult result = analyze(detector, changed);
+
+    if (! result.motion && quiet == maxFrames) {
+      quiet = frame;
+    }
+    if (result.maxDelta == 0) {
+      exact = frame;
+      break;
+    }
+  }
+}
+
+void setUp() { }
+void tearDown() { }
+
+void test_decodes_test_frames() {
+  uint8_t cells[MOTION_GRID_CELLS];
+  for (size_t i = 0; i < MOTION_GRID_CELLS; ++i) {
+    cells[i] = i;
+  }
+
+  MotionDetector detector;
+  const std::vector<uint8_t> jpeg = encode(cells);
+  analyze(detector, jpeg);
+
+  for (size_t i = 0; i < MOTION_GRID_CELLS; ++i) {
+    TEST_ASSERT_EQUAL_UINT8(cells[i] >> 1, detector.getGrid()[i]);
+  }
+}
+
+void test_change_is_motion() {
+  MotionDetector detector;
+  detector.configure(8, 4, 3);
+
+  analyze(detector, flat(100));
+
+  const MotionResult result = analyze(detector, flat(140));
+  TEST_ASSERT_TRUE(result.motion);
+  TEST_ASSERT_EQUAL_UINT16(MOTION_GRID_CELLS, result.changedCells);
+  TEST_ASSERT_EQUAL_UINT8(20, result.maxDelta);
+}
+
+void test_background_catches_up_with_brighter_scene() {
+  // From shift 4, 2^shift - 1 is over the threshold.  Rounding down would
+  // stall the background 10 below the scene and report motion forever.
+  for (uint8_t shift = 1; shift <= 6; ++shift) {
+    MotionDetector detector;
+    detector.configure(8, 4, shift);
+
+    uint32_t quiet, exact;
+    settle(detector, 100, 120, 1000, quiet, exact);
+
+    printf(
+      "shift %u: quiet after %u frames, exact after %u frames\n",
+      static_cast<unsigned>(shift),
+      static_cast<unsigned>(quiet),
+      static_cast<unsigned>(exact)
+    );
+    TEST_ASSERT_LESS_THAN_UINT32(1000, quiet);
+    TEST_ASSERT_LESS_THAN_UINT32(1000, exact);
+  }
+}
+
+void test_background_catches_up_with_darker_scene() {
+  for (uint8_t shift = 1; shift <= 6; ++shift) {
+    MotionDetector detector;
+    detector.configure(8, 4, shift);
+
+    uint32_t quiet, exact;
+    settle(detector, 120, 100, 1000, quiet, exact);
+
+    TEST_ASSERT_LESS_THAN_UINT32(1000, quiet);
+    TEST_ASSERT_LESS_THAN_UINT32(1000, exact);
+  }
+}
+
+void test_catching_up_is_symmetric() {
+  MotionDetector brighter, darker;
+  brighter.configure(8, 4, 4);
+  darker.configure(8, 4, 4);
+
+  uint32_t brighterQuiet, brighterExact, darkerQuiet, darkerExact;
+  settle(brighter, 60, 200, 1000, brighterQuiet, brighterExact);
+  settle(darker, 200, 60, 1000, darkerQuiet, darkerExact);
+
+  TEST_ASSERT_UINT32_WITHIN(1, brighterQuiet, darkerQuiet);
+  TEST_ASSERT_UINT32_WITHIN(1, brighterExact, darkerExact);
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_test_frames);
+  RUN_TEST(test_change_is_motion);
+  RUN_TEST(test_background_catches_up_with_brighter_scene);
+  RUN_TEST(test_background_catches_up_with_darker_scene);
+  RUN_TEST(test_catching_up_is_symmetric);
+  return UNITY_END();
+}
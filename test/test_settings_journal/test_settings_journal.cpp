@@ -0,0 +1,153 @@
+// Writes settings changes to the journal on the SPIFFS fake and replays them
+// into fresh Settings, as a reboot would.
+//
+//   pio test -e native -f test_settings_journal
+
+#include <Settings.h>
+#include <SettingsJournal.h>
+#include <SPIFFS.h>
+#include <unity.h>
+
+#include <string>
+
+static ConfigurationDictionary change(const char* key, const char* value) {
+  ConfigurationDictionary changes;
+  changes[key] = value;
+  return changes;
+}
+
+// Writes the changes to the journal the way a running device would
+static void journal(const ConfigurationDictionary& changes) {
+  Settings settings;
+  settings.setFromDictionary(Fake::Bleeper::persisted());
+  SettingsJournal journal(settings);
+  Fake::Bleeper::setConfiguration(&settings);
+
+  journal.update(changes);
+  journal.flush();
+
+  Fake::Bleeper::setConfiguration(NULL);
+}
+
+// Settings as they'd be after a reboot: stored configuration, then journal
+static Settings* reboot() {
+  Settings* settings = new Settings();
+  settings->setFromDictionary(Fake::Bleeper::persisted());
+
+  SettingsJournal journal(*settings);
+  Fake::Bleeper::setConfiguration(settings);
+  journal.init();
+  Fake::Bleeper::setConfiguration(NULL);
+
+  return settings;
+}
+
+void setUp() {
+  Fake::Fs::reset();
+  Fake::Bleeper::reset();
+}
+
+void tearDown() { }
+
+void test_replays_changes() {
+  journal(change("audio.task_priority", "5"));
+  journal(change("storage.flush_delay_ms", "100"));
+
+  Settings* settings = reboot();
+  TEST_ASSERT_EQUAL_INT(5, settings->audio.task_priority);
+  TEST_ASSERT_EQUAL_INT(100, settings->storage.flush_delay_ms);
+  TEST_ASSERT_EQUAL_UINT32(0, Fake::Bleeper::persists());
+  delete settings;
+}
+
+void test_torn_record_is_compacted_away() {
+  journal(change("audio.task_priority", "5"));
+
+  // Reset partway through the next record
+  const std::string complete = Fake::Fs::contents(SETTINGS_JOURNAL_FILE);
+  journal(change("storage.flush_delay_ms", "100"));
+  const std::string withNext = Fake::Fs::contents(SETTINGS_JOURNAL_FILE);
+  Fake::Fs::setContents(SETTINGS_JOURNAL_FILE, withNext.substr(0, complete.size() + 6));
+
+  Settings* settings = reboot();
+  TEST_ASSERT_EQUAL_INT(5, settings->audio.task_priority);
+  TEST_ASSERT_EQUAL_INT(2000, settings->storage.flush_delay_ms);
+
+  // What was replayed is kept, and the journal starts over
+  TEST_ASSERT_EQUAL_UINT32(1, Fake::Bleeper::persists());
+  TEST_ASSERT_EQUAL_STRING("5", Fake::Bleeper::persisted().at("audio.task_priority").c_str());
+  TEST_ASSERT_FALSE(SPIFFS.exists(SETTINGS_JOURNAL_FILE));
+  delete settings;
+
+  // so a later change isn't hidden behind the torn record
+  journal(change("audio.dma_buffer_count", "16"));
+
+  settings = reboot();
+  TEST_ASSERT_EQUAL_INT(5, settings->audio.task_priority);
+  TEST_ASSERT_EQUAL_INT(16, settings->audio.dma_buffer_count);
+  delete settings;
+}
+
+void test_short_write_persists_everything() {
+  journal(change("audio.task_priority", "5"));
+
+  // Room for part of the next record only
+  Fake::Fs::setCapacity(Fake::Fs::usedBytes() + 6);
+  journal(change("storage.flush_delay_ms", "100"));
+
+  TEST_ASSERT_EQUAL_UINT32(1, Fake::Bleeper::persists());
+  TEST_ASSERT_EQUAL_STRING("100", Fake::Bleeper::persisted().at("storage.flush_delay_ms").c_str());
+  TEST_ASSERT_FALSE(SPIFFS.exists(SETTINGS_JOURNAL_FILE));
+
+  Fake::Fs::setCapacity(64 * 1024);
+
+  Settings* settings = reboot();
+  TEST_ASSERT_EQUAL_INT(100, settings->storage.flush_delay_ms);
+  delete settings;
+}
+
+void test_large_journal_is_compacted() {
+  Settings settings;
+  SettingsJournal journal(settings);
+  Fake::Bleeper::setConfiguration(&settings);
+  char value[8];
+
+  for (int i = 0; i < 200 && Fake::Bleeper::persists() == 0; ++i) {
+    snprintf(value, sizeof(value), "%d", i);
+    journal.update(change("motor.acceleration_steps", value));
+    journal.flush();
+  }
+
+  Fake::Bleeper::setConfiguration(NULL);
+
+  TEST_ASSERT_EQUAL_UINT32(1, Fake::Bleeper::persists());
+  TEST_ASSERT_FALSE(SPIFFS.exists(SETTINGS_JOURNAL_FILE));
+}
+
+void test_oversize_value_persists_everything() {
+  // Too long for a journal record's 16-bit length
+  const String password(std::string(70000, 'x').c_str());
+  ConfigurationDictionary changes = change("audio.task_priority", "5");
+  changes["http.password"] = password;
+
+  journal(changes);
+
+  TEST_ASSERT_EQUAL_UINT32(1, Fake::Bleeper::persists());
+  TEST_ASSERT_TRUE(Fake::Bleeper::persisted().at("http.password") == password);
+  TEST_ASSERT_FALSE(SPIFFS.exists(SETTINGS_JOURNAL_FILE));
+
+  Settings* settings = reboot();
+  TEST_ASSERT_EQUAL_INT(5, settings->audio.task_priority);
+  TEST_ASSERT_EQUAL_UINT32(password.length(), settings->http.password.length());
+  delete settings;
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_replays_changes);
+  RUN_TEST(test_torn_record_is_compacted_away);
+  RUN_TEST(test_short_write_persists_everything);
+  RUN_TEST(test_large_journal_is_compacted);
+  RUN_TEST(test_oversize_value_persists_everything);
+  return UNITY_END();
+}
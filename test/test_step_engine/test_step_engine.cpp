@@ -0,0 +1,145 @@
+// Streams moves through the fake RMT channel and checks that every pulse goes
+// out, in order, without holding the whole move in memory.
+//
+//   pio test -e native -f test_step_engine
+
+#include <FakeRmt.h>
+#include <MotionPlanner.h>
+#include <StepEngine.h>
+#include <unity.h>
+
+#include <algorithm>
+
+static const rmt_channel_t CHANNEL = STEP_ENGINE_RMT_CHANNEL;
+static const uint8_t STEP_PIN = 26;
+
+class FixedPulses : public PulseSource {
+public:
+  FixedPulses(const StepPulse* pulses, size_t count) : pulses(pulses), count(count) { }
+
+  virtual size_t size() const { return count; }
+  virtual StepPulse pulseAt(size_t ix) const { return pulses[ix]; }
+
+private:
+  const StepPulse* pulses;
+  size_t count;
+};
+
+static StepEngine* engine;
+
+void setUp() {
+  Fake::Rmt::reset();
+
+  engine = new StepEngine();
+  engine->init(STEP_PIN);
+}
+
+void tearDown() {
+  delete engine;
+}
+
+void test_init_configures_channel() {
+  TEST_ASSERT_TRUE(Fake::Rmt::installed(CHANNEL));
+  TEST_ASSERT_EQUAL(STEP_PIN, Fake::Rmt::config(CHANNEL).gpio_num);
+  TEST_ASSERT_EQUAL_UINT8(80, Fake::Rmt::config(CHANNEL).clk_div);
+}
+
+void test_empty_move_writes_nothing() {
+  engine->run(FixedPulses(NULL, 0));
+
+  TEST_ASSERT_EQUAL_UINT32(0, Fake::Rmt::writes(CHANNEL));
+}
+
+void test_durations_are_clamped() {
+  const StepPulse pulses[] = { { 0, 40000 }, { 5, 7 } };
+  engine->run(FixedPulses(pulses, 2));
+
+  const std::vector<rmt_item32_t>& items = Fake::Rmt::items(CHANNEL);
+  TEST_ASSERT_EQUAL_UINT32(2, items.size());
+  TEST_ASSERT_EQUAL_UINT32(1, items[0].duration0);
+  TEST_ASSERT_EQUAL_UINT32(StepEngine::MAX_LEVEL_MICROS, items[0].duration1);
+  TEST_ASSERT_EQUAL_UINT32(1, items[0].level0);
+  TEST_ASSERT_EQUAL_UINT32(0, items[0].level1);
+  TEST_ASSERT_EQUAL_UINT32(5, items[1].duration0);
+  TEST_ASSERT_EQUAL_UINT32(7, items[1].duration1);
+}
+
+// 100 turns at 1/16 stepping used to need ~1.3 MB of items up front
+void test_long_move_is_streamed_in_bounded_chunks() {
+  const size_t numSteps = 100 * 200 * 16;
+  MotionPlanner planner;
+  const MotionPlanner::Move move = planner.plan(numSteps);
+
+  engine->run(move);
+
+  const std::vector<rmt_item32_t>& items = Fake::Rmt::items(CHANNEL);
+  TEST_ASSERT_EQUAL_UINT32(numSteps, items.size());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(STEP_ENGINE_CHUNK_PULSES, Fake::Rmt::largestWrite(CHANNEL));
+  TEST_ASSERT_EQUAL_UINT32(0, Fake::Rmt::overwrites(CHANNEL));
+
+  uint64_t expectedTicks = 0;
+  size_t mismatches = 0;
+  for (size_t i = 0; i < numSteps; ++i) {
+    const StepPulse pulse = move.pulseAt(i);
+    expectedTicks += pulse.highMicros + pulse.lowMicros;
+    mismatches += items[i].duration0 != pulse.highMicros || items[i].duration1 != pulse.lowMicros;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+  TEST_ASSERT_TRUE(expectedTicks == Fake::Rmt::elapsedTicks(CHANNEL));
+
+  // Accelerates from the start speed, cruises, and decelerates back
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_START_MICROSECONDS_BETWEEN_STEPS, items.front().duration0);
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_MICROSECONDS_BETWEEN_STEPS, items[numSteps / 2].duration0);
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_START_MICROSECONDS_BETWEEN_STEPS, items.back().duration0);
+}
+
+// Moves too short to reach cruising speed speed up, then slow down, without a
+// jump to full speed in the middle
+void test_short_moves_stay_on_the_ramp() {
+  MotionPlanner planner;
+
+  for (size_t numSteps = 1; numSteps <= 2 * DEFAULT_ACCELERATION_STEPS + 1; ++numSteps) {
+    const MotionPlanner::Move move = planner.plan(numSteps);
+    const size_t middle = numSteps / 2;
+
+    for (size_t i = 0; i < numSteps; ++i) {
+      const uint16_t interval = move.pulseAt(i).highMicros;
+      // The same as the step the same distance from the nearer end of the move
+      const size_t fromEnd = std::min(i, numSteps - 1 - i);
+      const uint16_t expected = MotionPlanner::rampInterval(
+        AccelerationProfile::TRAPEZOIDAL,
+        DEFAULT_START_MICROSECONDS_BETWEEN_STEPS,
+        DEFAULT_MICROSECONDS_BETWEEN_STEPS,
+        DEFAULT_ACCELERATION_STEPS,
+        fromEnd
+      );
+
+      TEST_ASSERT_EQUAL_UINT16(expected, interval);
+      TEST_ASSERT_TRUE(i == middle || interval > DEFAULT_MICROSECONDS_BETWEEN_STEPS);
+    }
+  }
+}
+
+void test_fake_catches_buffer_reused_in_flight() {
+  rmt_item32_t item = { };
+  item.level0 = 1;
+  item.duration0 = 10;
+  item.duration1 = 10;
+
+  rmt_write_items(CHANNEL, &item, 1, false);
+  item.duration0 = 20;
+  rmt_wait_tx_done(CHANNEL, portMAX_DELAY);
+
+  TEST_ASSERT_EQUAL_UINT32(1, Fake::Rmt::overwrites(CHANNEL));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_init_configures_channel);
+  RUN_TEST(test_empty_move_writes_nothing);
+  RUN_TEST(test_durations_are_clamped);
+  RUN_TEST(test_long_move_is_streamed_in_bounded_chunks);
+  RUN_TEST(test_short_moves_stay_on_the_ramp);
+  RUN_TEST(test_fake_catches_buffer_reused_in_flight);
+  return UNITY_END();
+}
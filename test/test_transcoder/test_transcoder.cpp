@@ -0,0 +1,162 @@
+// Transcodes generated tones through the fake MP3 decoder into the ImaAdpcm
+// container, then plays the result back.
+//
+//   pio test -e native -f test_transcoder
+
+#include <AudioFileSourceSPIFFS.h>
+#include <AudioGeneratorImaAdpcm.h>
+#include <AudioGeneratorMP3.h>
+#include <ImaAdpcm.h>
+#include <SoundTranscoder.h>
+#include <SPIFFS.h>
+#include <unity.h>
+
+#include <math.h>
+#include <vector>
+
+static const char SOURCE[] = "/s/tone.mp3";
+static const char TARGET[] = "/s/tone.ima";
+
+// Collects what a generator plays
+class RecordingOutput : public AudioOutput {
+public:
+  std::vector<int16_t> samples;
+
+  uint16_t getRate() const { return hertz; }
+
+  virtual bool begin() override { return true; }
+  virtual bool ConsumeSample(int16_t sample[2]) override {
+    samples.push_back(sample[LEFTCHANNEL]);
+    return true;
+  }
+  virtual bool stop() override { return true; }
+};
+
+static std::vector<int16_t> tone(uint32_t sampleRate, uint8_t channels, double hz, double seconds) {
+  std::vector<int16_t> samples;
+  const size_t count = sampleRate * seconds;
+
+  for (size_t i = 0; i < count; ++i) {
+    const int16_t value = 12000 * sin(2 * M_PI * hz * i / sampleRate);
+
+    for (uint8_t c = 0; c < channels; ++c) {
+      samples.push_back(value);
+    }
+  }
+
+  return samples;
+}
+
+static RecordingOutput play(const char* path) {
+  AudioFileSourceSPIFFS source;
+  AudioGeneratorImaAdpcm generator;
+  RecordingOutput output;
+
+  TEST_ASSERT_TRUE(source.open(path));
+  TEST_ASSERT_TRUE(generator.begin(&source, &output));
+  while (generator.isRunning() && generator.loop()) { }
+  generator.stop();
+
+  return output;
+}
+
+// Root-mean-square difference from the ideal tone, relative to its amplitude
+static double toneError(const std::vector<int16_t>& samples, uint32_t sampleRate, double hz) {
+  double sum = 0;
+
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const double expected = 12000 * sin(2 * M_PI * hz * i / sampleRate);
+    sum += (samples[i] - expected) * (samples[i] - expected);
+  }
+
+  return sqrt(sum / samples.size()) / 12000;
+}
+
+void setUp() {
+  Fake::Fs::reset();
+  Fake::Fs::setCapacity(1024 * 1024);
+}
+
+void tearDown() { }
+
+void test_target_swaps_extension() {
+  TEST_ASSERT_EQUAL_STRING("/s/tone.ima", SoundTranscoder::targetFor("/s/tone.mp3").c_str());
+  TEST_ASSERT_EQUAL_STRING("/s/tone.ima", SoundTranscoder::targetFor("/s/tone").c_str());
+  TEST_ASSERT_EQUAL_STRING("/s.d/tone.ima", SoundTranscoder::targetFor("/s.d/tone").c_str());
+}
+
+void test_downsamples_to_max_rate() {
+  Fake::Fs::setContents(SOURCE, Fake::Mp3::encode(44100, 2, tone(44100, 2, 440, 1)));
+
+  const uint32_t numSamples = SoundTranscoder::transcode(SOURCE, TARGET, 16000);
+  TEST_ASSERT_UINT32_WITHIN(1, 16000, numSamples);
+
+  const std::string contents = Fake::Fs::contents(TARGET);
+  ImaAdpcm::Header header;
+  TEST_ASSERT_TRUE(ImaAdpcm::readHeader(reinterpret_cast<const uint8_t*>(contents.data()), header));
+  TEST_ASSERT_EQUAL_UINT32(16000, header.sampleRate);
+  TEST_ASSERT_EQUAL_UINT32(numSamples, header.numSamples);
+
+  // Half of what a second of 128 kbps MP3 takes
+  TEST_ASSERT_EQUAL_UINT32(ImaAdpcm::HEADER_SIZE + (numSamples + 1) / 2, contents.size());
+  TEST_ASSERT_LESS_THAN_UINT32(128 * 1000 / 8, contents.size());
+
+  RecordingOutput output = play(TARGET);
+  TEST_ASSERT_EQUAL_UINT16(16000, output.getRate());
+  TEST_ASSERT_EQUAL_UINT32(numSamples, output.samples.size());
+  // Averaging attenuates 440 Hz by well under 1%, so what's left is mostly
+  // ADPCM quantization
+  TEST_ASSERT_LESS_THAN(10, static_cast<int>(100 * toneError(output.samples, 16000, 440)));
+}
+
+void test_keeps_rate_at_or_below_max() {
+  Fake::Fs::setContents(SOURCE, Fake::Mp3::encode(11025, 1, tone(11025, 1, 440, 0.5)));
+
+  const uint32_t numSamples = SoundTranscoder::transcode(SOURCE, TARGET, 16000);
+  TEST_ASSERT_EQUAL_UINT32(5512, numSamples);
+
+  RecordingOutput output = play(TARGET);
+  TEST_ASSERT_EQUAL_UINT16(11025, output.getRate());
+  TEST_ASSERT_LESS_THAN(10, static_cast<int>(100 * toneError(output.samples, 11025, 440)));
+}
+
+void test_no_limit_keeps_source_rate() {
+  Fake::Fs::setContents(SOURCE, Fake::Mp3::encode(44100, 2, tone(44100, 2, 440, 0.25)));
+
+  TEST_ASSERT_EQUAL_UINT32(11025, SoundTranscoder::transcode(SOURCE, TARGET, 0));
+  TEST_ASSERT_EQUAL_UINT16(44100, play(TARGET).getRate());
+}
+
+void test_undecodable_source_leaves_no_target() {
+  Fake::Fs::setContents(SOURCE, "not an mp3");
+
+  TEST_ASSERT_EQUAL_UINT32(0, SoundTranscoder::transcode(SOURCE, TARGET, 16000));
+  TEST_ASSERT_FALSE(SPIFFS.exists(TARGET));
+  TEST_ASSERT_TRUE(SPIFFS.exists(SOURCE));
+}
+
+void test_missing_source_leaves_no_target() {
+  TEST_ASSERT_EQUAL_UINT32(0, SoundTranscoder::transcode(SOURCE, TARGET, 16000));
+  TEST_ASSERT_FALSE(SPIFFS.exists(TARGET));
+}
+
+void test_full_flash_leaves_no_target() {
+  const std::string mp3 = Fake::Mp3::encode(44100, 2, tone(44100, 2, 440, 1));
+  Fake::Fs::setContents(SOURCE, mp3);
+  Fake::Fs::setCapacity(mp3.size() + 1024);
+
+  TEST_ASSERT_EQUAL_UINT32(0, SoundTranscoder::transcode(SOURCE, TARGET, 16000));
+  TEST_ASSERT_FALSE(SPIFFS.exists(TARGET));
+}
+
+int main(int argc, char** argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_target_swaps_extension);
+  RUN_TEST(test_downsamples_to_max_rate);
+  RUN_TEST(test_keeps_rate_at_or_below_max);
+  RUN_TEST(test_no_limit_keeps_source_rate);
+  RUN_TEST(test_undecodable_source_leaves_no_target);
+  RUN_TEST(test_missing_source_leaves_no_target);
+  RUN_TEST(test_full_flash_leaves_no_target);
+  return UNITY_END();
+}